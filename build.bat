@@ -19,7 +19,7 @@ if not exist "SDL3-devel-3.2.22-mingw\SDL3-3.2.22\x86_64-w64-mingw32\include\SDL
 
 REM Compile the game
 echo Compiling...
-g++ -o space_pingpong_sdl3.exe space_pingpong_sdl3.cpp -I./SDL3-devel-3.2.22-mingw/SDL3-3.2.22/x86_64-w64-mingw32/include -L./SDL3-devel-3.2.22-mingw/SDL3-3.2.22/x86_64-w64-mingw32/lib -lSDL3 -lmingw32 -lm -ldinput8 -ldxguid -ldxerr8 -luser32 -lgdi32 -lwinmm -limm32 -lole32 -loleaut32 -lshell32 -lsetupapi -lversion -luuid
+g++ -o space_pingpong_sdl3.exe space_pingpong_sdl3.cpp render_primitives.cpp render_commands.cpp particle_system.cpp job_system.cpp high_scores.cpp pingpong_sim.cpp collision_grid.cpp input_recording.cpp rollback.cpp replay_file.cpp netplay.cpp -I./SDL3-devel-3.2.22-mingw/SDL3-3.2.22/x86_64-w64-mingw32/include -L./SDL3-devel-3.2.22-mingw/SDL3-3.2.22/x86_64-w64-mingw32/lib -lSDL3 -lmingw32 -lm -ldinput8 -ldxguid -ldxerr8 -luser32 -lgdi32 -lwinmm -limm32 -lole32 -loleaut32 -lshell32 -lsetupapi -lversion -luuid -lws2_32
 
 if %errorlevel% equ 0 (
     echo.
@@ -0,0 +1,24 @@
+// Space Ping Pong - uniform grid broad phase
+#include "collision_grid.h"
+
+CollisionGrid::CollisionGrid(float width, float height, float cellSize)
+    : columns(std::max(1, (int)std::ceil(width / cellSize))), rows(std::max(1, (int)std::ceil(height / cellSize))),
+      inverseCell(1.0f / cellSize), extent(0) {}
+
+void CollisionGrid::sort() {
+    // Count the items of each cell, turn the counts into starts, then place
+    // the items in index order
+    starts.assign((size_t)(columns * rows) + 1, 0);
+    for (uint32_t cell : cellOf) {
+        starts[cell + 1]++;
+    }
+    for (size_t cell = 1; cell < starts.size(); cell++) {
+        starts[cell] += starts[cell - 1];
+    }
+    
+    items.resize(cellOf.size());
+    fill.assign(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < cellOf.size(); i++) {
+        items[fill[cellOf[i]]++] = (uint32_t)i;
+    }
+}
@@ -0,0 +1,82 @@
+// Space Ping Pong - uniform grid broad phase
+//
+// Items are bucketed by the cell their center falls in, with a counting
+// sort, so a rebuild costs one pass over the items and one over the cells.
+// A query grows its area by the largest item extent given to build() and
+// visits every item in the cells that area overlaps: every item whose rect
+// could touch the area, and some that can't. Callers do the exact test.
+// Centers outside the grid count as being in its edge cells.
+//
+// Within a cell items are visited in ascending index order, so results
+// depend only on the items, never on how the grid was filled before.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CollisionGrid {
+public:
+    // Covers [0, width) x [0, height); nothing is allocated until build()
+    CollisionGrid(float width, float height, float cellSize);
+    
+    // Buckets count items; center(i) returns item i's center with x and y
+    // members. maxExtent is the largest distance from any item's center to
+    // the edge of its rect.
+    template <typename Center>
+    void build(size_t count, float maxExtent, Center center) {
+        cellOf.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            auto c = center(i);
+            cellOf[i] = cellIndex(column(c.x), row(c.y));
+        }
+        extent = maxExtent;
+        sort();
+    }
+    
+    // Visits the index of every item that may overlap the area
+    template <typename Visit>
+    void query(float left, float top, float right, float bottom, Visit visit) const {
+        int x0 = column(left - extent);
+        int x1 = column(right + extent);
+        int y0 = row(top - extent);
+        int y1 = row(bottom + extent);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                int cell = cellIndex(x, y);
+                for (uint32_t i = starts[cell]; i < starts[cell + 1]; i++) {
+                    visit((size_t)items[i]);
+                }
+            }
+        }
+    }
+    
+    size_t size() const {
+        return cellOf.size();
+    }
+    
+private:
+    int columns, rows;
+    float inverseCell;
+    float extent;
+    std::vector<uint32_t> cellOf;   // Of each item
+    std::vector<uint32_t> starts;   // Of each cell's items, plus the end
+    std::vector<uint32_t> items;    // Indices, grouped by cell
+    std::vector<uint32_t> fill;     // Next free slot of each cell, while sorting
+    
+    int column(float x) const {
+        return std::max(0, std::min(columns - 1, (int)std::floor(x * inverseCell)));
+    }
+    
+    int row(float y) const {
+        return std::max(0, std::min(rows - 1, (int)std::floor(y * inverseCell)));
+    }
+    
+    int cellIndex(int x, int y) const {
+        return y * columns + x;
+    }
+    
+    void sort();
+};
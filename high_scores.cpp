@@ -0,0 +1,410 @@
+// Space Ping Pong - persistent high scores
+#include "high_scores.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char SNAPSHOT_MAGIC[4] = {'S', 'P', 'H', 'S'};
+const char LOG_MAGIC[4] = {'S', 'P', 'H', 'L'};
+const uint32_t VERSION = 1;
+const size_t SNAPSHOT_HEADER_SIZE = 24;     // Magic, version, absorbed log generation, reserved, count
+const size_t LOG_HEADER_SIZE = 16;          // Magic, version, generation, reserved
+const size_t RECORD_SIZE = 24;              // Fields, then a checksum of them
+const size_t MERGE_BLOCK = 4096;            // Records per read and write while compacting
+
+void putBytes(uint8_t* out, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        out[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+uint64_t getBytes(const uint8_t* in, int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value |= (uint64_t)in[i] << (i * 8);
+    }
+    return value;
+}
+
+uint32_t fnv1a32(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void encodeRecord(uint8_t* out, const HighScore& score) {
+    putBytes(out, score.time, 8);
+    putBytes(out + 8, score.durationMs, 4);
+    putBytes(out + 12, score.sequence, 4);
+    out[16] = score.winner;
+    out[17] = score.winnerScore;
+    out[18] = score.loserScore;
+    out[19] = score.difficulty;
+    putBytes(out + 20, fnv1a32(out, 20), 4);
+}
+
+bool decodeRecord(const uint8_t* in, HighScore& score) {
+    if ((uint32_t)getBytes(in + 20, 4) != fnv1a32(in, 20)) {
+        return false;
+    }
+    score.time = getBytes(in, 8);
+    score.durationMs = (uint32_t)getBytes(in + 8, 4);
+    score.sequence = (uint32_t)getBytes(in + 12, 4);
+    score.winner = in[16];
+    score.winnerScore = in[17];
+    score.loserScore = in[18];
+    score.difficulty = in[19];
+    return true;
+}
+
+// Pushes a written file through the OS cache to the disk
+bool syncFile(FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Atomically puts from in place of to
+bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+int margin(const HighScore& score) {
+    return (int)score.winnerScore - (int)score.loserScore;
+}
+
+}
+
+bool ranksAbove(const HighScore& a, const HighScore& b) {
+    if (margin(a) != margin(b)) return margin(a) > margin(b);
+    // A human opponent counts as the hardest
+    if (a.difficulty != b.difficulty) return a.difficulty > b.difficulty;
+    if (a.durationMs != b.durationMs) return a.durationMs < b.durationMs;
+    return a.sequence < b.sequence;
+}
+
+HighScoreStore::HighScoreStore()
+    : count(0), loadMs(0), stopping(false), writeErrors(0), generation(1), logStale(true) {}
+
+HighScoreStore::~HighScoreStore() {
+    close();
+}
+
+bool HighScoreStore::open(const std::string& storePath) {
+    close();
+    auto start = std::chrono::steady_clock::now();
+    path = storePath;
+    top.clear();
+    logged.clear();
+    count = 0;
+    writeErrors = 0;
+    std::error_code error;
+    
+    // The snapshot is sorted, so its head is the head of the index
+    uint32_t absorbed = 0;
+    uint64_t snapshotCount = 0;
+    if (FILE* file = std::fopen(path.c_str(), "rb")) {
+        uint8_t header[SNAPSHOT_HEADER_SIZE];
+        bool valid = std::fread(header, 1, sizeof(header), file) == sizeof(header) &&
+                     std::memcmp(header, SNAPSHOT_MAGIC, 4) == 0 && getBytes(header + 4, 4) == VERSION;
+        absorbed = (uint32_t)getBytes(header + 8, 4);
+        snapshotCount = getBytes(header + 16, 8);
+        valid = valid && std::filesystem::file_size(path, error) == SNAPSHOT_HEADER_SIZE + snapshotCount * RECORD_SIZE;
+        
+        size_t head = (size_t)std::min(snapshotCount, (uint64_t)TOP_KEPT);
+        std::vector<uint8_t> records(head * RECORD_SIZE);
+        valid = valid && std::fread(records.data(), 1, records.size(), file) == records.size();
+        top.resize(head);
+        for (size_t i = 0; i < head && valid; i++) {
+            valid = decodeRecord(&records[i * RECORD_SIZE], top[i]);
+        }
+        std::fclose(file);
+        if (!valid) {
+            top.clear();
+            return false;
+        }
+    }
+    
+    // Every valid record of the log, unless the snapshot already holds them
+    std::string logPath = path + ".log";
+    logStale = true;
+    generation = absorbed + 1;
+    if (FILE* file = std::fopen(logPath.c_str(), "rb")) {
+        uint8_t header[LOG_HEADER_SIZE];
+        bool valid = std::fread(header, 1, sizeof(header), file) == sizeof(header) &&
+                     std::memcmp(header, LOG_MAGIC, 4) == 0 && getBytes(header + 4, 4) == VERSION;
+        uint32_t logGeneration = (uint32_t)getBytes(header + 8, 4);
+        if (valid && logGeneration > absorbed) {
+            uint64_t size = std::filesystem::file_size(logPath, error);
+            std::vector<uint8_t> records((size_t)(size - std::min<uint64_t>(size, LOG_HEADER_SIZE)));
+            records.resize(std::fread(records.data(), 1, records.size(), file));
+            HighScore score;
+            for (size_t offset = 0; offset + RECORD_SIZE <= records.size(); offset += RECORD_SIZE) {
+                if (!decodeRecord(&records[offset], score)) break;
+                logged.push_back(score);
+            }
+            generation = logGeneration;
+            logStale = false;
+        }
+        std::fclose(file);
+        
+        // Drop a record torn by a crash so appends land after the good ones
+        uint64_t goodSize = LOG_HEADER_SIZE + logged.size() * RECORD_SIZE;
+        if (!logStale && std::filesystem::file_size(logPath, error) != goodSize) {
+            std::filesystem::resize_file(logPath, goodSize, error);
+            if (error) {
+                return false;
+            }
+        }
+    }
+    
+    std::vector<HighScore> sortedLog = logged;
+    std::sort(sortedLog.begin(), sortedLog.end(), ranksAbove);
+    size_t snapshotHead = top.size();
+    top.insert(top.end(), sortedLog.begin(), sortedLog.begin() + std::min(sortedLog.size(), (size_t)TOP_KEPT));
+    std::inplace_merge(top.begin(), top.begin() + snapshotHead, top.end(), ranksAbove);
+    if (top.size() > TOP_KEPT) {
+        top.resize(TOP_KEPT);
+    }
+    count = snapshotCount + logged.size();
+    loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    stopping = false;
+    ioThread = std::thread(&HighScoreStore::ioLoop, this);
+    return true;
+}
+
+void HighScoreStore::close() {
+    if (!ioThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    ioThread.join();
+}
+
+int HighScoreStore::add(HighScore score) {
+    score.sequence = (uint32_t)count;
+    count++;
+    auto position = std::upper_bound(top.begin(), top.end(), score, ranksAbove);
+    int rank = (int)(position - top.begin());
+    if (rank < (int)TOP_KEPT) {
+        top.insert(position, score);
+        if (top.size() > TOP_KEPT) {
+            top.pop_back();
+        }
+    } else {
+        rank = -1;
+    }
+    
+    if (ioThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(score);
+        }
+        wake.notify_one();
+    }
+    return rank;
+}
+
+uint64_t HighScoreStore::getWriteErrors() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeErrors;
+}
+
+// Appends whatever is queued; compacts only when nothing is, so a burst of
+// scores is written before the slower merge starts
+void HighScoreStore::ioLoop() {
+    std::vector<HighScore> batch;
+    bool compactFailed = false;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (!pending.empty()) {
+            batch.clear();
+            batch.swap(pending);
+            lock.unlock();
+            bool written = append(batch);
+            lock.lock();
+            if (!written) {
+                writeErrors += batch.size();
+            }
+            compactFailed = false;
+        } else if (logged.size() >= COMPACT_AFTER && !compactFailed) {
+            lock.unlock();
+            bool compacted = compact();
+            lock.lock();
+            if (!compacted) {
+                writeErrors++;
+                compactFailed = true;
+            }
+        } else if (stopping) {
+            break;
+        } else {
+            wake.wait(lock);
+        }
+    }
+}
+
+bool HighScoreStore::append(const std::vector<HighScore>& scores) {
+    if (logStale && !startLog(generation)) {
+        return false;
+    }
+    std::string logPath = path + ".log";
+    FILE* file = std::fopen(logPath.c_str(), "ab");
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> records(scores.size() * RECORD_SIZE);
+    for (size_t i = 0; i < scores.size(); i++) {
+        encodeRecord(&records[i * RECORD_SIZE], scores[i]);
+    }
+    bool written = std::fwrite(records.data(), 1, records.size(), file) == records.size();
+    written = syncFile(file) && written;
+    written = std::fclose(file) == 0 && written;
+    
+    // Cut a partial write back off so later appends stay readable
+    if (!written) {
+        std::error_code error;
+        std::filesystem::resize_file(logPath, LOG_HEADER_SIZE + logged.size() * RECORD_SIZE, error);
+        return false;
+    }
+    logged.insert(logged.end(), scores.begin(), scores.end());
+    return true;
+}
+
+// Streams the old snapshot and the sorted log into a new snapshot
+bool HighScoreStore::compact() {
+    std::string tempPath = path + ".tmp";
+    std::vector<HighScore> sortedLog = logged;
+    std::sort(sortedLog.begin(), sortedLog.end(), ranksAbove);
+    
+    FILE* in = std::fopen(path.c_str(), "rb");
+    uint64_t snapshotCount = 0;
+    if (in) {
+        uint8_t header[SNAPSHOT_HEADER_SIZE];
+        if (std::fread(header, 1, sizeof(header), in) != sizeof(header)) {
+            std::fclose(in);
+            return false;
+        }
+        snapshotCount = getBytes(header + 16, 8);
+    }
+    FILE* out = std::fopen(tempPath.c_str(), "wb");
+    if (!out) {
+        if (in) std::fclose(in);
+        return false;
+    }
+    
+    uint8_t header[SNAPSHOT_HEADER_SIZE] = {};
+    std::memcpy(header, SNAPSHOT_MAGIC, 4);
+    putBytes(header + 4, VERSION, 4);
+    putBytes(header + 8, generation, 4);
+    putBytes(header + 16, snapshotCount + sortedLog.size(), 8);
+    bool ok = std::fwrite(header, 1, sizeof(header), out) == sizeof(header);
+    
+    std::vector<uint8_t> inBlock(MERGE_BLOCK * RECORD_SIZE);
+    std::vector<uint8_t> outBlock;
+    outBlock.reserve(MERGE_BLOCK * RECORD_SIZE);
+    size_t inPos = 0;
+    size_t inEnd = 0;
+    uint64_t snapshotLeft = snapshotCount;
+    size_t logPos = 0;
+    HighScore snapshotScore;
+    bool haveSnapshotScore = false;
+    while (ok && (haveSnapshotScore || snapshotLeft > 0 || logPos < sortedLog.size())) {
+        if (!haveSnapshotScore && snapshotLeft > 0) {
+            if (inPos == inEnd) {
+                size_t records = (size_t)std::min<uint64_t>(snapshotLeft, MERGE_BLOCK);
+                ok = std::fread(inBlock.data(), RECORD_SIZE, records, in) == records;
+                inPos = 0;
+                inEnd = records * RECORD_SIZE;
+            }
+            ok = ok && decodeRecord(&inBlock[inPos], snapshotScore);
+            inPos += RECORD_SIZE;
+            snapshotLeft--;
+            haveSnapshotScore = true;
+        }
+        const HighScore* next;
+        if (haveSnapshotScore && (logPos == sortedLog.size() || !ranksAbove(sortedLog[logPos], snapshotScore))) {
+            next = &snapshotScore;
+            haveSnapshotScore = false;
+        } else {
+            next = &sortedLog[logPos++];
+        }
+        outBlock.resize(outBlock.size() + RECORD_SIZE);
+        encodeRecord(&outBlock[outBlock.size() - RECORD_SIZE], *next);
+        if (outBlock.size() == outBlock.capacity()) {
+            ok = ok && std::fwrite(outBlock.data(), 1, outBlock.size(), out) == outBlock.size();
+            outBlock.clear();
+        }
+    }
+    ok = ok && std::fwrite(outBlock.data(), 1, outBlock.size(), out) == outBlock.size();
+    ok = syncFile(out) && ok;
+    ok = std::fclose(out) == 0 && ok;
+    if (in) std::fclose(in);
+    
+    std::error_code error;
+    if (!ok || !replaceFile(tempPath, path)) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    // The snapshot now holds this generation; a crash before the new log is
+    // in place leaves the old one, which the next load skips. Move past it
+    // right away, so a new log started by a retry is one the load reads.
+    generation++;
+    logStale = true;
+    logged.clear();
+    return startLog(generation);
+}
+
+bool HighScoreStore::startLog(uint32_t newGeneration) {
+    std::string logPath = path + ".log";
+    std::string tempPath = logPath + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    uint8_t header[LOG_HEADER_SIZE] = {};
+    std::memcpy(header, LOG_MAGIC, 4);
+    putBytes(header + 4, VERSION, 4);
+    putBytes(header + 8, newGeneration, 4);
+    bool ok = std::fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    ok = syncFile(file) && ok;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || !replaceFile(tempPath, logPath)) {
+        std::error_code error;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    generation = newGeneration;
+    logged.clear();
+    logStale = false;
+    return true;
+}
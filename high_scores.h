@@ -0,0 +1,115 @@
+// Space Ping Pong - persistent high scores
+//
+// Scores live in two files. PATH is a snapshot holding every score ever
+// recorded, sorted best first; PATH.log is an append-only log of the scores
+// added since the snapshot was written. Both are arrays of fixed-size,
+// individually checksummed records behind a small header.
+//
+// Only the best TOP_KEPT scores are kept in memory, sorted, and that is all
+// the high-score screen reads. Because the snapshot is sorted, loading needs
+// just its first TOP_KEPT records plus the log, however many scores are
+// stored.
+//
+// add() updates the in-memory index at once and hands the record to a
+// background I/O thread, which appends it to the log. Once the log holds
+// COMPACT_AFTER records and no writes are waiting, the thread merges it into
+// a new snapshot written to PATH.tmp, flushed to disk and renamed over PATH,
+// then starts an empty log the same way. Every log carries a generation
+// number and the snapshot records the last generation it absorbed, so a
+// crash between the two renames cannot count a log twice. A crash in the
+// middle of an append leaves a torn last record, which the next load drops.
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint8_t HUMAN_OPPONENT = 255;     // HighScore::difficulty of a vs Human match
+
+// One won match
+struct HighScore {
+    uint64_t time;          // Unix seconds
+    uint32_t durationMs;
+    uint32_t sequence;      // Order added; breaks ties
+    uint8_t winner;         // 1 or 2
+    uint8_t winnerScore;
+    uint8_t loserScore;
+    uint8_t difficulty;     // Of the computer opponent, or HUMAN_OPPONENT
+    
+    HighScore() : time(0), durationMs(0), sequence(0), winner(1), winnerScore(0), loserScore(0), difficulty(0) {}
+};
+
+// Wider margins first, then harder opponents, then quicker wins, then older
+bool ranksAbove(const HighScore& a, const HighScore& b);
+
+class HighScoreStore {
+public:
+    static const size_t TOP_KEPT = 100;
+    static const size_t COMPACT_AFTER = 4096;
+    
+    HighScoreStore();
+    ~HighScoreStore();
+    
+    HighScoreStore(const HighScoreStore&) = delete;
+    HighScoreStore& operator=(const HighScoreStore&) = delete;
+    
+    // Loads the index and starts the I/O thread. Missing files are an empty
+    // store; false if the files exist but cannot be used.
+    bool open(const std::string& path);
+    
+    // Writes everything still queued and stops the I/O thread
+    void close();
+    
+    bool isOpen() const {
+        return ioThread.joinable();
+    }
+    
+    // Returns the score's rank from 0, or -1 if it is outside the index.
+    // Never waits on the disk.
+    int add(HighScore score);
+    
+    // The best scores, best first; at most TOP_KEPT
+    const std::vector<HighScore>& getTop() const {
+        return top;
+    }
+    
+    // Every score stored, including those not in the index
+    uint64_t getCount() const {
+        return count;
+    }
+    
+    // Writes that failed on the I/O thread so far
+    uint64_t getWriteErrors() const;
+    
+    double getLoadMs() const {
+        return loadMs;
+    }
+    
+private:
+    std::string path;
+    std::vector<HighScore> top;
+    uint64_t count;
+    double loadMs;
+    
+    // Shared with the I/O thread
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<HighScore> pending;
+    bool stopping;
+    uint64_t writeErrors;
+    
+    // Owned by the I/O thread once it runs
+    std::thread ioThread;
+    std::vector<HighScore> logged;  // Records in the current log
+    uint32_t generation;            // Of the current log, or of the next while stale
+    bool logStale;                  // Log already absorbed by the snapshot
+    
+    void ioLoop();
+    bool append(const std::vector<HighScore>& scores);
+    bool compact();
+    bool startLog(uint32_t newGeneration);
+};
@@ -0,0 +1,212 @@
+// Space Ping Pong - input recording and replay
+#include "input_recording.h"
+
+#include <cstdio>
+
+namespace {
+
+const char MAGIC[4] = {'S', 'P', 'I', 'R'};
+const uint8_t VERSION = 4;      // 2: swept balls, 3: predicting AI, 4: AI arrival heap
+
+void putBytes(std::vector<uint8_t>& out, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        out.push_back((uint8_t)(value >> (i * 8)));
+    }
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// Bounds-checked reader; any read past the end marks the whole parse failed
+struct Reader {
+    const std::vector<uint8_t>& data;
+    size_t pos;
+    bool failed;
+    
+    explicit Reader(const std::vector<uint8_t>& data) : data(data), pos(0), failed(false) {}
+    
+    uint64_t bytes(int count) {
+        uint64_t value = 0;
+        for (int i = 0; i < count; i++) {
+            if (pos >= data.size()) {
+                failed = true;
+                return 0;
+            }
+            value |= (uint64_t)data[pos++] << (i * 8);
+        }
+        return value;
+    }
+    
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= data.size()) {
+                failed = true;
+                return 0;
+            }
+            uint8_t byte = data[pos++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+};
+
+}
+
+uint8_t packInputs(const PaddleInput& input1, const PaddleInput& input2) {
+    return (uint8_t)((input1.up ? 1 : 0) | (input1.down ? 2 : 0) | (input2.up ? 4 : 0) | (input2.down ? 8 : 0));
+}
+
+void unpackInputs(uint8_t bits, PaddleInput& input1, PaddleInput& input2) {
+    input1 = PaddleInput((bits & 1) != 0, (bits & 2) != 0);
+    input2 = PaddleInput((bits & 4) != 0, (bits & 8) != 0);
+}
+
+InputRecording::InputRecording()
+    : seed(0), tickRate(FPS), difficulty(Difficulty::MEDIUM), player1Human(true), player2Human(false),
+      finalChecksum(0) {}
+
+void InputRecording::start(uint64_t matchSeed, int rate, Difficulty matchDifficulty, bool human1, bool human2) {
+    seed = matchSeed;
+    tickRate = rate;
+    difficulty = matchDifficulty;
+    player1Human = human1;
+    player2Human = human2;
+    inputs.clear();
+    rateChanges.clear();
+    finalChecksum = 0;
+}
+
+void InputRecording::record(const PaddleInput& input1, const PaddleInput& input2, int rate) {
+    int current = rateChanges.empty() ? tickRate : rateChanges.back().tickRate;
+    if (inputs.empty()) {
+        tickRate = rate;
+    } else if (rate != current) {
+        rateChanges.push_back({(uint32_t)inputs.size(), rate});
+    }
+    inputs.push_back(packInputs(input1, input2));
+}
+
+bool InputRecording::save(const std::string& path) const {
+    std::vector<uint8_t> out(MAGIC, MAGIC + 4);
+    out.push_back(VERSION);
+    putBytes(out, seed, 8);
+    putVarint(out, (uint64_t)tickRate);
+    out.push_back((uint8_t)difficulty);
+    out.push_back((uint8_t)((player1Human ? 1 : 0) | (player2Human ? 2 : 0)));
+    putBytes(out, finalChecksum, 8);
+    
+    putVarint(out, rateChanges.size());
+    for (const RateChange& change : rateChanges) {
+        putVarint(out, change.tick);
+        putVarint(out, (uint64_t)change.tickRate);
+    }
+    
+    // Runs of identical inputs
+    putVarint(out, inputs.size());
+    for (size_t i = 0; i < inputs.size();) {
+        size_t run = 1;
+        while (i + run < inputs.size() && inputs[i + run] == inputs[i]) {
+            run++;
+        }
+        out.push_back(inputs[i]);
+        putVarint(out, run);
+        i += run;
+    }
+    
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return std::fclose(file) == 0 && written;
+}
+
+bool InputRecording::load(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    std::fclose(file);
+    
+    Reader reader(data);
+    for (char c : MAGIC) {
+        if (reader.bytes(1) != (uint8_t)c) return false;
+    }
+    if (reader.bytes(1) != VERSION) return false;
+    
+    InputRecording loaded;
+    loaded.seed = reader.bytes(8);
+    loaded.tickRate = (int)reader.varint();
+    uint64_t difficultyValue = reader.bytes(1);
+    uint64_t flags = reader.bytes(1);
+    loaded.finalChecksum = reader.bytes(8);
+    if (difficultyValue > (uint64_t)Difficulty::HARD || loaded.tickRate <= 0) return false;
+    loaded.difficulty = (Difficulty)difficultyValue;
+    loaded.player1Human = (flags & 1) != 0;
+    loaded.player2Human = (flags & 2) != 0;
+    
+    uint64_t changes = reader.varint();
+    for (uint64_t i = 0; i < changes && !reader.failed; i++) {
+        RateChange change;
+        change.tick = (uint32_t)reader.varint();
+        change.tickRate = (int)reader.varint();
+        if (change.tickRate <= 0) return false;
+        loaded.rateChanges.push_back(change);
+    }
+    
+    uint64_t ticks = reader.varint();
+    while (loaded.inputs.size() < ticks && !reader.failed) {
+        uint8_t bits = (uint8_t)reader.bytes(1);
+        uint64_t run = reader.varint();
+        if (run == 0 || run > ticks - loaded.inputs.size()) return false;
+        loaded.inputs.insert(loaded.inputs.end(), (size_t)run, bits);
+    }
+    if (reader.failed) {
+        return false;
+    }
+    
+    *this = loaded;
+    return true;
+}
+
+InputPlayer::InputPlayer(const InputRecording& recording)
+    : recording(recording), tick(0), nextChange(0), tickRate(recording.tickRate) {}
+
+int InputPlayer::next(PaddleInput& input1, PaddleInput& input2) {
+    while (nextChange < recording.rateChanges.size() && recording.rateChanges[nextChange].tick <= tick) {
+        tickRate = recording.rateChanges[nextChange].tickRate;
+        nextChange++;
+    }
+    unpackInputs(recording.inputs[tick], input1, input2);
+    tick++;
+    return tickRate;
+}
+
+bool replayMatch(const InputRecording& recording, Match& match) {
+    match.difficulty = recording.difficulty;
+    match.reset(recording.player1Human, recording.player2Human, recording.seed);
+    
+    InputPlayer player(recording);
+    PaddleInput input1, input2;
+    while (!player.done()) {
+        int rate = player.next(input1, input2);
+        match.tick((float)FPS / rate, input1, input2);
+    }
+    return match.checksum() == recording.finalChecksum;
+}
@@ -0,0 +1,74 @@
+// Space Ping Pong - input recording and replay
+//
+// A match is fully determined by its seed, its settings and both paddles'
+// controls on every tick, so that is all a recording holds. On disk the
+// per-tick inputs are run-length encoded; held keys cost a few bytes per
+// second of play. The checksum of the final match state lets a replay prove
+// it reproduced the match bit for bit.
+#pragma once
+
+#include "pingpong_sim.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tick rate in effect from a tick onwards
+struct RateChange {
+    uint32_t tick;
+    int tickRate;
+};
+
+class InputRecording {
+public:
+    uint64_t seed;
+    int tickRate;               // At the first tick
+    Difficulty difficulty;
+    bool player1Human;
+    bool player2Human;
+    std::vector<uint8_t> inputs;            // One packInputs() value per tick
+    std::vector<RateChange> rateChanges;
+    uint64_t finalChecksum;     // Match::checksum() after the last tick
+    
+    InputRecording();
+    
+    // Forget any ticks and describe a new match
+    void start(uint64_t matchSeed, int rate, Difficulty matchDifficulty, bool human1, bool human2);
+    
+    // Append one tick played at the given rate
+    void record(const PaddleInput& input1, const PaddleInput& input2, int rate);
+    
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+// Packs both paddles' controls into the low four bits
+uint8_t packInputs(const PaddleInput& input1, const PaddleInput& input2);
+void unpackInputs(uint8_t bits, PaddleInput& input1, PaddleInput& input2);
+
+// Feeds a recording back tick by tick
+class InputPlayer {
+public:
+    explicit InputPlayer(const InputRecording& recording);
+    
+    bool done() const {
+        return tick >= recording.inputs.size();
+    }
+    
+    // Inputs of the next tick; returns the tick rate it was played at
+    int next(PaddleInput& input1, PaddleInput& input2);
+    
+    size_t getTick() const {
+        return tick;
+    }
+    
+private:
+    const InputRecording& recording;
+    size_t tick;
+    size_t nextChange;
+    int tickRate;
+};
+
+// Plays a whole recording on a match, as fast as possible. Returns true if
+// the final state matches the recorded checksum.
+bool replayMatch(const InputRecording& recording, Match& match);
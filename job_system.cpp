@@ -0,0 +1,139 @@
+// Space Ping Pong - work-stealing job system
+#include "job_system.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(int workers) : body(nullptr), remaining(0), queued(0), stopping(false) {
+    start(workers);
+}
+
+JobSystem::~JobSystem() {
+    stop();
+}
+
+void JobSystem::setWorkerCount(int workers) {
+    stop();
+    start(workers);
+}
+
+int JobSystem::defaultWorkerCount(int limit) {
+    int hardware = (int)std::thread::hardware_concurrency();
+    return std::max(1, std::min(limit, hardware));
+}
+
+void JobSystem::start(int workers) {
+    workers = std::max(1, workers);
+    stopping = false;
+    queues.clear();
+    for (int i = 0; i < workers; i++) {
+        queues.emplace_back(new WorkQueue());
+    }
+    for (int i = 1; i < workers; i++) {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const RangeFunction& run) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || queues.size() == 1) {
+        for (size_t begin = 0; begin < count; begin += grain) {
+            run(begin, std::min(count, begin + grain));
+        }
+        return;
+    }
+    
+    body = &run;
+    remaining.store(chunks);
+    
+    // Counted before any chunk is visible: a worker still draining the last
+    // call may take one at once, and its decrement must not be overwritten
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        queued.fetch_add((int)chunks);
+    }
+    
+    // Deal contiguous runs of chunks to each worker, so neighbouring chunks
+    // usually stay on one core unless they get stolen
+    size_t workers = queues.size();
+    for (size_t w = 0; w < workers; w++) {
+        size_t first = chunks * w / workers;
+        size_t last = chunks * (w + 1) / workers;
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        for (size_t c = first; c < last; c++) {
+            size_t begin = c * grain;
+            queues[w]->chunks.push_back({begin, std::min(count, begin + grain)});
+        }
+    }
+    wake.notify_all();
+    
+    // Work on the caller's own share and steal until everything has run
+    while (remaining.load() > 0) {
+        if (!runOne(0)) {
+            std::this_thread::yield();
+        }
+    }
+    body = nullptr;
+}
+
+void JobSystem::workerLoop(int index) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping) return;
+        }
+        while (runOne(index)) {
+        }
+    }
+}
+
+bool JobSystem::runOne(int index) {
+    Chunk chunk;
+    if (!take(index, chunk)) {
+        return false;
+    }
+    queued.fetch_sub(1);
+    (*body)(chunk.begin, chunk.end);
+    remaining.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::take(int index, Chunk& chunk) {
+    // Own work first, newest end
+    {
+        WorkQueue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+    
+    // Then steal the oldest chunk from someone else
+    int workers = (int)queues.size();
+    for (int offset = 1; offset < workers; offset++) {
+        WorkQueue& victim = *queues[(index + offset) % workers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
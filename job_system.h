@@ -0,0 +1,72 @@
+// Space Ping Pong - work-stealing job system
+//
+// A fixed set of workers, each with its own deque of chunks. parallelFor
+// deals chunks out to all deques; a worker pops from the back of its own
+// deque and, when that is empty, steals from the front of the others. The
+// calling thread counts as worker 0 and works until every chunk is done,
+// so one worker means plain serial execution on the caller.
+//
+// Chunk boundaries depend only on the count and grain, never on how many
+// workers there are, so bodies that write disjoint ranges give identical
+// results for any worker count. parallelFor must not be called from inside
+// a body.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem {
+public:
+    typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+    
+    explicit JobSystem(int workers = 1);
+    ~JobSystem();
+    
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    
+    // Stops and restarts the worker threads
+    void setWorkerCount(int workers);
+    int getWorkerCount() const { return (int)queues.size(); }
+    
+    // Calls body over [0, count) in chunks of at most grain elements and
+    // returns when all of them have finished
+    void parallelFor(size_t count, size_t grain, const RangeFunction& body);
+    
+    // Hardware threads, clamped to [1, limit]
+    static int defaultWorkerCount(int limit);
+    
+private:
+    struct Chunk {
+        size_t begin;
+        size_t end;
+    };
+    
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+    
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+    const RangeFunction* body;      // Body of the running parallelFor
+    std::atomic<size_t> remaining;  // Chunks not yet finished
+    std::atomic<int> queued;        // Chunks not yet taken from a queue
+    
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping;
+    
+    void start(int workers);
+    void stop();
+    void workerLoop(int index);
+    bool runOne(int index);
+    bool take(int index, Chunk& chunk);
+};
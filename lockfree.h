@@ -0,0 +1,107 @@
+// Space Ping Pong - lock-free handoff between two threads
+//
+// SpscQueue carries messages from one producer thread to one consumer
+// thread through a fixed ring; neither side ever blocks, and a push into a
+// full queue fails instead of waiting.
+//
+// TripleBuffer hands whole values from a writer to a reader, the reader
+// always getting the newest one. The writer fills a back slot and publishes
+// it by swapping it with the middle slot; the reader takes the middle slot
+// in exchange for its front slot when a fresh one is there. Each side only
+// ever touches its own slot, so a slow reader never holds up the writer
+// and skips values it was too slow to see.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity) : head(0), tail(0) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+    
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    
+    // Producer side; false if the queue is full
+    bool push(const T& value) {
+        size_t end = tail.load(std::memory_order_relaxed);
+        if (end - head.load(std::memory_order_acquire) == slots.size()) {
+            return false;
+        }
+        slots[end & mask] = value;
+        tail.store(end + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer side; false if the queue is empty
+    bool pop(T& value) {
+        size_t start = head.load(std::memory_order_relaxed);
+        if (start == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[start & mask];
+        head.store(start + 1, std::memory_order_release);
+        return true;
+    }
+    
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;   // Next to pop; written by the consumer
+    alignas(64) std::atomic<size_t> tail;   // Next to push; written by the producer
+};
+
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back(0), middle(1), front(2) {}
+    
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+    
+    // Writer side: fill the back slot, then publish it. The slot handed
+    // back afterwards holds an older value, to be overwritten.
+    T& getBack() {
+        return slots[back];
+    }
+    
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+    
+    // True while the last published value has not been taken
+    bool isUnread() const {
+        return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+    }
+    
+    // Reader side: switch to the newest value, if one was published since
+    // the last call; false if the front slot is still the newest
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    
+    const T& getFront() const {
+        return slots[front];
+    }
+    
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+    
+    T slots[3];
+    int back;                   // Writer's slot
+    std::atomic<int> middle;    // Last published slot, with FRESH until taken
+    int front;                  // Reader's slot
+};
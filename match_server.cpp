@@ -0,0 +1,490 @@
+// Space Ping Pong - dedicated match server (Linux)
+#include "match_server.h"
+#include "input_recording.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t NS_PER_SECOND = 1000000000ull;
+
+bool watch(int epollFd, int fd) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void closeFd(int& fd) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+uint64_t threadCpuNs() {
+    timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    return (uint64_t)cpu.tv_sec * NS_PER_SECOND + cpu.tv_nsec;
+}
+
+uint64_t addressKey(const NetAddress& address) {
+    return ((uint64_t)address.host << 16) | address.port;
+}
+
+}
+
+RoomWorker::RoomWorker(const ServerOptions& options)
+    : options(options), epollFd(-1), timerFd(-1), wakeFd(-1), stopping(false), sendAccumulator(0),
+      lastReport(0) {}
+
+RoomWorker::~RoomWorker() {
+    stop();
+}
+
+bool RoomWorker::start() {
+    if (!socket.open(0)) {
+        return false;
+    }
+    epollFd = epoll_create1(0);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    wakeFd = eventfd(0, EFD_NONBLOCK);
+    if (epollFd < 0 || timerFd < 0 || wakeFd < 0) {
+        return false;
+    }
+    
+    uint64_t period = NS_PER_SECOND / options.tickRate;
+    itimerspec spec = {};
+    spec.it_interval.tv_sec = period / NS_PER_SECOND;
+    spec.it_interval.tv_nsec = period % NS_PER_SECOND;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(timerFd, 0, &spec, nullptr) != 0) {
+        return false;
+    }
+    if (!watch(epollFd, (int)socket.getHandle()) || !watch(epollFd, timerFd) || !watch(epollFd, wakeFd)) {
+        return false;
+    }
+    
+    lastReport = traceNow();
+    thread = std::thread(&RoomWorker::run, this);
+    return true;
+}
+
+void RoomWorker::stop() {
+    if (thread.joinable()) {
+        stopping = true;
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            // The worker still wakes on its next tick
+        }
+        thread.join();
+    }
+    closeFd(epollFd);
+    closeFd(timerFd);
+    closeFd(wakeFd);
+    socket.close();
+}
+
+void RoomWorker::addRoom(uint32_t id, uint64_t seed) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        newRooms.push_back({id, seed});
+    }
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // Picked up on the next tick instead
+    }
+}
+
+WorkerReport RoomWorker::getReport() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return report;
+}
+
+std::vector<uint32_t> RoomWorker::takeClosedRooms() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint32_t> closed;
+    closed.swap(closedRooms);
+    return closed;
+}
+
+void RoomWorker::run() {
+    const int socketFd = (int)socket.getHandle();
+    epoll_event events[4];
+    while (!stopping) {
+        int count = epoll_wait(epollFd, events, 4, 1000);
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == socketFd) {
+                receive();
+            } else if (fd == timerFd) {
+                uint64_t expirations = 0;
+                if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    // Catch up a little after a stall, drop the rest
+                    int ticks = (int)std::min<uint64_t>(expirations, MAX_CATCH_UP_TICKS);
+                    totals.overruns += expirations - ticks;
+                    tick(ticks);
+                }
+            } else if (fd == wakeFd) {
+                uint64_t value;
+                if (read(wakeFd, &value, sizeof(value)) == sizeof(value)) {
+                    openRooms();
+                }
+            }
+        }
+        
+        uint64_t now = traceNow();
+        if (now - lastReport >= NS_PER_SECOND) {
+            publishReport(now);
+        }
+    }
+}
+
+void RoomWorker::openRooms() {
+    std::vector<NewRoom> added;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        added.swap(newRooms);
+    }
+    uint64_t now = traceNow();
+    for (const NewRoom& newRoom : added) {
+        Room& room = rooms[newRoom.id];
+        room.id = newRoom.id;
+        room.match.reset(true, true, newRoom.seed);
+        room.tick = 0;
+        room.created = now;
+        room.busyNs = 0;
+        room.reportedBusyNs = 0;
+    }
+}
+
+void RoomWorker::receive() {
+    uint8_t buffer[MAX_SERVER_PACKET];
+    NetAddress from;
+    size_t size;
+    while ((size = socket.receiveFrom(from, buffer, sizeof(buffer))) > 0) {
+        PacketReader packet(buffer, size);
+        if (packet.getType() != ServerPacket::INPUT && packet.getType() != ServerPacket::LEAVE) {
+            continue;
+        }
+        uint32_t id = packet.u32();
+        uint8_t slot = packet.u8();
+        uint8_t bits = packet.getType() == ServerPacket::INPUT ? packet.u8() : 0;
+        auto it = rooms.find(id);
+        if (!packet.isValid() || (slot != 1 && slot != 2) || it == rooms.end()) {
+            continue;
+        }
+        
+        // A seat belongs to the first address heard from on it
+        Seat& seat = it->second.seats[slot - 1];
+        if (seat.joined && !(seat.address == from)) {
+            continue;
+        }
+        if (packet.getType() == ServerPacket::LEAVE) {
+            closeRoom(id);
+            continue;
+        }
+        seat.address = from;
+        seat.joined = true;
+        seat.lastHeard = traceNow();
+        PaddleInput unused;
+        unpackInputs(bits, seat.input, unused);
+    }
+}
+
+void RoomWorker::tick(int ticks) {
+    const float step = (float)FPS / options.tickRate;
+    
+    // All rooms of a worker send on the same ticks
+    sendAccumulator += options.sendRate * ticks;
+    bool send = sendAccumulator >= options.tickRate;
+    if (send) {
+        sendAccumulator %= options.tickRate;
+    }
+    
+    uint64_t now = traceNow();
+    std::vector<uint32_t> finished;
+    for (auto& entry : rooms) {
+        Room& room = entry.second;
+        bool abandoned = false;
+        for (const Seat& seat : room.seats) {
+            uint64_t heard = seat.joined ? seat.lastHeard : room.created;
+            abandoned = abandoned || now - std::min(heard, now) > SEAT_TIMEOUT_NS;
+        }
+        if (abandoned) {
+            finished.push_back(room.id);
+            continue;
+        }
+        if (!room.isPlaying()) {
+            continue;
+        }
+        
+        uint64_t start = traceNow();
+        for (int i = 0; i < ticks && !room.match.over; i++) {
+            room.match.tick(step, room.seats[0].input, room.seats[1].input);
+            room.tick++;
+            totals.roomTicks++;
+        }
+        if (send || room.match.over) {
+            sendState(room);
+        }
+        uint64_t busy = traceNow() - start;
+        room.busyNs += busy;
+        totals.roomBusyNs += busy;
+        
+        if (room.match.over) {
+            totals.matchesFinished++;
+            finished.push_back(room.id);
+        }
+    }
+    for (uint32_t id : finished) {
+        closeRoom(id);
+    }
+}
+
+void RoomWorker::sendState(Room& room) {
+    PacketWriter packet(ServerPacket::STATE);
+    writeState(packet, room.id, room.tick, room.match);
+    for (const Seat& seat : room.seats) {
+        socket.sendTo(seat.address, packet.data(), packet.size());
+        totals.statesSent++;
+    }
+}
+
+void RoomWorker::closeRoom(uint32_t id) {
+    rooms.erase(id);
+    std::lock_guard<std::mutex> lock(mutex);
+    closedRooms.push_back(id);
+}
+
+void RoomWorker::publishReport(uint64_t now) {
+    totals.cpuNs = threadCpuNs();
+    totals.rooms = (uint32_t)rooms.size();
+    totals.playingRooms = 0;
+    totals.heaviestRoom = 0;
+    totals.heaviestRoomBusyNs = 0;
+    for (auto& entry : rooms) {
+        Room& room = entry.second;
+        if (room.isPlaying()) {
+            totals.playingRooms++;
+        }
+        uint64_t busy = room.busyNs - room.reportedBusyNs;
+        room.reportedBusyNs = room.busyNs;
+        if (busy > totals.heaviestRoomBusyNs) {
+            totals.heaviestRoom = room.id;
+            totals.heaviestRoomBusyNs = busy;
+        }
+    }
+    lastReport = now;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    report = totals;
+}
+
+MatchServer::MatchServer(const ServerOptions& options)
+    : options(options), epollFd(-1), seeds(options.seed, MATCH_SEED_STREAM), nextRoomId(1), waitingRoom(0),
+      started(0), lastStatsTime(0) {}
+
+MatchServer::~MatchServer() {
+    workers.clear();
+    if (epollFd >= 0) {
+        ::close(epollFd);
+    }
+}
+
+bool MatchServer::start() {
+    if (!socket.open(options.port)) {
+        std::cerr << "Could not open lobby port " << options.port << std::endl;
+        return false;
+    }
+    epollFd = epoll_create1(0);
+    if (epollFd < 0 || !watch(epollFd, (int)socket.getHandle())) {
+        std::cerr << "Could not create epoll instance" << std::endl;
+        return false;
+    }
+    
+    for (int i = 0; i < options.workers; i++) {
+        workers.push_back(std::unique_ptr<RoomWorker>(new RoomWorker(options)));
+        if (!workers.back()->start()) {
+            std::cerr << "Could not start worker " << i << std::endl;
+            return false;
+        }
+    }
+    workerRooms.assign(workers.size(), 0);
+    
+    started = traceNow();
+    lastStatsTime = started;
+    std::cout << "Lobby on UDP port " << socket.getLocalPort() << ", " << workers.size() << " workers, "
+              << options.tickRate << " ticks/s, state sent " << options.sendRate << " times/s" << std::endl;
+    return true;
+}
+
+void MatchServer::run(const volatile std::sig_atomic_t& stop) {
+    epoll_event events[4];
+    while (!stop) {
+        if (epoll_wait(epollFd, events, 4, 100) > 0) {
+            receive();
+        }
+        collectClosedRooms();
+        
+        uint64_t now = traceNow();
+        if (options.statsInterval > 0 && now - lastStatsTime >= options.statsInterval * NS_PER_SECOND) {
+            printStats(now);
+        }
+    }
+}
+
+ServerStats MatchServer::getStats() {
+    std::vector<WorkerReport> reports;
+    for (auto& worker : workers) {
+        reports.push_back(worker->getReport());
+    }
+    return sumReports(reports);
+}
+
+void MatchServer::receive() {
+    uint8_t buffer[MAX_SERVER_PACKET];
+    NetAddress from;
+    size_t size;
+    while ((size = socket.receiveFrom(from, buffer, sizeof(buffer))) > 0) {
+        PacketReader packet(buffer, size);
+        if (packet.getType() == ServerPacket::JOIN) {
+            uint32_t nonce = packet.u32();
+            if (packet.isValid()) {
+                seat(from, nonce);
+            }
+        } else if (packet.getType() == ServerPacket::STATS_REQUEST && packet.isValid()) {
+            PacketWriter reply(ServerPacket::STATS);
+            writeStats(reply, getStats());
+            socket.sendTo(from, reply.data(), reply.size());
+        }
+    }
+}
+
+// Fill the waiting room first, otherwise open one on the least busy worker
+void MatchServer::seat(const NetAddress& from, uint32_t nonce) {
+    uint64_t key = addressKey(from);
+    auto it = seated.find(key);
+    if (it != seated.end() && it->second.nonce == nonce) {
+        // The assignment was lost; JOIN is resent until one arrives
+        sendAssignment(from, it->second.assignment);
+        return;
+    }
+    
+    SeatAssignment assignment;
+    assignment.nonce = nonce;
+    if (waitingRoom != 0) {
+        assignment.roomId = waitingRoom;
+        assignment.slot = 2;
+        waitingRoom = 0;
+    } else {
+        if ((int)roomWorkers.size() >= options.maxRooms) {
+            PacketWriter full(ServerPacket::FULL);
+            full.u32(nonce);
+            socket.sendTo(from, full.data(), full.size());
+            return;
+        }
+        size_t worker = std::min_element(workerRooms.begin(), workerRooms.end()) - workerRooms.begin();
+        assignment.roomId = nextRoomId;
+        assignment.slot = 1;
+        nextRoomId = nextRoomId == UINT32_MAX ? 1 : nextRoomId + 1;
+        
+        workers[worker]->addRoom(assignment.roomId, seeds.next64());
+        roomWorkers[assignment.roomId] = worker;
+        workerRooms[worker]++;
+        waitingRoom = assignment.roomId;
+    }
+    assignment.workerPort = workers[roomWorkers[assignment.roomId]]->getPort();
+    
+    seated[key] = {nonce, assignment};
+    roomClients[assignment.roomId].push_back(key);
+    sendAssignment(from, assignment);
+}
+
+void MatchServer::sendAssignment(const NetAddress& to, const SeatAssignment& assignment) {
+    PacketWriter packet(ServerPacket::ASSIGN);
+    writeAssignment(packet, assignment);
+    socket.sendTo(to, packet.data(), packet.size());
+}
+
+void MatchServer::collectClosedRooms() {
+    for (size_t worker = 0; worker < workers.size(); worker++) {
+        for (uint32_t id : workers[worker]->takeClosedRooms()) {
+            if (waitingRoom == id) {
+                waitingRoom = 0;
+            }
+            for (uint64_t key : roomClients[id]) {
+                auto it = seated.find(key);
+                if (it != seated.end() && it->second.assignment.roomId == id) {
+                    seated.erase(it);
+                }
+            }
+            roomClients.erase(id);
+            roomWorkers.erase(id);
+            workerRooms[worker]--;
+        }
+    }
+}
+
+ServerStats MatchServer::sumReports(const std::vector<WorkerReport>& reports) const {
+    ServerStats stats;
+    stats.workers = (uint32_t)reports.size();
+    stats.wallNs = traceNow() - started;
+    for (const WorkerReport& report : reports) {
+        stats.rooms += report.rooms;
+        stats.playingRooms += report.playingRooms;
+        stats.cpuNs += report.cpuNs;
+        stats.roomBusyNs += report.roomBusyNs;
+        stats.roomTicks += report.roomTicks;
+        stats.statesSent += report.statesSent;
+        stats.matchesFinished += report.matchesFinished;
+    }
+    return stats;
+}
+
+void MatchServer::printStats(uint64_t now) {
+    std::vector<WorkerReport> reports;
+    for (auto& worker : workers) {
+        reports.push_back(worker->getReport());
+    }
+    ServerStats stats = sumReports(reports);
+    
+    uint64_t overruns = 0;
+    WorkerReport heaviest;
+    for (const WorkerReport& report : reports) {
+        overruns += report.overruns;
+        if (report.heaviestRoomBusyNs >= heaviest.heaviestRoomBusyNs) {
+            heaviest = report;
+        }
+    }
+    
+    double seconds = (double)(now - lastStatsTime) / NS_PER_SECOND;
+    double cores = (stats.cpuNs - lastStats.cpuNs) / 1e9 / seconds;
+    uint64_t ticks = stats.roomTicks - lastStats.roomTicks;
+    double busyPerRoom = stats.playingRooms > 0
+        ? (stats.roomBusyNs - lastStats.roomBusyNs) / 1e3 / seconds / stats.playingRooms : 0.0;
+    
+    char buffer[320];
+    std::snprintf(buffer, sizeof(buffer),
+                  "rooms %u (%u playing), %.0f room ticks/s, %.2f us CPU per room tick, "
+                  "room busy %.1f us/s avg, heaviest #%u %.1f us/s, workers %.1f%% of a core, "
+                  "%.0f rooms per core, %llu matches, %llu overruns",
+                  stats.rooms, stats.playingRooms, ticks / seconds,
+                  ticks > 0 ? (stats.cpuNs - lastStats.cpuNs) / 1e3 / ticks : 0.0,
+                  busyPerRoom, heaviest.heaviestRoom, heaviest.heaviestRoomBusyNs / 1e3, cores * 100,
+                  cores > 0 ? stats.playingRooms / cores : 0.0,
+                  (unsigned long long)stats.matchesFinished, (unsigned long long)overruns);
+    std::cout << buffer << std::endl;
+    
+    lastStats = stats;
+    lastStatsTime = now;
+}
@@ -0,0 +1,179 @@
+// Space Ping Pong - dedicated match server (Linux)
+//
+// The authoritative simulation of many matches at once, with no renderer.
+// The lobby, on the caller's thread, seats clients two to a room and hands
+// each new room to the worker with the fewest rooms. Every worker owns its
+// rooms outright: its own UDP socket for their clients, and one epoll loop
+// that wakes on packets, on its tick timer and on rooms handed over by the
+// lobby. Nothing is shared between workers but counters.
+//
+// Each room's ticking and sending is timed on its own, so the lobby can
+// report what a room costs alongside what the worker threads burn.
+#pragma once
+
+#include "netplay.h"
+#include "pingpong_sim.h"
+#include "random.h"
+#include "server_protocol.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct ServerOptions {
+    uint16_t port;          // Lobby port
+    int workers;
+    int tickRate;           // Simulation ticks per second
+    int sendRate;           // State packets per second to each client
+    int maxRooms;
+    double statsInterval;   // Seconds between reports; 0 = off
+    uint64_t seed;          // Of every room's match seed
+    
+    ServerOptions() : port(27960), workers(1), tickRate(FPS), sendRate(30), maxRooms(1000),
+                      statsInterval(5), seed(1) {}
+};
+
+// What a worker has done so far, published once a second
+struct WorkerReport {
+    uint32_t rooms;
+    uint32_t playingRooms;
+    uint64_t cpuNs;
+    uint64_t roomBusyNs;
+    uint64_t roomTicks;
+    uint64_t statesSent;
+    uint64_t matchesFinished;
+    uint64_t overruns;              // Ticks dropped because the worker fell behind
+    uint32_t heaviestRoom;          // Most busy time over the last second
+    uint64_t heaviestRoomBusyNs;
+    
+    WorkerReport() : rooms(0), playingRooms(0), cpuNs(0), roomBusyNs(0), roomTicks(0), statesSent(0),
+                     matchesFinished(0), overruns(0), heaviestRoom(0), heaviestRoomBusyNs(0) {}
+};
+
+class RoomWorker {
+public:
+    static const uint64_t SEAT_TIMEOUT_NS = 5000000000ull;
+    static const int MAX_CATCH_UP_TICKS = 4;
+    
+    explicit RoomWorker(const ServerOptions& options);
+    ~RoomWorker();
+    
+    RoomWorker(const RoomWorker&) = delete;
+    RoomWorker& operator=(const RoomWorker&) = delete;
+    
+    bool start();
+    void stop();
+    
+    uint16_t getPort() const {
+        return socket.getLocalPort();
+    }
+    
+    // Called from the lobby thread
+    void addRoom(uint32_t id, uint64_t seed);
+    WorkerReport getReport();
+    std::vector<uint32_t> takeClosedRooms();
+    
+private:
+    struct Seat {
+        NetAddress address;
+        bool joined;
+        PaddleInput input;
+        uint64_t lastHeard;
+        
+        Seat() : joined(false), lastHeard(0) {}
+    };
+    
+    struct Room {
+        uint32_t id;
+        Match match;
+        Seat seats[2];
+        uint32_t tick;
+        uint64_t created;
+        uint64_t busyNs;
+        uint64_t reportedBusyNs;    // busyNs at the last report
+        
+        bool isPlaying() const {
+            return seats[0].joined && seats[1].joined;
+        }
+    };
+    
+    struct NewRoom {
+        uint32_t id;
+        uint64_t seed;
+    };
+    
+    const ServerOptions options;
+    UdpSocket socket;
+    int epollFd;
+    int timerFd;
+    int wakeFd;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::unordered_map<uint32_t, Room> rooms;
+    int sendAccumulator;
+    
+    // Counters, only touched by the worker thread
+    WorkerReport totals;
+    uint64_t lastReport;
+    
+    // Shared with the lobby
+    std::mutex mutex;
+    std::vector<NewRoom> newRooms;
+    std::vector<uint32_t> closedRooms;
+    WorkerReport report;
+    
+    void run();
+    void openRooms();
+    void receive();
+    void tick(int ticks);
+    void sendState(Room& room);
+    void closeRoom(uint32_t id);
+    void publishReport(uint64_t now);
+};
+
+class MatchServer {
+public:
+    explicit MatchServer(const ServerOptions& options);
+    ~MatchServer();
+    
+    bool start();
+    
+    // Serve until stop becomes nonzero, e.g. from a signal handler
+    void run(const volatile std::sig_atomic_t& stop);
+    
+    ServerStats getStats();
+    
+private:
+    // A client that was given a seat, by address
+    struct Seated {
+        uint32_t nonce;
+        SeatAssignment assignment;
+    };
+    
+    const ServerOptions options;
+    UdpSocket socket;
+    int epollFd;
+    std::vector<std::unique_ptr<RoomWorker>> workers;
+    std::unordered_map<uint64_t, Seated> seated;
+    std::unordered_map<uint32_t, std::vector<uint64_t>> roomClients;
+    std::unordered_map<uint32_t, size_t> roomWorkers;
+    std::vector<int> workerRooms;   // Open rooms per worker
+    Random seeds;
+    uint32_t nextRoomId;
+    uint32_t waitingRoom;       // Room with one seat taken; 0 = none
+    uint64_t started;
+    ServerStats lastStats;      // At the last printed report
+    uint64_t lastStatsTime;
+    
+    void receive();
+    void seat(const NetAddress& from, uint32_t nonce);
+    void sendAssignment(const NetAddress& to, const SeatAssignment& assignment);
+    void collectClosedRooms();
+    ServerStats sumReports(const std::vector<WorkerReport>& reports) const;
+    void printStats(uint64_t now);
+};
@@ -0,0 +1,350 @@
+// Space Ping Pong - online play over UDP
+#include "netplay.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint8_t MAGIC[4] = {'S', 'P', 'N', 1};
+
+enum PacketType : uint8_t {
+    HELLO,      // Joiner to host
+    WELCOME,    // Host to joiner: seed
+    INPUTS      // Ack, first tick, inputs, checksum tick and checksum
+};
+
+const size_t HEADER_SIZE = 5;
+const size_t MAX_PACKET = 512;
+
+#ifdef _WIN32
+bool startSockets() {
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }
+    return started;
+}
+#else
+bool startSockets() {
+    return true;
+}
+#endif
+
+void putBytes(std::vector<uint8_t>& out, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        out.push_back((uint8_t)(value >> (i * 8)));
+    }
+}
+
+uint64_t getBytes(const uint8_t* data, int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value |= (uint64_t)data[i] << (i * 8);
+    }
+    return value;
+}
+
+std::vector<uint8_t> packetHeader(PacketType type) {
+    std::vector<uint8_t> packet(MAGIC, MAGIC + 4);
+    packet.push_back(type);
+    return packet;
+}
+
+}
+
+bool NetAddress::parse(const std::string& text, NetAddress& address) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0 || !startSockets()) {
+        return false;
+    }
+    std::string name = text.substr(0, colon);
+    int port = std::atoi(text.c_str() + colon + 1);
+    if (port <= 0 || port > 65535) {
+        return false;
+    }
+    
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(name.c_str(), nullptr, &hints, &result) != 0 || !result) {
+        return false;
+    }
+    address.host = ((sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    address.port = (uint16_t)port;
+    freeaddrinfo(result);
+    return true;
+}
+
+std::string NetAddress::toString() const {
+    const uint8_t* bytes = (const uint8_t*)&host;
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%d.%d.%d.%d:%d", bytes[0], bytes[1], bytes[2], bytes[3], port);
+    return buffer;
+}
+
+UdpSocket::UdpSocket() : handle(INVALID) {}
+
+UdpSocket::~UdpSocket() {
+    close();
+}
+
+bool UdpSocket::open(uint16_t port) {
+    close();
+    if (!startSockets()) {
+        return false;
+    }
+    handle = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == INVALID) {
+        return false;
+    }
+    
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(handle, (sockaddr*)&local, sizeof(local)) != 0) {
+        close();
+        return false;
+    }
+    
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    bool ok = ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+    bool ok = fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
+
+void UdpSocket::close() {
+    if (handle == INVALID) return;
+#ifdef _WIN32
+    closesocket(handle);
+#else
+    ::close(handle);
+#endif
+    handle = INVALID;
+}
+
+uint16_t UdpSocket::getLocalPort() const {
+    sockaddr_in local = {};
+    socklen_t length = sizeof(local);
+    if (handle == INVALID || getsockname(handle, (sockaddr*)&local, &length) != 0) {
+        return 0;
+    }
+    return ntohs(local.sin_port);
+}
+
+bool UdpSocket::sendTo(const NetAddress& to, const uint8_t* data, size_t size) {
+    sockaddr_in remote = {};
+    remote.sin_family = AF_INET;
+    remote.sin_addr.s_addr = to.host;
+    remote.sin_port = htons(to.port);
+    return sendto(handle, (const char*)data, (int)size, 0, (sockaddr*)&remote, sizeof(remote)) == (int)size;
+}
+
+size_t UdpSocket::receiveFrom(NetAddress& from, uint8_t* buffer, size_t capacity) {
+    sockaddr_in remote = {};
+    socklen_t length = sizeof(remote);
+    int received = (int)recvfrom(handle, (char*)buffer, (int)capacity, 0, (sockaddr*)&remote, &length);
+    if (received <= 0) {
+        return 0;
+    }
+    from.host = remote.sin_addr.s_addr;
+    from.port = ntohs(remote.sin_port);
+    return (size_t)received;
+}
+
+void LinkSimulator::send(UdpSocket& socket, const NetAddress& to, const uint8_t* data, size_t size, uint64_t now) {
+    if (conditions.lossPercent > 0 && rng.uniform(0, 100) < conditions.lossPercent) {
+        return;
+    }
+    double delayMs = conditions.latencyMs + conditions.jitterMs * rng.nextFloat();
+    if (delayMs <= 0) {
+        socket.sendTo(to, data, size);
+        return;
+    }
+    Pending packet;
+    packet.to = to;
+    packet.data.assign(data, data + size);
+    pending.emplace(now + (uint64_t)(delayMs * 1e6), packet);
+}
+
+void LinkSimulator::flush(UdpSocket& socket, uint64_t now) {
+    while (!pending.empty() && pending.begin()->first <= now) {
+        const Pending& packet = pending.begin()->second;
+        socket.sendTo(packet.to, packet.data.data(), packet.data.size());
+        pending.erase(pending.begin());
+    }
+}
+
+NetplaySession::NetplaySession(Match& match)
+    : rollback(match), hosting(false), running(false), desynced(false), seed(0),
+      peerAck(0), lastSend(0), lastReceive(0) {}
+
+bool NetplaySession::host(uint16_t port, uint64_t matchSeed) {
+    if (!socket.open(port)) {
+        return false;
+    }
+    hosting = true;
+    seed = matchSeed;
+    link.seed(seed);
+    lastReceive = traceNow();
+    return true;
+}
+
+bool NetplaySession::join(const NetAddress& hostAddress) {
+    if (!socket.open(0)) {
+        return false;
+    }
+    hosting = false;
+    peer = hostAddress;
+    link.seed(socket.getLocalPort());
+    lastReceive = traceNow();
+    return true;
+}
+
+void NetplaySession::poll() {
+    TRACE_SCOPE("netplay.poll");
+    uint64_t now = traceNow();
+    
+    uint8_t buffer[MAX_PACKET];
+    NetAddress from;
+    size_t size;
+    while ((size = socket.receiveFrom(from, buffer, sizeof(buffer))) > 0) {
+        receive(from, buffer, size);
+    }
+    
+    if (!running && !hosting && now - lastSend >= HELLO_INTERVAL_NS) {
+        sendHello();
+    } else if (running && now - lastSend >= KEEPALIVE_NS) {
+        // Keeps unacknowledged inputs and acks flowing while either side
+        // is stalled waiting for the other
+        sendInputs();
+    }
+    link.flush(socket, now);
+}
+
+void NetplaySession::advance(const PaddleInput& localInput) {
+    rollback.advance(localInput);
+    sendInputs();
+}
+
+bool NetplaySession::hasTimedOut() const {
+    return traceNow() - lastReceive > TIMEOUT_NS;
+}
+
+void NetplaySession::sendPacket(const std::vector<uint8_t>& packet) {
+    lastSend = traceNow();
+    link.send(socket, peer, packet.data(), packet.size(), lastSend);
+}
+
+void NetplaySession::sendHello() {
+    sendPacket(packetHeader(HELLO));
+}
+
+void NetplaySession::sendWelcome() {
+    std::vector<uint8_t> packet = packetHeader(WELCOME);
+    putBytes(packet, seed, 8);
+    sendPacket(packet);
+}
+
+void NetplaySession::sendInputs() {
+    uint32_t end = rollback.getTick();
+    uint32_t first = peerAck;
+    
+    // Older inputs have left the history; the peer can no longer be that
+    // far behind without having stalled
+    uint32_t oldest = end > RollbackSession::HISTORY - RollbackSession::MAX_ROLLBACK
+                      ? end - (RollbackSession::HISTORY - RollbackSession::MAX_ROLLBACK) : 0;
+    if (first < oldest) first = oldest;
+    if (first > end) first = end;
+    
+    std::vector<uint8_t> packet = packetHeader(INPUTS);
+    putBytes(packet, rollback.getRemoteConfirmed(), 4);
+    putBytes(packet, first, 4);
+    packet.push_back((uint8_t)(end - first));
+    for (uint32_t tick = first; tick < end; tick++) {
+        packet.push_back(rollback.getLocalInput(tick));
+    }
+    putBytes(packet, rollback.getChecksumTick(), 4);
+    putBytes(packet, rollback.getLastChecksum(), 8);
+    sendPacket(packet);
+}
+
+void NetplaySession::receive(const NetAddress& from, const uint8_t* data, size_t size) {
+    if (size < HEADER_SIZE || data[0] != MAGIC[0] || data[1] != MAGIC[1] ||
+        data[2] != MAGIC[2] || data[3] != MAGIC[3]) {
+        return;
+    }
+    PacketType type = (PacketType)data[4];
+    data += HEADER_SIZE;
+    size -= HEADER_SIZE;
+    
+    if (type == HELLO && hosting) {
+        // Answer every hello in case the welcome got lost
+        if (!running) {
+            peer = from;
+            rollback.start(seed, 1);
+            running = true;
+            std::cout << "Player 2 joined from " << from.toString() << std::endl;
+        }
+        if (from == peer) {
+            lastReceive = traceNow();
+            sendWelcome();
+        }
+        return;
+    }
+    if (!(from == peer)) {
+        return;
+    }
+    lastReceive = traceNow();
+    
+    if (type == WELCOME && !hosting && size >= 8) {
+        if (!running) {
+            seed = getBytes(data, 8);
+            rollback.start(seed, 2);
+            running = true;
+        }
+    } else if (type == INPUTS && running && size >= 9) {
+        uint32_t ack = (uint32_t)getBytes(data, 4);
+        uint32_t first = (uint32_t)getBytes(data + 4, 4);
+        size_t count = data[8];
+        if (size < 9 + count + 12) return;
+        
+        if (ack > peerAck) peerAck = ack;
+        for (size_t i = 0; i < count; i++) {
+            rollback.addRemoteInput(first + (uint32_t)i, data[9 + i]);
+        }
+        
+        uint32_t checksumTick = (uint32_t)getBytes(data + 9 + count, 4);
+        uint64_t checksum = getBytes(data + 13 + count, 8);
+        uint64_t ours;
+        if (!desynced && rollback.getChecksum(checksumTick, ours) && ours != checksum) {
+            desynced = true;
+            std::cerr << "Desync detected at tick " << checksumTick << std::endl;
+        }
+    }
+}
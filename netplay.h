@@ -0,0 +1,181 @@
+// Space Ping Pong - online play over UDP
+//
+// Two peers, one hosting and one joining. The joiner says hello until the
+// host answers with the match seed; from then on every packet carries all
+// of the sender's inputs the other side has not acknowledged yet, so a lost
+// packet is repaired by the next one and nothing is ever resent on a timer
+// of its own. Each packet also carries the sender's newest confirmed state
+// checksum, which exposes a desync as soon as both sides have it.
+//
+// LinkSimulator drops and delays outgoing packets, so two instances on one
+// machine can be run under realistic loss and latency.
+#pragma once
+
+#include "pingpong_sim.h"
+#include "random.h"
+#include "rollback.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// IPv4 address and port
+struct NetAddress {
+    uint32_t host;      // Network byte order
+    uint16_t port;      // Host byte order
+    
+    NetAddress() : host(0), port(0) {}
+    
+    bool operator==(const NetAddress& other) const {
+        return host == other.host && port == other.port;
+    }
+    
+    // "host:port"; the host may be a name
+    static bool parse(const std::string& text, NetAddress& address);
+    std::string toString() const;
+};
+
+// Non-blocking UDP socket
+class UdpSocket {
+public:
+    UdpSocket();
+    ~UdpSocket();
+    
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+    
+    // Bind to a port on every interface; 0 picks a free one
+    bool open(uint16_t port);
+    void close();
+    
+    bool isOpen() const {
+        return handle != INVALID;
+    }
+    
+    // For waiting on the socket with epoll or select
+    intptr_t getHandle() const {
+        return handle;
+    }
+    
+    uint16_t getLocalPort() const;
+    bool sendTo(const NetAddress& to, const uint8_t* data, size_t size);
+    
+    // Bytes received, or 0 when nothing is waiting
+    size_t receiveFrom(NetAddress& from, uint8_t* buffer, size_t capacity);
+    
+private:
+    static const intptr_t INVALID = -1;
+    intptr_t handle;
+};
+
+// What the simulated link does to outgoing packets
+struct LinkConditions {
+    double lossPercent;
+    double latencyMs;   // One way
+    double jitterMs;    // Added uniformly in [0, jitterMs]; reorders packets
+    
+    LinkConditions() : lossPercent(0), latencyMs(0), jitterMs(0) {}
+};
+
+class LinkSimulator {
+public:
+    LinkSimulator() : rng(0, NETWORK_STREAM) {}
+    
+    void seed(uint64_t value) {
+        rng.reseed(value, NETWORK_STREAM);
+    }
+    
+    void setConditions(const LinkConditions& value) {
+        conditions = value;
+    }
+    
+    // Drop the packet, delay it or send it right away
+    void send(UdpSocket& socket, const NetAddress& to, const uint8_t* data, size_t size, uint64_t now);
+    
+    // Send delayed packets that are due
+    void flush(UdpSocket& socket, uint64_t now);
+    
+private:
+    struct Pending {
+        NetAddress to;
+        std::vector<uint8_t> data;
+    };
+    
+    LinkConditions conditions;
+    Random rng;
+    std::multimap<uint64_t, Pending> pending;   // By due time
+};
+
+class NetplaySession {
+public:
+    static const uint64_t HELLO_INTERVAL_NS = 100000000;    // While joining
+    static const uint64_t KEEPALIVE_NS = 16000000;          // Resend when idle
+    static const uint64_t TIMEOUT_NS = 5000000000ull;
+    
+    explicit NetplaySession(Match& match);
+    
+    // The host plays the right paddle (player 1) and picks the seed
+    bool host(uint16_t port, uint64_t seed);
+    bool join(const NetAddress& hostAddress);
+    
+    void setConditions(const LinkConditions& conditions) {
+        link.setConditions(conditions);
+    }
+    
+    // Exchange packets; call every tick, stalled or not
+    void poll();
+    
+    bool isRunning() const {
+        return running;
+    }
+    
+    bool canAdvance() const {
+        return running && rollback.canAdvance();
+    }
+    
+    void advance(const PaddleInput& localInput);
+    
+    // Apply corrections that arrived while not advancing
+    void synchronize() {
+        rollback.synchronize();
+    }
+    
+    bool isDesynced() const {
+        return desynced;
+    }
+    
+    // Nothing heard from the peer for TIMEOUT_NS
+    bool hasTimedOut() const;
+    
+    int getLocalPlayer() const {
+        return hosting ? 1 : 2;
+    }
+    
+    const RollbackSession& getRollback() const {
+        return rollback;
+    }
+    
+    uint16_t getLocalPort() const {
+        return socket.getLocalPort();
+    }
+    
+private:
+    UdpSocket socket;
+    LinkSimulator link;
+    RollbackSession rollback;
+    NetAddress peer;
+    bool hosting;
+    bool running;
+    bool desynced;
+    uint64_t seed;
+    uint32_t peerAck;       // The peer has our inputs for every tick before this
+    uint64_t lastSend;
+    uint64_t lastReceive;
+    
+    void sendPacket(const std::vector<uint8_t>& packet);
+    void sendHello();
+    void sendWelcome();
+    void sendInputs();
+    void receive(const NetAddress& from, const uint8_t* data, size_t size);
+};
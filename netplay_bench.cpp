@@ -0,0 +1,196 @@
+// Space Ping Pong - rollback and netplay benchmark
+//
+// First times the worst rollback the session allows: restore the snapshot
+// from MAX_ROLLBACK ticks ago and simulate them all again, over and over in
+// a running match. Then plays a whole networked match between two sessions
+// in this process, over real UDP on 127.0.0.1 with simulated loss, latency
+// and jitter, both driven by scripted inputs, and checks that both ends
+// finish with the same match state.
+#include "netplay.h"
+#include "rollback.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Scripted player: holds a random direction for 10 to 40 ticks at a time
+PaddleInput scriptedInput(uint64_t player, uint32_t tick) {
+    Random rng(player * 1000003 + tick / 25, COSMETIC_STREAM);
+    int choice = rng.range(0, 2);
+    return PaddleInput(choice == 1, choice == 2);
+}
+
+// Each rollback restores MAX_ROLLBACK ticks and simulates them again
+int benchRollback(int rollbacks) {
+    Match match;
+    RollbackSession session(match);
+    session.start(7, 1);
+    uint32_t depth = RollbackSession::MAX_ROLLBACK;
+    
+    std::vector<double> times;
+    times.reserve(rollbacks);
+    uint8_t remote = 0;
+    while ((int)times.size() < rollbacks) {
+        if (match.over) {
+            session.start(times.size(), 1);
+            remote = 0;
+        }
+        
+        // Run ahead on predictions as far as allowed
+        while (session.canAdvance()) {
+            session.advance(scriptedInput(1, session.getTick()));
+        }
+        
+        // The remote player changed direction at the oldest predicted tick
+        remote = remote == 1 ? 2 : 1;
+        for (uint32_t tick = session.getRemoteConfirmed(); tick < session.getTick(); tick++) {
+            session.addRemoteInput(tick, remote);
+        }
+        auto start = std::chrono::steady_clock::now();
+        session.synchronize();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (double t : times) total += t;
+    double mean = total / times.size();
+    double p99 = times[times.size() * 99 / 100];
+    double worst = times.back();
+    std::cout << "rollback of " << depth << " ticks: mean " << mean << " us, p99 " << p99
+              << " us, max " << worst << " us over " << times.size() << " rollbacks ("
+              << mean / depth << " us per resimulated tick)" << std::endl;
+    
+    // The max includes the odd preemption by the OS, so the budget is held to p99
+    return p99 < 1000 ? 0 : 1;
+}
+
+struct Peer {
+    Match match;
+    NetplaySession session;
+    uint64_t player;
+    uint64_t nextTick;
+    uint64_t stalledNs;
+    
+    Peer(uint64_t player) : session(match), player(player), nextTick(0), stalledNs(0) {}
+};
+
+int benchLoopback(uint32_t ticks, double tickMs, const LinkConditions& conditions) {
+    Peer host(1), guest(2);
+    if (!host.session.host(0, 12345)) {
+        std::cerr << "Could not open host socket" << std::endl;
+        return -1;
+    }
+    NetAddress address;
+    NetAddress::parse("127.0.0.1:" + std::to_string(host.session.getLocalPort()), address);
+    if (!guest.session.join(address)) {
+        std::cerr << "Could not open guest socket" << std::endl;
+        return -1;
+    }
+    host.session.setConditions(conditions);
+    guest.session.setConditions(conditions);
+    
+    uint64_t tickNs = (uint64_t)(tickMs * 1e6);
+    uint64_t start = nowNs();
+    uint64_t deadline = start + 60ull * 1000000000ull;
+    Peer* peers[2] = {&host, &guest};
+    for (Peer* peer : peers) peer->nextTick = start;
+    
+    while (true) {
+        uint64_t now = nowNs();
+        bool finished = true;
+        for (Peer* peer : peers) {
+            NetplaySession& session = peer->session;
+            session.poll();
+            if (session.getRollback().getTick() < ticks) {
+                finished = false;
+                if (now >= peer->nextTick) {
+                    if (session.canAdvance()) {
+                        session.advance(scriptedInput(peer->player, session.getRollback().getTick()));
+                        peer->nextTick += tickNs;
+                    } else {
+                        peer->stalledNs += now - std::max(peer->nextTick, now - 100000);
+                    }
+                }
+            } else {
+                session.synchronize();
+                if (!session.getRollback().isConfirmed()) finished = false;
+            }
+        }
+        if (finished) break;
+        if (now > deadline) {
+            std::cerr << "Loopback match did not finish in 60 s" << std::endl;
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double seconds = (nowNs() - start) / 1e9;
+    
+    bool same = host.match.checksum() == guest.match.checksum();
+    std::cout << "loopback: " << ticks << " ticks at " << tickMs << " ms, " << conditions.lossPercent
+              << "% loss, " << conditions.latencyMs << "+" << conditions.jitterMs << " ms latency, "
+              << seconds << " s (ideal " << ticks * tickMs / 1000 << " s), score "
+              << host.match.player1Score << "-" << host.match.player2Score << std::endl;
+    for (Peer* peer : peers) {
+        const RollbackSession& rollback = peer->session.getRollback();
+        std::cout << "  player " << peer->player << ": " << rollback.getRollbacks() << " rollbacks, "
+                  << rollback.getResimulatedTicks() << " ticks resimulated, longest "
+                  << rollback.getLongestRollback() << " ticks, slowest "
+                  << rollback.getSlowestRollbackNs() / 1000.0 << " us, stalled "
+                  << peer->stalledNs / 1e6 << " ms" << (peer->session.isDesynced() ? ", DESYNC" : "") << std::endl;
+    }
+    std::cout << "  final state " << (same ? "matches" : "DIFFERS") << " on both ends" << std::endl;
+    return same ? 0 : 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    int rollbacks = 20000;
+    uint32_t ticks = 600;
+    double tickMs = 1000.0 / FPS;
+    LinkConditions conditions;
+    conditions.lossPercent = 5;
+    conditions.latencyMs = 30;
+    conditions.jitterMs = 10;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--rollbacks" && i + 1 < argc) {
+            rollbacks = std::atoi(argv[++i]);
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            ticks = (uint32_t)std::atoi(argv[++i]);
+        } else if (arg == "--tick-ms" && i + 1 < argc) {
+            tickMs = std::atof(argv[++i]);
+        } else if (arg == "--loss" && i + 1 < argc) {
+            conditions.lossPercent = std::atof(argv[++i]);
+        } else if (arg == "--latency" && i + 1 < argc) {
+            conditions.latencyMs = std::atof(argv[++i]);
+        } else if (arg == "--jitter" && i + 1 < argc) {
+            conditions.jitterMs = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Usage: netplay_bench [--rollbacks N] [--ticks N] [--tick-ms MS] "
+                      << "[--loss PERCENT] [--latency MS] [--jitter MS]" << std::endl;
+            return -1;
+        }
+    }
+    if (rollbacks <= 0 || ticks == 0 || tickMs <= 0) {
+        std::cerr << "Counts and tick length must be positive" << std::endl;
+        return -1;
+    }
+    
+    int result = benchRollback(rollbacks);
+    int loopback = benchLoopback(ticks, tickMs, conditions);
+    return result != 0 ? result : loopback;
+}
@@ -0,0 +1,135 @@
+// Space Ping Pong - particle engine microbenchmark
+//
+// Keeps the pool at a steady population (200k by default) with particles of
+// mixed lifetimes, so every tick integrates, fades, compacts and re-emits,
+// and reports the cost per tick for each kernel the CPU supports. All
+// kernels start from the same seed; matching checksums show they agree.
+// The best kernel is then run on 1, 2, 4 and 8 job system workers, which
+// must all produce the same checksum too.
+#include "particle_system.h"
+#include "job_system.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+struct BenchResult {
+    double msPerTick;
+    double nsPerParticle;
+    uint64_t checksum;      // FNV-1a over the final positions and fades
+};
+
+uint64_t hashFloats(uint64_t hash, const float* values, size_t count) {
+    const unsigned char* bytes = (const unsigned char*)values;
+    for (size_t i = 0; i < count * sizeof(float); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Refill to the target population with bursts of 20 particles
+void refill(ParticleSystem& particles, size_t population, int tick) {
+    int burst = 0;
+    while (particles.size() < population) {
+        float x = (float)((tick * 37 + burst * 101) % 1200);
+        float y = (float)((tick * 53 + burst * 67) % 800);
+        float life = 30.0f + (burst % 8) * 15.0f;
+        particles.emit(ParticleBurst(x, y, 20, 8.0f, (uint8_t)(burst % 4), life));
+        burst++;
+    }
+}
+
+void step(ParticleSystem& particles, JobSystem* jobs) {
+    if (jobs) {
+        particles.update(1.0f, *jobs);
+    } else {
+        particles.update(1.0f);
+    }
+}
+
+BenchResult run(ParticleKernel kernel, size_t population, int ticks, JobSystem* jobs) {
+    ParticleSystem particles(population);
+    particles.setKernel(kernel);
+    refill(particles, population, 0);
+    
+    // Warm up caches and let lifetimes spread out
+    for (int tick = 0; tick < 120; tick++) {
+        step(particles, jobs);
+        refill(particles, population, tick);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        step(particles, jobs);
+        refill(particles, population, tick);
+    }
+    auto end = std::chrono::steady_clock::now();
+    
+    uint64_t checksum = 14695981039346656037ull;
+    checksum = hashFloats(checksum, particles.getX(), particles.size());
+    checksum = hashFloats(checksum, particles.getY(), particles.size());
+    checksum = hashFloats(checksum, particles.getFade(), particles.size());
+    
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    BenchResult result;
+    result.msPerTick = ns / ticks / 1e6;
+    result.nsPerParticle = ns / ticks / population;
+    result.checksum = checksum;
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t population = 200000;
+    int ticks = 600;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--particles" && i + 1 < argc) {
+            population = (size_t)std::atol(argv[++i]);
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            ticks = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: particle_bench [--particles N] [--ticks N]" << std::endl;
+            return -1;
+        }
+    }
+    if (population == 0 || ticks <= 0) {
+        std::cerr << "Particle and tick counts must be positive" << std::endl;
+        return -1;
+    }
+    
+    std::cout << population << " particles, " << ticks << " ticks" << std::endl;
+    const double frameBudgetMs = 1000.0 / 60;
+    ParticleKernel best = ParticleKernel::SCALAR;
+    for (ParticleKernel kernel : {ParticleKernel::SCALAR, ParticleKernel::SSE2, ParticleKernel::AVX2}) {
+        if (!ParticleSystem::supports(kernel)) {
+            std::cout << particleKernelName(kernel) << ": not supported" << std::endl;
+            continue;
+        }
+        best = kernel;
+        BenchResult result = run(kernel, population, ticks, nullptr);
+        std::cout << particleKernelName(kernel) << ": "
+                  << result.msPerTick << " ms/tick, "
+                  << result.nsPerParticle << " ns/particle, "
+                  << 100.0 * result.msPerTick / frameBudgetMs << "% of a 60 FPS frame, "
+                  << "checksum " << std::hex << result.checksum << std::dec << std::endl;
+    }
+    
+    std::cout << std::endl << "Scaling, " << particleKernelName(best) << " kernel" << std::endl;
+    double serialMs = 0;
+    for (int workers : {1, 2, 4, 8}) {
+        JobSystem jobs(workers);
+        BenchResult result = run(best, population, ticks, &jobs);
+        if (workers == 1) {
+            serialMs = result.msPerTick;
+        }
+        std::cout << workers << " workers: " << result.msPerTick << " ms/tick, "
+                  << serialMs / result.msPerTick << "x, checksum " << std::hex << result.checksum << std::dec << std::endl;
+    }
+    return 0;
+}
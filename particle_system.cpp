@@ -0,0 +1,236 @@
+// Space Ping Pong - particle engine
+#include "particle_system.h"
+#include "job_system.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PARTICLES_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled per function and picked at runtime, so the binary still
+// runs on CPUs without it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARTICLES_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const size_t VECTOR_WIDTH = 8;
+
+// Arrays one kernel pass reads and writes
+struct ParticleArrays {
+    float* x;
+    float* y;
+    float* prevX;
+    float* prevY;
+    const float* vx;
+    const float* vy;
+    float* life;
+    const float* invMaxLife;
+    float* fade;
+};
+
+void integrateScalar(const ParticleArrays& p, size_t n, float step) {
+    for (size_t i = 0; i < n; i++) {
+        p.prevX[i] = p.x[i];
+        p.prevY[i] = p.y[i];
+        p.x[i] += p.vx[i] * step;
+        p.y[i] += p.vy[i] * step;
+        p.life[i] -= step;
+        p.fade[i] = std::max(0.0f, p.life[i] * p.invMaxLife[i]);
+    }
+}
+
+#ifdef PARTICLES_SSE2
+void integrateSse2(const ParticleArrays& p, size_t n, float step) {
+    const __m128 steps = _mm_set1_ps(step);
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < n; i += 4) {
+        __m128 x = _mm_loadu_ps(p.x + i);
+        __m128 y = _mm_loadu_ps(p.y + i);
+        _mm_storeu_ps(p.prevX + i, x);
+        _mm_storeu_ps(p.prevY + i, y);
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(p.vx + i), steps));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_loadu_ps(p.vy + i), steps));
+        _mm_storeu_ps(p.x + i, x);
+        _mm_storeu_ps(p.y + i, y);
+        
+        __m128 life = _mm_sub_ps(_mm_loadu_ps(p.life + i), steps);
+        _mm_storeu_ps(p.life + i, life);
+        __m128 fade = _mm_max_ps(zero, _mm_mul_ps(life, _mm_loadu_ps(p.invMaxLife + i)));
+        _mm_storeu_ps(p.fade + i, fade);
+    }
+}
+#endif
+
+#ifdef PARTICLES_AVX2
+__attribute__((target("avx2")))
+void integrateAvx2(const ParticleArrays& p, size_t n, float step) {
+    const __m256 steps = _mm256_set1_ps(step);
+    const __m256 zero = _mm256_setzero_ps();
+    for (size_t i = 0; i < n; i += 8) {
+        __m256 x = _mm256_loadu_ps(p.x + i);
+        __m256 y = _mm256_loadu_ps(p.y + i);
+        _mm256_storeu_ps(p.prevX + i, x);
+        _mm256_storeu_ps(p.prevY + i, y);
+        x = _mm256_add_ps(x, _mm256_mul_ps(_mm256_loadu_ps(p.vx + i), steps));
+        y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_loadu_ps(p.vy + i), steps));
+        _mm256_storeu_ps(p.x + i, x);
+        _mm256_storeu_ps(p.y + i, y);
+        
+        __m256 life = _mm256_sub_ps(_mm256_loadu_ps(p.life + i), steps);
+        _mm256_storeu_ps(p.life + i, life);
+        __m256 fade = _mm256_max_ps(zero, _mm256_mul_ps(life, _mm256_loadu_ps(p.invMaxLife + i)));
+        _mm256_storeu_ps(p.fade + i, fade);
+    }
+}
+#endif
+
+}
+
+const char* particleKernelName(ParticleKernel kernel) {
+    switch (kernel) {
+        case ParticleKernel::SCALAR: return "scalar";
+        case ParticleKernel::SSE2: return "sse2";
+        case ParticleKernel::AVX2: return "avx2";
+    }
+    return "";
+}
+
+ParticleSystem::ParticleSystem(size_t capacity)
+    : count(0), limit(capacity), rng(0, PARTICLE_STREAM), kernel(ParticleKernel::SCALAR) {
+    size_t padded = (capacity + VECTOR_WIDTH - 1) / VECTOR_WIDTH * VECTOR_WIDTH;
+    for (std::vector<float>* array : {&x, &y, &prevX, &prevY, &vx, &vy, &life, &invMaxLife, &fade}) {
+        array->assign(padded, 0.0f);
+    }
+    colorIndex.assign(padded, 0);
+    sizes.assign(padded, 0);
+    
+    if (supports(ParticleKernel::AVX2)) {
+        kernel = ParticleKernel::AVX2;
+    } else if (supports(ParticleKernel::SSE2)) {
+        kernel = ParticleKernel::SSE2;
+    }
+}
+
+bool ParticleSystem::supports(ParticleKernel kernel) {
+    switch (kernel) {
+        case ParticleKernel::SCALAR:
+            return true;
+        case ParticleKernel::SSE2:
+#ifdef PARTICLES_SSE2
+            return true;
+#else
+            return false;
+#endif
+        case ParticleKernel::AVX2:
+#ifdef PARTICLES_AVX2
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+void ParticleSystem::setKernel(ParticleKernel value) {
+    if (supports(value)) {
+        kernel = value;
+    }
+}
+
+void ParticleSystem::seed(uint64_t value) {
+    rng.reseed(value, PARTICLE_STREAM);
+}
+
+void ParticleSystem::emit(float px, float py, float pvx, float pvy, float plife, uint8_t color) {
+    if (count >= limit) return;
+    size_t i = count++;
+    x[i] = prevX[i] = px;
+    y[i] = prevY[i] = py;
+    vx[i] = pvx;
+    vy[i] = pvy;
+    life[i] = plife;
+    invMaxLife[i] = 1.0f / plife;
+    fade[i] = 1.0f;
+    colorIndex[i] = color;
+    sizes[i] = (uint8_t)(MIN_SIZE + (int)(rng.nextFloat() * (MAX_SIZE - MIN_SIZE + 1)));
+}
+
+void ParticleSystem::emit(const ParticleBurst& burst) {
+    int spawned = std::min(burst.count, (int)(limit - count));
+    for (int i = 0; i < spawned; i++) {
+        float pvx = (rng.nextFloat() * 2 - 1) * burst.speed;
+        float pvy = (rng.nextFloat() * 2 - 1) * burst.speed;
+        emit(burst.x, burst.y, pvx, pvy, burst.life, burst.colorIndex);
+    }
+}
+
+void ParticleSystem::update(float step) {
+    integrate(0, paddedCount(), step);
+    compact();
+}
+
+void ParticleSystem::update(float step, JobSystem& jobs) {
+    // Chunks are whole vectors, so every kernel sees the same ranges it
+    // would single-threaded; compaction stays serial to keep the order
+    jobs.parallelFor(paddedCount(), PARALLEL_GRAIN, [this, step](size_t begin, size_t end) {
+        integrate(begin, end, step);
+    });
+    compact();
+}
+
+size_t ParticleSystem::paddedCount() const {
+    return (count + VECTOR_WIDTH - 1) / VECTOR_WIDTH * VECTOR_WIDTH;
+}
+
+void ParticleSystem::integrate(size_t begin, size_t end, float step) {
+    ParticleArrays arrays = {x.data() + begin, y.data() + begin, prevX.data() + begin, prevY.data() + begin,
+                             vx.data() + begin, vy.data() + begin, life.data() + begin,
+                             invMaxLife.data() + begin, fade.data() + begin};
+    size_t n = end - begin;
+    switch (kernel) {
+#ifdef PARTICLES_AVX2
+        case ParticleKernel::AVX2:
+            integrateAvx2(arrays, n, step);
+            break;
+#endif
+#ifdef PARTICLES_SSE2
+        case ParticleKernel::SSE2:
+            integrateSse2(arrays, n, step);
+            break;
+#endif
+        default:
+            integrateScalar(arrays, n, step);
+            break;
+    }
+}
+
+void ParticleSystem::compact() {
+    size_t i = 0;
+    while (i < count) {
+        if (life[i] > 0) {
+            i++;
+            continue;
+        }
+        size_t last = --count;
+        x[i] = x[last];
+        y[i] = y[last];
+        prevX[i] = prevX[last];
+        prevY[i] = prevY[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        life[i] = life[last];
+        invMaxLife[i] = invMaxLife[last];
+        fade[i] = fade[last];
+        colorIndex[i] = colorIndex[last];
+        sizes[i] = sizes[last];
+    }
+}
+
+void ParticleSystem::clear() {
+    count = 0;
+}
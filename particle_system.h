@@ -0,0 +1,90 @@
+// Space Ping Pong - particle engine
+//
+// Particles are stored as structure-of-arrays in a pool whose capacity is
+// fixed at construction, so the update loop streams through plain float
+// arrays and vectorizes. Dead particles are removed by moving the last live
+// one into their slot; order is not preserved. Nothing here depends on SDL,
+// so the benchmark can build it on its own.
+#pragma once
+
+#include "random.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// A burst of particles from one point with velocities uniform in
+// [-speed, speed] on each axis
+struct ParticleBurst {
+    float x, y;
+    int count;
+    float speed;
+    float life;             // In frames at FPS
+    uint8_t colorIndex;
+    
+    ParticleBurst(float x, float y, int count, float speed, uint8_t colorIndex, float life = 60)
+        : x(x), y(y), count(count), speed(speed), life(life), colorIndex(colorIndex) {}
+};
+
+enum class ParticleKernel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+const char* particleKernelName(ParticleKernel kernel);
+
+class ParticleSystem {
+public:
+    static const uint8_t MIN_SIZE = 2;
+    static const uint8_t MAX_SIZE = 5;
+    static const size_t PARALLEL_GRAIN = 8192;
+    
+    explicit ParticleSystem(size_t capacity);
+    
+    // Spawns are dropped once the pool is full
+    void emit(float x, float y, float vx, float vy, float life, uint8_t colorIndex);
+    void emit(const ParticleBurst& burst);
+    
+    // Integrate, fade and drop particles whose life ran out
+    void update(float step);
+    // Same, with integration spread over the job system's workers
+    void update(float step, JobSystem& jobs);
+    void clear();
+    
+    // Restart the sizes and burst directions from a seed
+    void seed(uint64_t value);
+    
+    size_t size() const { return count; }
+    size_t capacity() const { return limit; }
+    
+    // Best kernel the CPU supports is chosen at construction
+    static bool supports(ParticleKernel kernel);
+    void setKernel(ParticleKernel value);
+    ParticleKernel getKernel() const { return kernel; }
+    
+    // Live particles are [0, size())
+    const float* getX() const { return x.data(); }
+    const float* getY() const { return y.data(); }
+    const float* getPrevX() const { return prevX.data(); }
+    const float* getPrevY() const { return prevY.data(); }
+    const float* getFade() const { return fade.data(); }     // 1 at spawn, 0 at death
+    const uint8_t* getColorIndex() const { return colorIndex.data(); }
+    const uint8_t* getSize() const { return sizes.data(); }
+    
+private:
+    // Arrays are padded to a multiple of the widest vector, so kernels run
+    // whole vectors past the last live particle without a scalar tail
+    std::vector<float> x, y, prevX, prevY, vx, vy, life, invMaxLife, fade;
+    std::vector<uint8_t> colorIndex, sizes;
+    size_t count;
+    size_t limit;           // Usable capacity, before padding
+    Random rng;             // Particle stream
+    ParticleKernel kernel;
+    
+    size_t paddedCount() const;
+    void integrate(size_t begin, size_t end, float step);
+    void compact();
+};
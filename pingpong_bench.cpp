@@ -0,0 +1,384 @@
+// Space Ping Pong - simulation benchmark
+//
+// Runs scripted scenarios on the headless simulation core as fast as
+// possible and reports ticks per second and nanoseconds per tick. Both
+// paddles are AI-controlled; a finished match is restarted in place with the
+// next seed, so every run of a scenario plays exactly the same matches.
+// --replay plays a recording made with the game's --record instead.
+//
+// The stress scenario runs stress matches of growing size and reports the
+// time per ball, which stays about flat while the grid finds the balls in
+// contact; the same contacts are then counted with the grid and by testing
+// every pair, which must agree.
+//
+// The tunnel scenario fires single balls at a paddle at speeds far past any
+// a match reaches, one tick per frame, and checks that every one bounces.
+//
+// The ai scenario times an AI paddle's tick with a cached prediction and
+// with one redone every tick, with more and more balls in play: the first
+// stays flat, the second grows with the balls. Then it plays stress
+// matches, where balls knock into each other every tick, once with AI
+// paddles and once with paddles that stand still: the AI's share of the
+// tick, predicting only the balls that changed course, stays small.
+#include "collision_grid.h"
+#include "input_recording.h"
+#include "pingpong_sim.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Scenario {
+    std::string name;
+    Difficulty difficulty;
+    size_t stormBalls;          // Keep at least this many balls in play; 0 = normal play
+    int powerUpSpawnInterval;   // In frames at FPS
+};
+
+struct ScenarioResult {
+    double ticksPerSecond;
+    double nsPerTick;
+    long long points;
+    long long matches;
+    double averageBalls;
+    double averagePowerUps;
+};
+
+ScenarioResult run(const Scenario& scenario, long long ticks, uint64_t seed) {
+    Random seeds(seed, MATCH_SEED_STREAM);
+    Match match;
+    match.difficulty = scenario.difficulty;
+    match.reset(false, false, seeds.next64());
+    match.powerUpSpawnInterval = scenario.powerUpSpawnInterval;
+    
+    PaddleInput idle;
+    long long points = 0;
+    long long matches = 0;
+    double ballTicks = 0;
+    double powerUpTicks = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    for (long long tick = 0; tick < ticks; tick++) {
+        while (match.balls.size() < scenario.stormBalls) {
+            match.balls.push_back(Ball(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, match.rng));
+        }
+        
+        match.tick(1.0f, idle, idle);
+        
+        for (const MatchEvent& event : match.events) {
+            if (event.type == MatchEvent::SCORE) {
+                points++;
+            }
+        }
+        ballTicks += match.balls.size();
+        powerUpTicks += match.powerUps.size();
+        
+        if (match.over) {
+            matches++;
+            match.reset(false, false, seeds.next64());
+            match.powerUpSpawnInterval = scenario.powerUpSpawnInterval;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    
+    double seconds = std::chrono::duration<double>(end - start).count();
+    ScenarioResult result;
+    result.ticksPerSecond = ticks / seconds;
+    result.nsPerTick = seconds * 1e9 / ticks;
+    result.points = points;
+    result.matches = matches;
+    result.averageBalls = ballTicks / ticks;
+    result.averagePowerUps = powerUpTicks / ticks;
+    return result;
+}
+
+// Pairs of balls in contact, found through a grid or by testing all pairs
+long long countContacts(const std::vector<Ball>& balls, bool useGrid) {
+    auto touching = [&](size_t i, size_t j) {
+        float dx = balls[j].x - balls[i].x;
+        float dy = balls[j].y - balls[i].y;
+        float contact = (float)(balls[i].size + balls[j].size);
+        return dx * dx + dy * dy < contact * contact;
+    };
+    long long contacts = 0;
+    if (!useGrid) {
+        for (size_t i = 0; i < balls.size(); i++) {
+            for (size_t j = i + 1; j < balls.size(); j++) {
+                contacts += touching(i, j);
+            }
+        }
+        return contacts;
+    }
+    
+    CollisionGrid grid(SCREEN_WIDTH, SCREEN_HEIGHT, 32);
+    grid.build(balls.size(), (float)STRESS_BALL_SIZE, [&](size_t i) { return Vector2D(balls[i].x, balls[i].y); });
+    for (size_t i = 0; i < balls.size(); i++) {
+        const Ball& ball = balls[i];
+        grid.query(ball.x - ball.size, ball.y - ball.size, ball.x + ball.size, ball.y + ball.size, [&](size_t j) {
+            contacts += j > i && touching(i, j);
+        });
+    }
+    return contacts;
+}
+
+// Stress matches of each size, ticks long; false if the grid missed a contact
+bool runStress(long long ticks, uint64_t seed) {
+    bool exact = true;
+    for (size_t count : {625, 1250, 2500, 5000, 10000}) {
+        Match match;
+        match.reset(false, false, seed);
+        match.startStress(count);
+        match.maxBalls = count;
+        PaddleInput idle;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (long long tick = 0; tick < ticks; tick++) {
+            match.tick(1.0f, idle, idle);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        start = std::chrono::steady_clock::now();
+        long long gridContacts = countContacts(match.balls, true);
+        double gridUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        long long allContacts = countContacts(match.balls, false);
+        double allUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        exact = exact && gridContacts == allContacts;
+        
+        std::cout << "stress " << count << " balls: " << seconds * 1e9 / ticks << " ns/tick, "
+                  << seconds * 1e9 / ticks / count << " ns/ball; " << allContacts << " contacts, grid "
+                  << gridUs << " us, all pairs " << allUs << " us"
+                  << (gridContacts == allContacts ? "" : " - GRID MISSED SOME") << std::endl;
+    }
+    return exact;
+}
+
+// Balls aimed at the right paddle from random points, ticks of the given
+// speed each; false if any got through
+bool runTunnel(uint64_t seed) {
+    const int SHOTS = 2000;
+    Random rng(seed);
+    bool exact = true;
+    for (float speed : {10.0f, 50.0f, 200.0f, 800.0f, 2000.0f}) {
+        int through = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int shot = 0; shot < SHOTS; shot++) {
+            // Humans that never move, so the paddles stay put
+            Match match;
+            match.reset(true, true, seed + shot);
+            Ball& ball = match.balls[0];
+            ball.x = rng.uniform(SCREEN_WIDTH / 4, SCREEN_WIDTH * 3 / 4);
+            ball.y = rng.uniform(SCREEN_HEIGHT / 4, SCREEN_HEIGHT * 3 / 4);
+            Rect paddle = match.paddle1.getRect();
+            Vector2D target(paddle.x, rng.uniform(paddle.y, paddle.y + paddle.h));
+            ball.velocity = (target - Vector2D(ball.x, ball.y)).normalize() * speed;
+            
+            // Whichever comes first, the hit or the point
+            PaddleInput idle;
+            bool hit = false;
+            bool scored = false;
+            while (!hit && !scored) {
+                match.tick(1.0f, idle, idle);
+                for (const MatchEvent& event : match.events) {
+                    if (event.type == MatchEvent::PADDLE_HIT && !scored) {
+                        hit = true;
+                    } else if (event.type == MatchEvent::SCORE && !hit) {
+                        scored = true;
+                    }
+                }
+            }
+            through += scored;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        exact = exact && through == 0;
+        
+        std::cout << "tunnel " << speed << " px/tick: " << SHOTS << " shots, " << through << " through the paddle, "
+                  << seconds * 1e6 / SHOTS << " us/shot" << std::endl;
+    }
+    return exact;
+}
+
+// AI ticks, each ticks long, with balls at random places and headings; then
+// stress matches of each size, stressTicks long
+void runAi(long long ticks, long long stressTicks, uint64_t seed) {
+    for (size_t count : {1, 3, 64, 1024}) {
+        Match match;
+        match.reset(false, false, seed);
+        match.balls.clear();
+        for (size_t i = 0; i < count; i++) {
+            match.balls.push_back(Ball(match.rng.uniform(100, SCREEN_WIDTH - 100),
+                                       match.rng.uniform(100, SCREEN_HEIGHT - 100), match.rng));
+        }
+        const AiSkill& skill = aiSkill(Difficulty::HARD);
+        
+        // The balls never change course, so only the first tick predicts
+        Paddle paddle = match.paddle1;
+        auto start = std::chrono::steady_clock::now();
+        for (long long tick = 0; tick < ticks; tick++) {
+            paddle.aiMove(match.balls, match.ballsVersion, skill, 1.0f, match.rng);
+        }
+        double cachedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        
+        // A course change every tick
+        paddle = match.paddle1;
+        long long predictions = std::max(1LL, ticks / (long long)count);
+        start = std::chrono::steady_clock::now();
+        for (long long tick = 0; tick < predictions; tick++) {
+            paddle.aiMove(match.balls, ++match.ballsVersion, skill, 1.0f, match.rng);
+        }
+        double predictNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        
+        std::cout << "ai " << count << " balls: " << cachedNs / ticks << " ns/tick cached, "
+                  << predictNs / predictions << " ns/tick predicting" << std::endl;
+    }
+    
+    for (size_t count : {625, 2500, 10000}) {
+        // Stage by stage: the paddles predict, the balls tell them of course changes
+        double paddlesNs[2] = {0, 0};
+        double ballsNs[2] = {0, 0};
+        for (bool human : {false, true}) {
+            Match match;
+            match.reset(human, human, seed);
+            match.startStress(count);
+            match.maxBalls = count;
+            PaddleInput idle;
+            
+            for (long long tick = 0; tick < stressTicks; tick++) {
+                match.beginTick();
+                if (match.updateFreeze(1.0f)) {
+                    continue;
+                }
+                auto start = std::chrono::steady_clock::now();
+                match.updatePaddles(1.0f, idle, idle);
+                auto paddlesDone = std::chrono::steady_clock::now();
+                match.updateBalls(1.0f);
+                auto ballsDone = std::chrono::steady_clock::now();
+                paddlesNs[human] += std::chrono::duration<double, std::nano>(paddlesDone - start).count();
+                ballsNs[human] += std::chrono::duration<double, std::nano>(ballsDone - paddlesDone).count();
+                match.updatePowerUps(1.0f);
+                match.checkGameOver();
+            }
+        }
+        
+        std::cout << "ai stress " << count << " balls: paddles " << paddlesNs[0] / stressTicks << " ns/tick, balls "
+                  << ballsNs[0] / stressTicks << " ns/tick; without AI " << paddlesNs[1] / stressTicks << " and "
+                  << ballsNs[1] / stressTicks << std::endl;
+    }
+}
+
+// Replays a recording until at least the given number of ticks have run
+int runReplay(const std::string& path, long long ticks) {
+    InputRecording recording;
+    if (!recording.load(path)) {
+        std::cerr << "Could not read recording " << path << std::endl;
+        return -1;
+    }
+    if (recording.inputs.empty()) {
+        std::cerr << "Recording " << path << " has no ticks" << std::endl;
+        return -1;
+    }
+    
+    Match match;
+    long long played = 0;
+    int runs = 0;
+    bool exact = true;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        exact = replayMatch(recording, match) && exact;
+        played += (long long)recording.inputs.size();
+        runs++;
+    } while (played < ticks);
+    auto end = std::chrono::steady_clock::now();
+    
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << path << ": " << runs << " runs of " << recording.inputs.size() << " ticks, "
+              << (long long)(played / seconds) << " ticks/s, "
+              << seconds * 1e9 / played << " ns/tick, "
+              << match.player1Score << "-" << match.player2Score << ", "
+              << (exact ? "final state matches" : "final state DIFFERS") << std::endl;
+    return exact ? 0 : 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    long long ticks = 1000000;
+    uint64_t seed = 1;
+    std::string only;
+    std::string replayPath;
+    long long stressTicks = 600;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--ticks" && i + 1 < argc) {
+            ticks = std::atoll(argv[++i]);
+        } else if (arg == "--scenario" && i + 1 < argc) {
+            only = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--stress-ticks" && i + 1 < argc) {
+            stressTicks = std::atoll(argv[++i]);
+        } else {
+            std::cerr << "Usage: pingpong_bench [--ticks N] [--scenario NAME] [--seed N] [--replay FILE] "
+                      << "[--stress-ticks N]" << std::endl;
+            return -1;
+        }
+    }
+    if (ticks <= 0 || stressTicks <= 0) {
+        std::cerr << "Tick count must be positive" << std::endl;
+        return -1;
+    }
+    if (!replayPath.empty()) {
+        return runReplay(replayPath, ticks);
+    }
+    
+    const std::vector<Scenario> scenarios = {
+        {"ai-easy", Difficulty::EASY, 0, 600},
+        {"ai-medium", Difficulty::MEDIUM, 0, 600},
+        {"ai-hard", Difficulty::HARD, 0, 600},
+        {"multi-ball-storm", Difficulty::MEDIUM, 64, 600},
+        {"power-up-saturation", Difficulty::MEDIUM, 0, 1},
+    };
+    
+    bool found = false;
+    for (const Scenario& scenario : scenarios) {
+        if (!only.empty() && scenario.name != only) {
+            continue;
+        }
+        found = true;
+        ScenarioResult result = run(scenario, ticks, seed);
+        std::cout << scenario.name << ": "
+                  << (long long)result.ticksPerSecond << " ticks/s, "
+                  << result.nsPerTick << " ns/tick, "
+                  << result.points << " points, "
+                  << result.matches << " matches, "
+                  << result.averageBalls << " balls, "
+                  << result.averagePowerUps << " power-ups on average" << std::endl;
+    }
+    if (only.empty() || only == "stress") {
+        found = true;
+        if (!runStress(stressTicks, seed)) {
+            return 1;
+        }
+    }
+    if (only.empty() || only == "ai") {
+        found = true;
+        runAi(ticks, stressTicks, seed);
+    }
+    if (only.empty() || only == "tunnel") {
+        found = true;
+        if (!runTunnel(seed)) {
+            return 1;
+        }
+    }
+    if (!found) {
+        std::cerr << "Unknown scenario: " << only << std::endl;
+        return -1;
+    }
+    return 0;
+}
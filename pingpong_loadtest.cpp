@@ -0,0 +1,339 @@
+// Space Ping Pong - load test for pingpong_server
+//
+// Spawns N bot clients, each with its own UDP socket, all driven from one
+// epoll loop. Bots join, play by chasing the ball in the state the server
+// sends back, and join again when their match ends. At the end it reports
+// how regularly state arrived and asks the server what the run cost it,
+// which gives rooms per core. Linux only (epoll).
+#include "input_recording.h"
+#include "netplay.h"
+#include "server_protocol.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t NS_PER_MS = 1000000;
+const uint64_t JOIN_RETRY_NS = 250 * NS_PER_MS;
+const uint64_t INPUT_KEEPALIVE_NS = 100 * NS_PER_MS;
+const uint64_t STATE_TIMEOUT_NS = 3000 * NS_PER_MS;
+const uint32_t TIMER_ID = UINT32_MAX;
+
+struct Bot {
+    UdpSocket socket;
+    bool seated;
+    uint32_t nonce;
+    SeatAssignment seat;
+    NetAddress worker;
+    RoomState state;
+    bool hasState;
+    uint64_t lastJoin;
+    uint64_t lastState;
+    uint64_t lastInput;
+    uint8_t lastBits;
+    
+    Bot() : seated(false), nonce(0), hasState(false), lastJoin(0), lastState(0), lastInput(0), lastBits(0) {}
+};
+
+struct LoadStats {
+    uint64_t statesReceived;
+    uint64_t bytesReceived;
+    uint64_t matchesFinished;
+    uint64_t seatsTaken;
+    uint64_t full;
+    std::vector<uint32_t> intervalsUs;  // Between consecutive states of one bot
+    
+    LoadStats() : statesReceived(0), bytesReceived(0), matchesFinished(0), seatsTaken(0), full(0) {}
+};
+
+void send(Bot& bot, const NetAddress& to, const PacketWriter& packet) {
+    bot.socket.sendTo(to, packet.data(), packet.size());
+}
+
+void sendJoin(Bot& bot, const NetAddress& lobby, uint64_t now) {
+    PacketWriter packet(ServerPacket::JOIN);
+    packet.u32(bot.nonce);
+    send(bot, lobby, packet);
+    bot.lastJoin = now;
+}
+
+void sendInput(Bot& bot, uint8_t bits, uint64_t now) {
+    PacketWriter packet(ServerPacket::INPUT);
+    packet.u32(bot.seat.roomId);
+    packet.u8(bot.seat.slot);
+    packet.u8(bits);
+    send(bot, bot.worker, packet);
+    bot.lastBits = bits;
+    bot.lastInput = now;
+}
+
+void rejoin(Bot& bot) {
+    bot.seated = false;
+    bot.hasState = false;
+    bot.nonce++;
+    bot.lastJoin = 0;
+}
+
+// Follow the nearest ball coming this way, otherwise drift to the middle
+PaddleInput chaseBall(const Bot& bot) {
+    const RoomState& state = bot.state;
+    bool right = bot.seat.slot == 1;
+    float paddleY = right ? state.paddle1Y : state.paddle2Y;
+    float center = paddleY + (right ? state.paddle1Height : state.paddle2Height) / 2.0f;
+    float target = SCREEN_HEIGHT / 2.0f;
+    float nearest = SCREEN_WIDTH;
+    for (const RoomState::BallState& ball : state.balls) {
+        bool incoming = right ? ball.vx > 0 : ball.vx < 0;
+        float distance = right ? SCREEN_WIDTH - ball.x : ball.x;
+        if (incoming && distance < nearest) {
+            nearest = distance;
+            target = ball.y;
+        }
+    }
+    return PaddleInput(center > target + 15, center < target - 15);
+}
+
+void receive(Bot& bot, LoadStats& stats, uint64_t now) {
+    uint8_t buffer[MAX_SERVER_PACKET];
+    NetAddress from;
+    size_t size;
+    while ((size = bot.socket.receiveFrom(from, buffer, sizeof(buffer))) > 0) {
+        PacketReader packet(buffer, size);
+        if (packet.getType() == ServerPacket::ASSIGN && !bot.seated) {
+            SeatAssignment seat;
+            if (readAssignment(packet, seat) && seat.nonce == bot.nonce) {
+                bot.seat = seat;
+                bot.worker = from;
+                bot.worker.port = seat.workerPort;
+                bot.seated = true;
+                bot.lastState = now;
+                stats.seatsTaken++;
+                sendInput(bot, 0, now);
+            }
+        } else if (packet.getType() == ServerPacket::FULL) {
+            stats.full++;
+        } else if (packet.getType() == ServerPacket::STATE && bot.seated) {
+            RoomState state;
+            if (!readState(packet, state) || state.roomId != bot.seat.roomId) {
+                continue;
+            }
+            if (bot.hasState) {
+                stats.intervalsUs.push_back((uint32_t)((now - bot.lastState) / 1000));
+            }
+            stats.statesReceived++;
+            stats.bytesReceived += size;
+            bot.state = state;
+            bot.hasState = true;
+            bot.lastState = now;
+            if (state.over) {
+                // Both bots see the end; count it once
+                if (bot.seat.slot == 1) stats.matchesFinished++;
+                rejoin(bot);
+            }
+        }
+    }
+}
+
+// One bot frame: join, give up on a silent room, or send input
+void update(Bot& bot, const NetAddress& lobby, uint64_t now) {
+    if (!bot.seated) {
+        if (now - bot.lastJoin >= JOIN_RETRY_NS) {
+            sendJoin(bot, lobby, now);
+        }
+        return;
+    }
+    if (now - bot.lastState > STATE_TIMEOUT_NS) {
+        rejoin(bot);
+        return;
+    }
+    uint8_t bits = bot.hasState ? packInputs(chaseBall(bot), PaddleInput()) : 0;
+    if (bits != bot.lastBits || now - bot.lastInput >= INPUT_KEEPALIVE_NS) {
+        sendInput(bot, bits, now);
+    }
+}
+
+// Ask the lobby for its totals, retrying a few times
+bool queryServer(UdpSocket& socket, const NetAddress& lobby, ServerStats& stats) {
+    for (int attempt = 0; attempt < 10; attempt++) {
+        PacketWriter request(ServerPacket::STATS_REQUEST);
+        socket.sendTo(lobby, request.data(), request.size());
+        uint64_t deadline = traceNow() + 100 * NS_PER_MS;
+        while (traceNow() < deadline) {
+            uint8_t buffer[MAX_SERVER_PACKET];
+            NetAddress from;
+            size_t size = socket.receiveFrom(from, buffer, sizeof(buffer));
+            if (size == 0) {
+                usleep(1000);
+                continue;
+            }
+            PacketReader packet(buffer, size);
+            if (packet.getType() == ServerPacket::STATS && readStats(packet, stats)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string server = "127.0.0.1:27960";
+    int botCount = 200;
+    double seconds = 10;
+    double warmup = 2;
+    int frameRate = 60;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--server" && i + 1 < argc) {
+            server = argv[++i];
+        } else if (arg == "--bots" && i + 1 < argc) {
+            botCount = std::atoi(argv[++i]);
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = std::atof(argv[++i]);
+        } else if (arg == "--fps" && i + 1 < argc) {
+            frameRate = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: pingpong_loadtest [--server HOST:PORT] [--bots N] [--seconds S] "
+                      << "[--warmup S] [--fps N]" << std::endl;
+            return -1;
+        }
+    }
+    if (botCount <= 0 || seconds <= 0 || warmup < 0 || frameRate <= 0 || frameRate > 1000) {
+        std::cerr << "Bots, seconds and frame rate must be positive" << std::endl;
+        return -1;
+    }
+    NetAddress lobby;
+    if (!NetAddress::parse(server, lobby)) {
+        std::cerr << "Could not resolve " << server << std::endl;
+        return -1;
+    }
+    
+    int epollFd = epoll_create1(0);
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    uint64_t period = 1000000000ull / frameRate;
+    itimerspec spec = {};
+    spec.it_interval.tv_sec = period / 1000000000ull;
+    spec.it_interval.tv_nsec = period % 1000000000ull;
+    spec.it_value = spec.it_interval;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = TIMER_ID;
+    if (epollFd < 0 || timerFd < 0 || timerfd_settime(timerFd, 0, &spec, nullptr) != 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event) != 0) {
+        std::cerr << "Could not set up epoll" << std::endl;
+        return -1;
+    }
+    
+    std::vector<std::unique_ptr<Bot>> bots;
+    for (int i = 0; i < botCount; i++) {
+        bots.push_back(std::unique_ptr<Bot>(new Bot()));
+        Bot& bot = *bots.back();
+        event.data.u32 = (uint32_t)i;
+        if (!bot.socket.open(0) || epoll_ctl(epollFd, EPOLL_CTL_ADD, (int)bot.socket.getHandle(), &event) != 0) {
+            std::cerr << "Could not open socket for bot " << i << std::endl;
+            return -1;
+        }
+    }
+    
+    // Totals from before the warmup ends are thrown away, except seats
+    UdpSocket control;
+    control.open(0);
+    ServerStats before;
+    bool measured = false;
+    LoadStats stats;
+    
+    uint64_t start = traceNow();
+    uint64_t measureStart = start + (uint64_t)(warmup * 1e9);
+    uint64_t end = measureStart + (uint64_t)(seconds * 1e9);
+    std::vector<epoll_event> events(256);
+    while (traceNow() < end) {
+        int count = epoll_wait(epollFd, events.data(), (int)events.size(), 100);
+        uint64_t now = traceNow();
+        for (int i = 0; i < count; i++) {
+            uint32_t id = events[i].data.u32;
+            if (id == TIMER_ID) {
+                uint64_t expirations;
+                if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    for (auto& bot : bots) {
+                        update(*bot, lobby, now);
+                    }
+                }
+            } else {
+                receive(*bots[id], stats, now);
+            }
+        }
+        
+        if (!measured && now >= measureStart) {
+            if (!queryServer(control, lobby, before)) {
+                std::cerr << "Server did not answer a stats request" << std::endl;
+                return -1;
+            }
+            uint64_t seatsTaken = stats.seatsTaken;
+            stats = LoadStats();
+            stats.seatsTaken = seatsTaken;
+            measured = true;
+        }
+    }
+    
+    ServerStats after;
+    bool answered = queryServer(control, lobby, after);
+    for (auto& bot : bots) {
+        if (bot->seated) {
+            PacketWriter leave(ServerPacket::LEAVE);
+            leave.u32(bot->seat.roomId);
+            leave.u8(bot->seat.slot);
+            send(*bot, bot->worker, leave);
+        }
+    }
+    
+    std::vector<uint32_t>& intervals = stats.intervalsUs;
+    std::sort(intervals.begin(), intervals.end());
+    double meanMs = 0;
+    for (uint32_t interval : intervals) meanMs += interval / 1000.0;
+    meanMs = intervals.empty() ? 0 : meanMs / intervals.size();
+    double p99Ms = intervals.empty() ? 0 : intervals[intervals.size() * 99 / 100] / 1000.0;
+    double maxMs = intervals.empty() ? 0 : intervals.back() / 1000.0;
+    
+    char buffer[320];
+    std::snprintf(buffer, sizeof(buffer),
+                  "%d bots, %.0f s: %llu seats taken, %llu matches, %.0f states/s (%.0f KB/s), "
+                  "state interval mean %.1f ms p99 %.1f ms max %.1f ms, %llu full",
+                  botCount, seconds, (unsigned long long)stats.seatsTaken, (unsigned long long)stats.matchesFinished,
+                  stats.statesReceived / seconds, stats.bytesReceived / 1024.0 / seconds,
+                  meanMs, p99Ms, maxMs, (unsigned long long)stats.full);
+    std::cout << buffer << std::endl;
+    
+    if (!answered) {
+        std::cerr << "Server did not answer a stats request" << std::endl;
+        return -1;
+    }
+    double wall = (after.wallNs - before.wallNs) / 1e9;
+    double cores = (after.cpuNs - before.cpuNs) / 1e9 / wall;
+    uint64_t ticks = after.roomTicks - before.roomTicks;
+    std::snprintf(buffer, sizeof(buffer),
+                  "server: %u workers, %u rooms playing, %.0f room ticks/s, %.2f us CPU per room tick, "
+                  "room busy %.2f us per tick, %.1f%% of a core, %.0f rooms per core",
+                  after.workers, after.playingRooms, ticks / wall,
+                  ticks > 0 ? (after.cpuNs - before.cpuNs) / 1e3 / ticks : 0.0,
+                  ticks > 0 ? (after.roomBusyNs - before.roomBusyNs) / 1e3 / ticks : 0.0,
+                  cores * 100, cores > 0 ? after.playingRooms / cores : 0.0);
+    std::cout << buffer << std::endl;
+    
+    close(timerFd);
+    close(epollFd);
+    return 0;
+}
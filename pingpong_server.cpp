@@ -0,0 +1,74 @@
+// Space Ping Pong - dedicated headless match server
+//
+// Hosts two-player matches for as many clients as connect, with no window
+// or renderer; see match_server.h. Runs until interrupted, printing a load
+// report every --stats-interval seconds. Linux only (epoll).
+#include "match_server.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            int port = std::atoi(argv[++i]);
+            if (port < 0 || port > 65535) {
+                std::cerr << "Port must be between 0 and 65535" << std::endl;
+                return -1;
+            }
+            options.port = (uint16_t)port;
+        } else if (arg == "--workers" && i + 1 < argc) {
+            options.workers = std::atoi(argv[++i]);
+        } else if (arg == "--tick-rate" && i + 1 < argc) {
+            options.tickRate = std::atoi(argv[++i]);
+        } else if (arg == "--send-rate" && i + 1 < argc) {
+            options.sendRate = std::atoi(argv[++i]);
+        } else if (arg == "--max-rooms" && i + 1 < argc) {
+            options.maxRooms = std::atoi(argv[++i]);
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            options.statsInterval = std::atof(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "Usage: pingpong_server [--port N] [--workers N] [--tick-rate N] [--send-rate N] "
+                      << "[--max-rooms N] [--stats-interval SECONDS] [--seed N]" << std::endl;
+            return -1;
+        }
+    }
+    if (options.workers <= 0 || options.maxRooms <= 0 || options.tickRate <= 0 || options.tickRate > 1000) {
+        std::cerr << "Workers and rooms must be positive and the tick rate in 1..1000" << std::endl;
+        return -1;
+    }
+    if (options.sendRate <= 0 || options.sendRate > options.tickRate) {
+        std::cerr << "Send rate must be positive and at most the tick rate" << std::endl;
+        return -1;
+    }
+    
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    
+    MatchServer server(options);
+    if (!server.start()) {
+        return -1;
+    }
+    server.run(stopRequested);
+    
+    ServerStats stats = server.getStats();
+    std::cout << "Served " << stats.matchesFinished << " matches, " << stats.roomTicks << " room ticks in "
+              << stats.wallNs / 1e9 << " s using " << stats.cpuNs / 1e9 << " s of worker CPU" << std::endl;
+    return 0;
+}
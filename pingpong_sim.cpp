@@ -0,0 +1,818 @@
+// Space Ping Pong - simulation core
+#include "pingpong_sim.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Below this many balls pairwise tests beat rebuilding the grid
+const size_t GRID_MIN_BALLS = 32;
+
+// Grid cells hold a few balls of either size
+const float GRID_CELL_SIZE = 32;
+
+// Bounces a ball may make in one tick; a ball wedged between a paddle and a
+// wall stops where it is for the rest of the tick
+const int MAX_BOUNCES = 8;
+
+// A ball this much inside a rect is still only touching it: what rounding
+// leaves after placing it at the time of impact
+const float CONTACT_SLOP = 0.01f;
+
+// Time of impact of a ball that doesn't hit anything in its motion
+const float NO_IMPACT = 2;
+
+// Indexed by Difficulty
+const AiSkill AI_SKILLS[] = {
+    {0.2f, 20, 8, 80},      // EASY
+    {0.5f, 10, 4, 40},      // MEDIUM
+    {1.0f, 3, 2, 12},       // HARD
+};
+
+// An AI paddle this close to its target stays put
+const float AI_DEAD_ZONE = 5;
+
+// The AI clock is wound back by this once it gets here, so arrival times
+// keep their precision however long a match runs
+const float AI_CLOCK_REBASE = 65536;
+
+// Soonest arrival on top, ties to the lowest index
+bool laterArrival(const AiArrival& a, const AiArrival& b) {
+    return a.time != b.time ? a.time > b.time : a.ball > b.ball;
+}
+
+// Times at which x + motion * t enters and leaves [low, high]; false if it
+// never is inside
+bool sweepSpan(float x, float motion, float low, float high, float& enter, float& exit) {
+    if (motion == 0) {
+        enter = -std::numeric_limits<float>::infinity();
+        exit = std::numeric_limits<float>::infinity();
+        return x >= low && x <= high;
+    }
+    float first = (low - x) / motion;
+    float second = (high - x) / motion;
+    enter = std::min(first, second);
+    exit = std::max(first, second);
+    return true;
+}
+
+}
+
+const AiSkill& aiSkill(Difficulty difficulty) {
+    return AI_SKILLS[(int)difficulty];
+}
+
+void PowerUp::update(float step) {
+    lifetime -= step;
+    floatOffset += 0.1f * step;
+    y += std::sin(floatOffset) * 0.5f * step;
+}
+
+Ball::Ball(float x, float y, Random& rng, float speed)
+    : x(x), y(y), prevX(x), prevY(y), size(8), baseSpeed(speed), speedMultiplier(1.0f),
+      isMagnetic(false), magneticForce(0.0f), trailTimer(0.0f), course(0) {
+    float direction = rng.range(0, 1) == 0 ? -1 : 1;
+    velocity = Vector2D(speed * direction, speed * rng.uniform(-0.5f, 0.5f));
+}
+
+void Ball::updateTrail(float step) {
+    // Add to trail once per frame's worth of ticks, so its length on
+    // screen is the same at every tick rate
+    trailTimer += step;
+    if (trailTimer >= 1.0f) {
+        trailTimer -= 1.0f;
+        trail.push_back(Vector2D(x, y));
+        if (trail.size() > 10) {
+            trail.erase(trail.begin());
+        }
+    }
+}
+
+float Ball::sweepWalls(const Vector2D& motion) const {
+    float top = (float)size;
+    float bottom = (float)(SCREEN_HEIGHT - size);
+    if (motion.y < 0 && y + motion.y < top) {
+        return std::max(0.0f, (top - y) / motion.y);
+    }
+    if (motion.y > 0 && y + motion.y > bottom) {
+        return std::max(0.0f, (bottom - y) / motion.y);
+    }
+    return NO_IMPACT;
+}
+
+float Ball::sweep(const Rect& rect, const Vector2D& motion) const {
+    float radius = (float)size;
+    
+    // Touching already: an impact now if moving in, or if really inside
+    float nearX = std::max(rect.x, std::min(rect.x + rect.w, x));
+    float nearY = std::max(rect.y, std::min(rect.y + rect.h, y));
+    Vector2D away(x - nearX, y - nearY);
+    float distanceSquared = away.dot(away);
+    if (distanceSquared <= radius * radius) {
+        float inside = radius - CONTACT_SLOP;
+        return distanceSquared < inside * inside || away.dot(motion) < 0 ? 0 : NO_IMPACT;
+    }
+    if (motion.x == 0 && motion.y == 0) {
+        return NO_IMPACT;
+    }
+    
+    // The center's path against the rect grown by the radius on every side
+    float enterX, exitX, enterY, exitY;
+    if (!sweepSpan(x, motion.x, rect.x - radius, rect.x + rect.w + radius, enterX, exitX) ||
+        !sweepSpan(y, motion.y, rect.y - radius, rect.y + rect.h + radius, enterY, exitY)) {
+        return NO_IMPACT;
+    }
+    float enter = std::max(enterX, enterY);
+    float exit = std::min(exitX, exitY);
+    if (enter > exit || enter > 1 || exit < 0) {
+        return NO_IMPACT;
+    }
+    
+    // Beside an edge that is where the ball touches; past a corner the ball
+    // has to come within its radius of the corner
+    float time = std::max(enter, 0.0f);
+    float hitX = x + motion.x * time;
+    float hitY = y + motion.y * time;
+    if ((hitX >= rect.x && hitX <= rect.x + rect.w) || (hitY >= rect.y && hitY <= rect.y + rect.h)) {
+        return time;
+    }
+    Vector2D corner(hitX < rect.x ? rect.x : rect.x + rect.w, hitY < rect.y ? rect.y : rect.y + rect.h);
+    Vector2D offset = Vector2D(x, y) - corner;
+    float a = motion.dot(motion);
+    float b = offset.dot(motion);
+    float c = offset.dot(offset) - radius * radius;
+    float discriminant = b * b - a * c;
+    if (discriminant < 0) {
+        return NO_IMPACT;
+    }
+    time = (-b - std::sqrt(discriminant)) / a;
+    return time >= 0 && time <= 1 ? time : NO_IMPACT;
+}
+
+void Ball::bounceOffWall() {
+    velocity.y *= -1;
+    y = std::max((float)size, std::min((float)(SCREEN_HEIGHT - size), y));
+}
+
+void Ball::bounceOffPaddle(const Rect& paddleRect, float paddleCenterY) {
+    // Calculate hit position relative to paddle center
+    float hitPos = (y - paddleCenterY) / (paddleRect.h / 2);
+    hitPos = std::max(-1.0f, std::min(1.0f, hitPos));
+    
+    // Head back into the field, whichever side of the paddle was hit
+    bool leftPaddle = paddleRect.x < SCREEN_WIDTH / 2;
+    velocity.x = leftPaddle ? std::fabs(velocity.x) : -std::fabs(velocity.x);
+    
+    // Adjust vertical velocity based on hit position
+    velocity.y = hitPos * baseSpeed * 0.75f;
+    
+    // Increase speed slightly
+    float currentSpeed = velocity.magnitude();
+    if (currentSpeed < baseSpeed * 2) {
+        velocity = velocity * 1.05f;
+    }
+    
+    // A paddle that moved into the ball pushes it out in front
+    float nearX = std::max(paddleRect.x, std::min(paddleRect.x + paddleRect.w, x));
+    float nearY = std::max(paddleRect.y, std::min(paddleRect.y + paddleRect.h, y));
+    float inside = size - CONTACT_SLOP;
+    if ((x - nearX) * (x - nearX) + (y - nearY) * (y - nearY) < inside * inside) {
+        x = leftPaddle ? paddleRect.x + paddleRect.w + size : paddleRect.x - size;
+    }
+}
+
+void Ball::resetPosition(Random& rng, int direction) {
+    x = SCREEN_WIDTH / 2;
+    y = SCREEN_HEIGHT / 2;
+    prevX = x;
+    prevY = y;
+    
+    if (direction == 0) {
+        direction = rng.range(0, 1) == 0 ? -1 : 1;
+    }
+    
+    velocity = Vector2D(baseSpeed * direction, baseSpeed * rng.uniform(-0.5f, 0.5f));
+    speedMultiplier = 1.0f;
+    trail.clear();
+    trailTimer = 0.0f;
+    isMagnetic = false;
+    magneticForce = 0.0f;
+}
+
+void Paddle::update(float step, const PaddleInput* input, const std::vector<Ball>& balls, uint32_t ballsVersion,
+                    const AiSkill& skill, Random& rng) {
+    prevY = y;
+    
+    // Update effects
+    for (auto it = effects.begin(); it != effects.end();) {
+        it->second -= step;
+        if (it->second <= 0) {
+            removeEffect(it->first);
+            it = effects.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    // Update shield
+    if (shieldDuration > 0) {
+        shieldDuration -= step;
+        if (shieldDuration <= 0) {
+            shieldActive = false;
+        }
+    }
+    
+    // Update laser
+    if (laserDuration > 0) {
+        laserDuration -= step;
+        if (laserDuration <= 0) {
+            laserActive = false;
+        }
+    }
+    
+    // Player movement
+    if (isPlayer && input) {
+        if (input->up && y > 0) {
+            y -= speed * step;
+        }
+        if (input->down && y < SCREEN_HEIGHT - height) {
+            y += speed * step;
+        }
+    }
+    // AI movement
+    else if (!isPlayer) {
+        aiMove(balls, ballsVersion, skill, step, rng);
+    }
+    
+    // Keep paddle within bounds
+    y = std::max(0.0f, std::min((float)(SCREEN_HEIGHT - height), y));
+}
+
+void Paddle::aiMove(const std::vector<Ball>& balls, uint32_t ballsVersion, const AiSkill& skill, float step,
+                    Random& rng) {
+    if (ballsVersion != aiBallsVersion) {
+        aiBallsVersion = ballsVersion;
+        aiArrivals.clear();
+        for (size_t i = 0; i < balls.size(); i++) {
+            float arrivalY, frames;
+            if (predictArrival(balls[i], arrivalY, frames)) {
+                aiArrivals.push_back({aiClock + frames, arrivalY, (uint32_t)i, balls[i].course});
+            }
+        }
+        std::make_heap(aiArrivals.begin(), aiArrivals.end(), laterArrival);
+        aiThreat = -1;
+    }
+    
+    // Arrivals of balls that changed course since are dropped as they come up
+    while (!aiArrivals.empty() && (aiArrivals.front().ball >= balls.size() ||
+                                   balls[aiArrivals.front().ball].course != aiArrivals.front().course)) {
+        std::pop_heap(aiArrivals.begin(), aiArrivals.end(), laterArrival);
+        aiArrivals.pop_back();
+    }
+    
+    // Meet the ball that gets here first; with none coming, wait in the middle
+    int threat = aiArrivals.empty() ? -1 : (int)aiArrivals.front().ball;
+    uint32_t threatCourse = aiArrivals.empty() ? 0 : aiArrivals.front().course;
+    if (threat != aiThreat || threatCourse != aiThreatCourse) {
+        aiThreat = threat;
+        aiThreatCourse = threatCourse;
+        float aim = SCREEN_HEIGHT / 2;
+        if (threat >= 0) {
+            aim = aiArrivals.front().y +
+                  skill.predictionError * (rng.uniform(-0.5f, 0.5f) + rng.uniform(-0.5f, 0.5f));
+        }
+        aiPendingY = aim;
+        
+        // A change while still reacting to the last one is taken in with it
+        if (aiReactionTimer <= 0) {
+            aiReactionTimer = std::max(0.0f, skill.reactionDelay + rng.uniform(-1, 1) * skill.reactionSpread);
+        }
+    }
+    
+    aiClock += step;
+    if (aiClock >= AI_CLOCK_REBASE) {
+        aiClock -= AI_CLOCK_REBASE;
+        for (AiArrival& arrival : aiArrivals) {
+            arrival.time -= AI_CLOCK_REBASE;
+        }
+    }
+    if (aiReactionTimer > 0) {
+        aiReactionTimer = std::max(0.0f, aiReactionTimer - step);
+    }
+    if (aiReactionTimer <= 0) {
+        aiTargetY = aiPendingY;
+    }
+    
+    float offset = aiTargetY - getCenterY();
+    if (std::fabs(offset) > AI_DEAD_ZONE) {
+        float move = std::min(std::fabs(offset), speed * skill.speedFactor * step);
+        y += offset > 0 ? move : -move;
+    }
+}
+
+void Paddle::aiTrack(const std::vector<Ball>& balls, size_t index) {
+    // Stale arrivals pile up under the top; sweep them out once they
+    // outnumber the balls
+    if (aiArrivals.size() > 2 * balls.size() + 16) {
+        aiArrivals.erase(std::remove_if(aiArrivals.begin(), aiArrivals.end(),
+                                        [&](const AiArrival& arrival) {
+                                            return arrival.ball >= balls.size() ||
+                                                   balls[arrival.ball].course != arrival.course;
+                                        }),
+                         aiArrivals.end());
+        std::make_heap(aiArrivals.begin(), aiArrivals.end(), laterArrival);
+    }
+    
+    float arrivalY, frames;
+    if (predictArrival(balls[index], arrivalY, frames)) {
+        aiArrivals.push_back({aiClock + frames, arrivalY, (uint32_t)index, balls[index].course});
+        std::push_heap(aiArrivals.begin(), aiArrivals.end(), laterArrival);
+    }
+}
+
+bool Paddle::predictArrival(const Ball& ball, float& arrivalY, float& frames) const {
+    // Frames until the ball's center reaches the face it would touch
+    Vector2D velocity = ball.velocity * ball.speedMultiplier;
+    float faceX = x < SCREEN_WIDTH / 2 ? x + width + ball.size : x - ball.size;
+    if (velocity.x == 0) {
+        return false;
+    }
+    frames = (faceX - ball.x) / velocity.x;
+    if (frames < 0) {
+        return false;
+    }
+    
+    // Unfold the walls: the path goes on straight through mirrored copies of
+    // the field, and folding the end point back gives where the ball is
+    float low = (float)ball.size;
+    float span = (float)(SCREEN_HEIGHT - 2 * ball.size);
+    float unfolded = std::fmod(ball.y + velocity.y * frames - low, 2 * span);
+    if (unfolded < 0) {
+        unfolded += 2 * span;
+    }
+    arrivalY = low + (unfolded <= span ? unfolded : 2 * span - unfolded);
+    return true;
+}
+
+void Paddle::applyEffect(PowerUpType effectType, float duration) {
+    effects[effectType] = duration;
+    
+    switch (effectType) {
+        case PowerUpType::PADDLE_GROW:
+            height = std::min((int)(baseHeight * 1.5f), 150);
+            break;
+        case PowerUpType::PADDLE_SHRINK:
+            height = std::max((int)(baseHeight * 0.5f), 50);
+            break;
+        case PowerUpType::SHIELD:
+            shieldActive = true;
+            shieldDuration = duration;
+            break;
+        case PowerUpType::LASER:
+            laserActive = true;
+            laserDuration = duration;
+            laserY = y + height / 2;
+            break;
+        default:
+            break;
+    }
+}
+
+void Paddle::removeEffect(PowerUpType effectType) {
+    if (effectType == PowerUpType::PADDLE_GROW || effectType == PowerUpType::PADDLE_SHRINK) {
+        height = baseHeight;
+    }
+}
+
+Match::Match()
+    : paddle1(SCREEN_WIDTH - 45, SCREEN_HEIGHT / 2 - 50, true), paddle2(30, SCREEN_HEIGHT / 2 - 50, false),
+      difficulty(Difficulty::MEDIUM), player1Score(0), player2Score(0), powerUpTimer(0),
+      powerUpSpawnInterval(600), freezeTimer(0), over(false), maxBalls(MAX_BALLS), stress(false), ballsVersion(0),
+      ballSpeed(8.0f), paddle1Skill(nullptr), paddle2Skill(nullptr), grid(SCREEN_WIDTH, SCREEN_HEIGHT, GRID_CELL_SIZE) {
+    reset(true, false, 0);
+}
+
+void Match::reset(bool player1Human, bool player2Human, uint64_t seed) {
+    rng.reseed(seed, GAMEPLAY_STREAM);
+    balls.clear();
+    balls.push_back(Ball(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, rng, ballSpeed));
+    
+    paddle1 = Paddle(SCREEN_WIDTH - 45, SCREEN_HEIGHT / 2 - 50, player1Human);
+    paddle2 = Paddle(30, SCREEN_HEIGHT / 2 - 50, player2Human);
+    
+    powerUps.clear();
+    events.clear();
+    player1Score = 0;
+    player2Score = 0;
+    powerUpTimer = 0;
+    freezeTimer = 0;
+    over = false;
+    maxBalls = MAX_BALLS;
+    stress = false;
+    ballsVersion++;
+}
+
+void Match::startStress(size_t count) {
+    stress = true;
+    maxBalls = MAX_STRESS_BALLS;
+    balls.clear();
+    count = std::max<size_t>(1, std::min(count, maxBalls));
+    for (size_t i = 0; i < count; i++) {
+        Ball ball(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, rng, ballSpeed);
+        ball.size = STRESS_BALL_SIZE;
+        serveStressBall(ball);
+        balls.push_back(ball);
+    }
+    ballsVersion++;
+}
+
+// Anywhere over the middle half, so a crowd of balls doesn't start as one pile
+void Match::serveStressBall(Ball& ball) {
+    ball.resetPosition(rng);
+    ball.x = rng.uniform(SCREEN_WIDTH / 4, 3 * SCREEN_WIDTH / 4);
+    ball.y = rng.uniform((float)ball.size, (float)(SCREEN_HEIGHT - ball.size));
+    ball.prevX = ball.x;
+    ball.prevY = ball.y;
+}
+
+void Match::tick(float step, const PaddleInput& input1, const PaddleInput& input2) {
+    beginTick();
+    if (updateFreeze(step)) {
+        return;
+    }
+    updatePaddles(step, input1, input2);
+    updateBalls(step);
+    updatePowerUps(step);
+    checkGameOver();
+}
+
+void Match::beginTick() {
+    events.clear();
+}
+
+bool Match::updateFreeze(float step) {
+    if (freezeTimer > 0) {
+        freezeTimer -= step;
+        
+        // Nothing moves this tick, so nothing is drawn moving through it
+        for (Ball& ball : balls) {
+            ball.prevX = ball.x;
+            ball.prevY = ball.y;
+        }
+        paddle1.prevY = paddle1.y;
+        paddle2.prevY = paddle2.y;
+        return true;
+    }
+    return false;
+}
+
+void Match::updatePaddles(float step, const PaddleInput& input1, const PaddleInput& input2) {
+    TRACE_SCOPE("paddles");
+    const AiSkill& skill = aiSkill(difficulty);
+    paddle1.update(step, &input1, balls, ballsVersion, paddle1Skill ? *paddle1Skill : skill, rng);
+    paddle2.update(step, &input2, balls, ballsVersion, paddle2Skill ? *paddle2Skill : skill, rng);
+}
+
+void Match::updateBalls(float step) {
+    TRACE_SCOPE("balls");
+    size_t kept = 0;
+    for (size_t i = 0; i < balls.size(); i++) {
+        int scorer = moveBall(i, step);
+        if (scorer != 0) {
+            (scorer == 1 ? player1Score : player2Score)++;
+            events.push_back(MatchEvent(MatchEvent::SCORE, scorer));
+            if (!stress) {
+                ballsVersion++;
+                continue;
+            }
+            serveStressBall(balls[i]);
+            courseChanged(i);
+        }
+        if (kept != i) {
+            balls[kept] = std::move(balls[i]);
+        }
+        kept++;
+    }
+    balls.erase(balls.begin() + kept, balls.end());
+    
+    // The last ball scored: serve a new one, which moves this tick as well
+    while (balls.empty()) {
+        balls.push_back(Ball(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, rng, ballSpeed));
+        ballsVersion++;
+        int scorer = moveBall(balls.size() - 1, step);
+        if (scorer != 0) {
+            (scorer == 1 ? player1Score : player2Score)++;
+            events.push_back(MatchEvent(MatchEvent::SCORE, scorer));
+            balls.pop_back();
+        }
+    }
+    
+    if (stress) {
+        collideBalls();
+    }
+}
+
+// Moves a ball through the tick, bouncing it off the walls and paddles at
+// each time of impact; 1 or 2 if that player scored with it, else 0
+int Match::moveBall(size_t index, float step) {
+    Ball& ball = balls[index];
+    ball.prevX = ball.x;
+    ball.prevY = ball.y;
+    
+    const Paddle* paddles[] = {&paddle1, &paddle2};
+    float remaining = 1;    // Of the tick
+    for (int bounce = 0; bounce < MAX_BOUNCES && remaining > 0; bounce++) {
+        Vector2D motion = ball.velocity * (ball.speedMultiplier * step * remaining);
+        
+        // The first thing the ball meets; walls win ties
+        float impact = ball.sweepWalls(motion);
+        const Paddle* hit = nullptr;
+        for (const Paddle* paddle : paddles) {
+            float time = ball.sweep(paddle->getRect(), motion);
+            if (time < impact) {
+                impact = time;
+                hit = paddle;
+            }
+        }
+        if (impact > 1) {
+            ball.x += motion.x;
+            ball.y += motion.y;
+            break;
+        }
+        
+        ball.x += motion.x * impact;
+        ball.y += motion.y * impact;
+        remaining *= 1 - impact;
+        if (hit) {
+            ball.bounceOffPaddle(hit->getRect(), hit->getCenterY());
+            courseChanged(index);
+            events.push_back(MatchEvent(MatchEvent::PADDLE_HIT, ball.x, ball.y));
+        } else {
+            ball.bounceOffWall();
+        }
+    }
+    ball.updateTrail(step);
+    
+    // Score when ball goes off screen
+    if (ball.x < 0) {
+        return 1;
+    }
+    if (ball.x > SCREEN_WIDTH) {
+        return 2;
+    }
+    return 0;
+}
+
+// A ball changed course; the AI paddles predict it alone, so a crowd of
+// balls knocking into each other costs them a heap push per knock instead
+// of a prediction over every ball
+void Match::courseChanged(size_t index) {
+    balls[index].course++;
+    for (Paddle* paddle : {&paddle1, &paddle2}) {
+        if (!paddle->isPlayer) {
+            paddle->aiTrack(balls, index);
+        }
+    }
+}
+
+// Buckets the balls; queries reach this much further than the largest ball
+void Match::buildBallGrid(float reach) {
+    int largest = 0;
+    for (const Ball& ball : balls) {
+        largest = std::max(largest, ball.size);
+    }
+    grid.build(balls.size(), largest + reach, [this](size_t i) { return Vector2D(balls[i].x, balls[i].y); });
+}
+
+// Stress balls are discs of equal mass that bounce elastically
+void Match::collideBalls() {
+    TRACE_SCOPE("ballCollisions");
+    // Pushing a pair apart moves each ball by at most its own size
+    buildBallGrid((float)STRESS_BALL_SIZE);
+    for (size_t i = 0; i < balls.size(); i++) {
+        Ball& a = balls[i];
+        grid.query(a.x - a.size, a.y - a.size, a.x + a.size, a.y + a.size, [&](size_t j) {
+            if (j <= i) {
+                return;
+            }
+            Ball& b = balls[j];
+            float dx = b.x - a.x;
+            float dy = b.y - a.y;
+            float contact = (float)(a.size + b.size);
+            float distanceSquared = dx * dx + dy * dy;
+            if (distanceSquared >= contact * contact) {
+                return;
+            }
+            
+            // Separate the pair along the line between their centers
+            float distance = std::sqrt(distanceSquared);
+            Vector2D normal = distance > 0 ? Vector2D(dx / distance, dy / distance) : Vector2D(1, 0);
+            float push = (contact - distance) / 2;
+            a.x -= normal.x * push;
+            a.y = std::max((float)a.size, std::min((float)(SCREEN_HEIGHT - a.size), a.y - normal.y * push));
+            b.x += normal.x * push;
+            b.y = std::max((float)b.size, std::min((float)(SCREEN_HEIGHT - b.size), b.y + normal.y * push));
+            
+            // Swap the velocity along the normal if they are closing in
+            float closing = (b.velocity - a.velocity).dot(normal);
+            if (closing < 0) {
+                a.velocity = a.velocity + normal * closing;
+                b.velocity = b.velocity - normal * closing;
+                courseChanged(i);
+                courseChanged(j);
+            }
+        });
+    }
+}
+
+void Match::updatePowerUps(float step) {
+    // Spawn new power-ups
+    powerUpTimer += step;
+    if (powerUpTimer >= powerUpSpawnInterval) {
+        spawnPowerUp();
+        powerUpTimer = 0;
+    }
+    
+    // Update existing power-ups
+    TRACE_SCOPE("powerUps");
+    powerUps.erase(std::remove_if(powerUps.begin(), powerUps.end(),
+        [](const PowerUp& p) { return !p.isAlive(); }), powerUps.end());
+    
+    // Balls multi-ball adds while this runs are past the grid's
+    size_t gridBalls = 0;
+    if (!powerUps.empty() && balls.size() >= GRID_MIN_BALLS) {
+        buildBallGrid(0);
+        gridBalls = balls.size();
+    }
+    
+    // Collected power-ups are dropped at the end, the rest kept in order
+    size_t kept = 0;
+    for (size_t i = 0; i < powerUps.size(); i++) {
+        PowerUp& powerUp = powerUps[i];
+        powerUp.update(step);
+        
+        // Check collisions with balls
+        size_t ball = collectingBall(powerUp.getRect(), gridBalls);
+        if (ball < balls.size()) {
+            applyPowerUp(powerUp.powerType, ball);
+            events.push_back(MatchEvent(MatchEvent::POWER_UP_COLLECTED, powerUp.x, powerUp.y, powerUp.powerType));
+            continue;
+        }
+        if (kept != i) {
+            powerUps[kept] = powerUp;
+        }
+        kept++;
+    }
+    powerUps.erase(powerUps.begin() + kept, powerUps.end());
+}
+
+// Lowest index of a ball touching the area, or balls.size() if none does.
+// Balls [0, gridBalls) are looked up in the grid, the rest one by one.
+size_t Match::collectingBall(const Rect& area, size_t gridBalls) {
+    size_t found = balls.size();
+    if (gridBalls > 0) {
+        grid.query(area.x, area.y, area.x + area.w, area.y + area.h, [&](size_t b) {
+            if (b < found && rectsIntersect(area, balls[b].getRect())) {
+                found = b;
+            }
+        });
+        if (found < balls.size()) {
+            return found;
+        }
+    }
+    for (size_t b = gridBalls; b < balls.size(); b++) {
+        if (rectsIntersect(area, balls[b].getRect())) {
+            return b;
+        }
+    }
+    return found;
+}
+
+void Match::checkGameOver() {
+    if (!over && !stress && (player1Score >= WINNING_SCORE || player2Score >= WINNING_SCORE)) {
+        over = true;
+        events.push_back(MatchEvent(MatchEvent::GAME_OVER));
+    }
+}
+
+void Match::spawnPowerUp() {
+    TRACE_SCOPE("spawnPowerUp");
+    float x = rng.range(SCREEN_WIDTH / 4, 3 * SCREEN_WIDTH / 4);
+    float y = rng.range(100, SCREEN_HEIGHT - 100);
+    PowerUpType type = (PowerUpType)(rng.range(0, 7) + 1);
+    
+    powerUps.push_back(PowerUp(x, y, type));
+    events.push_back(MatchEvent(MatchEvent::POWER_UP_SPAWNED, x, y, type));
+}
+
+void Match::applyPowerUp(PowerUpType powerType, size_t ballIndex) {
+    TRACE_SCOPE("applyPowerUp");
+    ballsVersion++;
+    Ball& ball = balls[ballIndex];
+    switch (powerType) {
+        case PowerUpType::SPEED_BOOST:
+            ball.speedMultiplier = 1.5f;
+            break;
+        case PowerUpType::MULTI_BALL: {
+            // A stress match doubles its balls instead of adding one
+            size_t first = stress ? 0 : ballIndex;
+            size_t last = stress ? balls.size() : ballIndex + 1;
+            for (size_t source = first; source < last && balls.size() < maxBalls; source++) {
+                Ball newBall(balls[source].x, balls[source].y, rng, ballSpeed);
+                newBall.velocity.y *= -1;
+                newBall.size = balls[source].size;
+                balls.push_back(newBall);
+            }
+            break;
+        }
+        case PowerUpType::FREEZE:
+            freezeTimer = 120; // 2 seconds
+            break;
+        case PowerUpType::MAGNET:
+            ball.isMagnetic = true;
+            ball.magneticForce = 0.5f;
+            break;
+        case PowerUpType::PADDLE_GROW:
+        case PowerUpType::PADDLE_SHRINK:
+        case PowerUpType::SHIELD:
+        case PowerUpType::LASER:
+            if (ball.x > SCREEN_WIDTH / 2) {
+                paddle1.applyEffect(powerType);
+            } else {
+                paddle2.applyEffect(powerType);
+            }
+            break;
+    }
+}
+
+namespace {
+
+template <typename T>
+void hashValue(uint64_t& hash, const T& value) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (unsigned char byte : bytes) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+}
+
+void hashPaddle(uint64_t& hash, const Paddle& paddle) {
+    hashValue(hash, paddle.y);
+    hashValue(hash, paddle.height);
+    hashValue(hash, paddle.shieldDuration);
+    hashValue(hash, paddle.laserDuration);
+    hashValue(hash, paddle.aiTargetY);
+    hashValue(hash, paddle.aiPendingY);
+    hashValue(hash, paddle.aiReactionTimer);
+    hashValue(hash, paddle.aiBallsVersion);
+    hashValue(hash, paddle.aiClock);
+    for (const AiArrival& arrival : paddle.aiArrivals) {
+        hashValue(hash, arrival.time);
+        hashValue(hash, arrival.y);
+        hashValue(hash, arrival.ball);
+        hashValue(hash, arrival.course);
+    }
+    hashValue(hash, paddle.aiThreat);
+    hashValue(hash, paddle.aiThreatCourse);
+    for (const auto& effect : paddle.effects) {
+        hashValue(hash, effect.first);
+        hashValue(hash, effect.second);
+    }
+}
+
+}
+
+uint64_t Match::checksum() const {
+    uint64_t hash = 14695981039346656037ull;
+    hashValue(hash, player1Score);
+    hashValue(hash, player2Score);
+    hashValue(hash, powerUpTimer);
+    hashValue(hash, freezeTimer);
+    hashValue(hash, over);
+    hashValue(hash, ballsVersion);
+    for (const Ball& ball : balls) {
+        hashValue(hash, ball.x);
+        hashValue(hash, ball.y);
+        hashValue(hash, ball.velocity.x);
+        hashValue(hash, ball.velocity.y);
+        hashValue(hash, ball.speedMultiplier);
+        hashValue(hash, ball.magneticForce);
+        hashValue(hash, ball.course);
+    }
+    hashPaddle(hash, paddle1);
+    hashPaddle(hash, paddle2);
+    for (const PowerUp& powerUp : powerUps) {
+        hashValue(hash, powerUp.x);
+        hashValue(hash, powerUp.y);
+        hashValue(hash, powerUp.powerType);
+        hashValue(hash, powerUp.lifetime);
+    }
+    
+    // Where the gameplay stream has got to
+    Random next = rng;
+    hashValue(hash, next.next64());
+    return hash;
+}
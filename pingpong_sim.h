@@ -0,0 +1,350 @@
+// Space Ping Pong - simulation core
+//
+// Balls, paddles, power-ups, scoring and power-up effects, with no video or
+// input dependency. The game drives a Match with keyboard state and draws
+// it; pingpong_bench drives it with AIs as fast as it can.
+#pragma once
+
+#include "collision_grid.h"
+#include "random.h"
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Playfield
+const int SCREEN_WIDTH = 1200;
+const int SCREEN_HEIGHT = 800;
+const int FPS = 60;
+
+// Points needed to win a match
+const int WINNING_SCORE = 11;
+
+// Balls a normal match and a stress match may have in play at once
+const size_t MAX_BALLS = 3;
+const size_t MAX_STRESS_BALLS = 10000;
+const int STRESS_BALL_SIZE = 3;
+
+enum class Difficulty {
+    EASY,
+    MEDIUM,
+    HARD
+};
+
+enum class PowerUpType {
+    SPEED_BOOST,
+    PADDLE_GROW,
+    PADDLE_SHRINK,
+    MULTI_BALL,
+    SHIELD,
+    FREEZE,
+    LASER,
+    MAGNET
+};
+
+// Vector2D class
+class Vector2D {
+public:
+    float x, y;
+    
+    Vector2D(float x = 0, float y = 0) : x(x), y(y) {}
+    
+    Vector2D operator+(const Vector2D& other) const {
+        return Vector2D(x + other.x, y + other.y);
+    }
+    
+    Vector2D operator-(const Vector2D& other) const {
+        return Vector2D(x - other.x, y - other.y);
+    }
+    
+    Vector2D operator*(float scalar) const {
+        return Vector2D(x * scalar, y * scalar);
+    }
+    
+    float magnitude() const {
+        return std::sqrt(x * x + y * y);
+    }
+    
+    Vector2D normalize() const {
+        float mag = magnitude();
+        if (mag == 0) return Vector2D(0, 0);
+        return Vector2D(x / mag, y / mag);
+    }
+    
+    float dot(const Vector2D& other) const {
+        return x * other.x + y * other.y;
+    }
+};
+
+// Axis-aligned rectangle, top-left corner and size
+struct Rect {
+    float x, y, w, h;
+};
+
+// Same rule as SDL_HasRectIntersectionFloat: touching edges intersect
+inline bool rectsIntersect(const Rect& a, const Rect& b) {
+    if (a.w < 0 || a.h < 0 || b.w < 0 || b.h < 0) return false;
+    float left = std::fmax(a.x, b.x);
+    float right = std::fmin(a.x + a.w, b.x + b.w);
+    float top = std::fmax(a.y, b.y);
+    float bottom = std::fmin(a.y + a.h, b.y + b.h);
+    return right >= left && bottom >= top;
+}
+
+// Paddle controls for one tick
+struct PaddleInput {
+    bool up;
+    bool down;
+    
+    PaddleInput(bool up = false, bool down = false) : up(up), down(down) {}
+};
+
+// PowerUp class
+class PowerUp {
+public:
+    float x, y;
+    PowerUpType powerType;
+    int size;
+    float lifetime;
+    float floatOffset;
+    
+    PowerUp(float x, float y, PowerUpType type)
+        : x(x), y(y), powerType(type), size(30), lifetime(300), floatOffset(0) {}
+    
+    void update(float step);
+    
+    bool isAlive() const {
+        return lifetime > 0;
+    }
+    
+    Rect getRect() const {
+        return {x - size, y - size, (float)(size * 2), (float)(size * 2)};
+    }
+};
+
+// Ball class
+class Ball {
+public:
+    float x, y;
+    float prevX, prevY;     // Position at the start of the last tick
+    Vector2D velocity;
+    int size;
+    float baseSpeed;
+    float speedMultiplier;
+    std::vector<Vector2D> trail;
+    bool isMagnetic;
+    float magneticForce;
+    float trailTimer;
+    uint32_t course;        // Changes whenever its path does other than off a wall
+    
+    // Serves towards a random side at a random angle
+    Ball(float x, float y, Random& rng, float speed = 8.0f);
+    
+    // Records the position once per frame's worth of ticks
+    void updateTrail(float step);
+    
+    // Fraction of motion the ball, a disc, travels before it touches the
+    // top or bottom wall, or the rect; more than 1 if it doesn't. 0 if it
+    // touches already and is moving in.
+    float sweepWalls(const Vector2D& motion) const;
+    float sweep(const Rect& rect, const Vector2D& motion) const;
+    
+    // Responses to touching a wall or a paddle
+    void bounceOffWall();
+    void bounceOffPaddle(const Rect& paddleRect, float paddleCenterY);
+    void resetPosition(Random& rng, int direction = 0);
+    
+    Rect getRect() const {
+        return {x - size, y - size, (float)(size * 2), (float)(size * 2)};
+    }
+};
+
+// How well an AI paddle plays. It acts on a prediction reactionDelay
+// frames after a ball changed course, give or take reactionSpread, and the
+// prediction misses by up to predictionError pixels, small misses being
+// likelier than large ones.
+struct AiSkill {
+    float speedFactor;      // Of the paddle's speed
+    float reactionDelay;
+    float reactionSpread;
+    float predictionError;
+};
+
+// Of the AI at each difficulty
+const AiSkill& aiSkill(Difficulty difficulty);
+
+// When and where a ball on a given course gets to an AI paddle
+struct AiArrival {
+    float time;             // On the paddle's aiClock
+    float y;
+    uint32_t ball;          // Index
+    uint32_t course;        // Of the ball when predicted; stale once it changes
+};
+
+// Paddle class
+class Paddle {
+public:
+    float x, y;
+    float prevY;            // Position at the start of the last tick
+    int width;
+    int baseHeight;
+    int height;
+    float speed;
+    bool isPlayer;
+    std::map<PowerUpType, float> effects;
+    bool shieldActive;
+    float shieldDuration;
+    bool laserActive;
+    float laserDuration;
+    float laserY;
+    float aiTargetY;            // Ball y the AI lines its center up with
+    float aiPendingY;           // Prediction it switches to once it reacts
+    float aiReactionTimer;      // Frames until it reacts; 0 when not waiting
+    uint32_t aiBallsVersion;    // Of the balls it last predicted
+    float aiClock;              // Frames the AI has played, less every rebase
+    std::vector<AiArrival> aiArrivals;  // Heap, soonest on top, of balls heading here
+    int aiThreat;               // Index of the ball it is meeting, -1 for none
+    uint32_t aiThreatCourse;    // Of that ball when it chose it
+    
+    Paddle(float x, float y, bool isPlayer = true)
+        : x(x), y(y), prevY(y), width(15), baseHeight(100), height(baseHeight), speed(8),
+          isPlayer(isPlayer), shieldActive(false), shieldDuration(0),
+          laserActive(false), laserDuration(0), laserY(0), aiTargetY(SCREEN_HEIGHT / 2),
+          aiPendingY(SCREEN_HEIGHT / 2), aiReactionTimer(0), aiBallsVersion(0),
+          aiClock(0), aiThreat(-1), aiThreatCourse(0) {}
+    
+    // Players follow input, the AI follows its prediction. ballsVersion
+    // changes whenever balls come or go; aiTrack() must have been told of
+    // every other course change.
+    void update(float step, const PaddleInput* input, const std::vector<Ball>& balls, uint32_t ballsVersion,
+                const AiSkill& skill, Random& rng);
+    
+    // Meets the ball that gets here first, reacting again whenever that
+    // ball or its course changes. Predicts every ball only when
+    // ballsVersion changed; otherwise a tick costs the same however many
+    // balls are in play.
+    void aiMove(const std::vector<Ball>& balls, uint32_t ballsVersion, const AiSkill& skill, float step,
+                Random& rng);
+    
+    // The ball at index changed course: predicts it alone, in log time
+    void aiTrack(const std::vector<Ball>& balls, size_t index);
+    
+    // Where a ball will reach this paddle's face and in how many frames,
+    // bouncing off the walls on the way; false if it isn't heading here
+    bool predictArrival(const Ball& ball, float& arrivalY, float& frames) const;
+    void applyEffect(PowerUpType effectType, float duration = 300);
+    void removeEffect(PowerUpType effectType);
+    
+    Rect getRect() const {
+        return {x, y, (float)width, (float)height};
+    }
+    
+    float getCenterY() const {
+        return y + height / 2;
+    }
+};
+
+// Something the renderer or a harness may want to react to
+struct MatchEvent {
+    enum Type {
+        PADDLE_HIT,         // At the ball
+        SCORE,              // x is 1 or 2, the player who scored
+        POWER_UP_SPAWNED,   // At the power-up
+        POWER_UP_COLLECTED, // At the power-up
+        GAME_OVER
+    };
+    
+    Type type;
+    float x, y;
+    PowerUpType powerType;
+    
+    MatchEvent(Type type, float x = 0, float y = 0, PowerUpType powerType = PowerUpType::SPEED_BOOST)
+        : type(type), x(x), y(y), powerType(powerType) {}
+};
+
+// One match: the whole gameplay state
+//
+// tick() advances one fixed step; per-frame constants are scaled by step as
+// in the rest of the game. Events of the last tick are left in events.
+// The stages tick() runs are public so callers can time them separately.
+//
+// All randomness comes from rng, seeded by reset(), so a seed and the same
+// inputs tick for tick reproduce a match exactly.
+//
+// Balls are swept through each tick: one that meets a wall or a paddle
+// bounces at the exact time it touches it and goes on with the rest of the
+// tick, so no ball is too fast to hit and a coarser tick rate only costs
+// smoothness.
+//
+// Once there are more than a few balls, power-ups and balls meet through a
+// uniform grid instead of testing every pair. Balls that score and
+// power-ups that get collected are removed after the loop that finds them,
+// with the rest kept in order, so every match plays out exactly as it would
+// with pairwise tests and removal on the spot.
+class Match {
+public:
+    std::vector<Ball> balls;
+    std::vector<PowerUp> powerUps;
+    Paddle paddle1;         // Right paddle (Player 1)
+    Paddle paddle2;         // Left paddle (Player 2/Computer)
+    Difficulty difficulty;  // Of every AI paddle
+    int player1Score;
+    int player2Score;
+    float powerUpTimer;
+    int powerUpSpawnInterval;
+    float freezeTimer;
+    bool over;
+    size_t maxBalls;        // Multi-ball adds none beyond this
+    bool stress;            // Set by startStress()
+    uint32_t ballsVersion;  // Changes when balls come or go or all change course at once
+    
+    // Tuning knobs, left alone by reset() and not kept in recordings: the
+    // serve speed of new balls, and skills AI paddles play with instead of
+    // difficulty's when set
+    float ballSpeed;
+    const AiSkill* paddle1Skill;
+    const AiSkill* paddle2Skill;
+    std::vector<MatchEvent> events;
+    Random rng;             // Gameplay stream
+    
+    Match();
+    
+    // New match; a paddle that isn't human is played by the AI
+    void reset(bool player1Human, bool player2Human, uint64_t seed);
+    
+    // Turns a freshly reset match into a stress test: count small balls
+    // served across the middle that bounce off each other, a ball that
+    // scores is served again, multi-ball doubles the balls up to
+    // MAX_STRESS_BALLS and the match never ends
+    void startStress(size_t count);
+    void tick(float step, const PaddleInput& input1, const PaddleInput& input2);
+    
+    // Stages of tick(), in order
+    void beginTick();
+    bool updateFreeze(float step);      // True while frozen, with everything held still; skip the rest
+    void updatePaddles(float step, const PaddleInput& input1, const PaddleInput& input2);
+    void updateBalls(float step);
+    void updatePowerUps(float step);
+    void checkGameOver();
+    
+    void spawnPowerUp();
+    void applyPowerUp(PowerUpType powerType, size_t ballIndex);
+    
+    // FNV-1a over the whole gameplay state, for checking replays
+    uint64_t checksum() const;
+    
+private:
+    CollisionGrid grid;     // Of the balls; scratch, rebuilt where needed
+    
+    int moveBall(size_t index, float step);
+    void courseChanged(size_t index);
+    void serveStressBall(Ball& ball);
+    void collideBalls();
+    void buildBallGrid(float reach);
+    size_t collectingBall(const Rect& area, size_t gridBalls);
+};
@@ -0,0 +1,271 @@
+// Space Ping Pong - AI tournament
+//
+// Plays AI-vs-AI matches headless on every core, to tune the difficulties
+// and the power-up balance. The right paddle plays a tuned skill, the left
+// one a difficulty; each configuration of a sweep over the tuned paddle's
+// speed factor and prediction error, the power-up spawn interval and the
+// ball speed plays the same number of matches. Match seeds come from one
+// seed and are the same for every configuration, so configurations differ
+// only by their parameters, and results don't depend on the thread count.
+//
+// Reported per configuration: the tuned paddle's win rate, rally length in
+// paddle hits, match length; over all matches, for each power-up, how often
+// the side it was collected on won the next point.
+#include "job_system.h"
+#include "pingpong_sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int POWER_UP_TYPES = (int)PowerUpType::MAGNET + 1;
+
+const char* const POWER_UP_NAMES[POWER_UP_TYPES] = {
+    "SPEED_BOOST", "PADDLE_GROW", "PADDLE_SHRINK", "MULTI_BALL", "SHIELD", "FREEZE", "LASER", "MAGNET"
+};
+
+// Matches a worker plays before taking more
+const size_t MATCH_GRAIN = 16;
+
+struct Configuration {
+    AiSkill skill;              // Of the tuned paddle
+    int powerUpSpawnInterval;
+    float ballSpeed;
+};
+
+// Counts only, so adding them up in any order gives the same result
+struct Totals {
+    long long matches;
+    long long wins;             // By the tuned paddle
+    long long unfinished;       // Stopped at the tick limit
+    long long ticks;
+    long long points;
+    long long hits;
+    long long longestRally;
+    long long collected[POWER_UP_TYPES];
+    long long collectorScored[POWER_UP_TYPES];     // Next point to the side it was collected on
+    
+    Totals() : matches(0), wins(0), unfinished(0), ticks(0), points(0), hits(0), longestRally(0), collected(),
+               collectorScored() {}
+    
+    void add(const Totals& other) {
+        matches += other.matches;
+        wins += other.wins;
+        unfinished += other.unfinished;
+        ticks += other.ticks;
+        points += other.points;
+        hits += other.hits;
+        longestRally = std::max(longestRally, other.longestRally);
+        for (int i = 0; i < POWER_UP_TYPES; i++) {
+            collected[i] += other.collected[i];
+            collectorScored[i] += other.collectorScored[i];
+        }
+    }
+};
+
+struct Collection {
+    int type;
+    int side;                   // 1 or 2, the player whose half it was in
+};
+
+void playMatch(const Configuration& configuration, Difficulty opponent, uint64_t seed, long long maxTicks,
+               Totals& totals) {
+    Match match;
+    match.difficulty = opponent;
+    match.paddle1Skill = &configuration.skill;
+    match.powerUpSpawnInterval = configuration.powerUpSpawnInterval;
+    match.ballSpeed = configuration.ballSpeed;
+    match.reset(false, false, seed);
+    
+    PaddleInput idle;
+    std::vector<Collection> pending;    // Since the last point
+    long long rally = 0;
+    long long ticks = 0;
+    while (!match.over && ticks < maxTicks) {
+        match.tick(1.0f, idle, idle);
+        ticks++;
+        for (const MatchEvent& event : match.events) {
+            if (event.type == MatchEvent::PADDLE_HIT) {
+                rally++;
+                totals.hits++;
+            } else if (event.type == MatchEvent::POWER_UP_COLLECTED && (int)event.powerType < POWER_UP_TYPES) {
+                // Spawning draws one type past the last, which does nothing
+                pending.push_back({(int)event.powerType, event.x > SCREEN_WIDTH / 2 ? 1 : 2});
+            } else if (event.type == MatchEvent::SCORE) {
+                int scorer = (int)event.x;
+                for (const Collection& collection : pending) {
+                    totals.collected[collection.type]++;
+                    totals.collectorScored[collection.type] += collection.side == scorer;
+                }
+                pending.clear();
+                totals.longestRally = std::max(totals.longestRally, rally);
+                rally = 0;
+                totals.points++;
+            }
+        }
+    }
+    
+    totals.matches++;
+    totals.ticks += ticks;
+    if (!match.over) {
+        totals.unfinished++;
+    } else if (match.player1Score > match.player2Score) {
+        totals.wins++;
+    }
+}
+
+bool parseDifficulty(const std::string& text, Difficulty& difficulty) {
+    if (text == "easy") {
+        difficulty = Difficulty::EASY;
+    } else if (text == "medium") {
+        difficulty = Difficulty::MEDIUM;
+    } else if (text == "hard") {
+        difficulty = Difficulty::HARD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Comma-separated numbers
+bool parseList(const std::string& text, std::vector<float>& values) {
+    values.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        char* end = nullptr;
+        float value = std::strtof(item.c_str(), &end);
+        if (item.empty() || *end != '\0') {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    long long matchesPerConfiguration = 1000;
+    long long maxTicks = 10 * 60 * FPS;
+    uint64_t seed = 1;
+    int threads = JobSystem::defaultWorkerCount(256);
+    Difficulty tuned = Difficulty::MEDIUM;
+    Difficulty opponent = Difficulty::MEDIUM;
+    std::vector<float> speedFactors, predictionErrors, spawnIntervals, ballSpeeds;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+        } else if (arg == "--matches") {
+            matchesPerConfiguration = std::atoll(argv[++i]);
+        } else if (arg == "--max-ticks") {
+            maxTicks = std::atoll(argv[++i]);
+        } else if (arg == "--seed") {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--threads") {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--difficulty") {
+            valid = parseDifficulty(argv[++i], tuned);
+        } else if (arg == "--opponent") {
+            valid = parseDifficulty(argv[++i], opponent);
+        } else if (arg == "--speed-factor") {
+            valid = parseList(argv[++i], speedFactors);
+        } else if (arg == "--prediction-error") {
+            valid = parseList(argv[++i], predictionErrors);
+        } else if (arg == "--spawn-interval") {
+            valid = parseList(argv[++i], spawnIntervals);
+        } else if (arg == "--ball-speed") {
+            valid = parseList(argv[++i], ballSpeeds);
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || matchesPerConfiguration <= 0 || maxTicks <= 0 || threads <= 0) {
+        std::cerr << "Usage: pingpong_tournament [--matches N] [--max-ticks N] [--seed N] [--threads N]\n"
+                  << "                           [--difficulty easy|medium|hard] [--opponent easy|medium|hard]\n"
+                  << "                           [--speed-factor LIST] [--prediction-error LIST]\n"
+                  << "                           [--spawn-interval LIST] [--ball-speed LIST]\n"
+                  << "Lists are comma-separated; unswept parameters keep the tuned difficulty's values." << std::endl;
+        return -1;
+    }
+    
+    // Every combination of the swept values
+    const AiSkill& base = aiSkill(tuned);
+    if (speedFactors.empty()) speedFactors.push_back(base.speedFactor);
+    if (predictionErrors.empty()) predictionErrors.push_back(base.predictionError);
+    if (spawnIntervals.empty()) spawnIntervals.push_back((float)Match().powerUpSpawnInterval);
+    if (ballSpeeds.empty()) ballSpeeds.push_back(Match().ballSpeed);
+    std::vector<Configuration> configurations;
+    for (float speedFactor : speedFactors) {
+        for (float predictionError : predictionErrors) {
+            for (float spawnInterval : spawnIntervals) {
+                for (float ballSpeed : ballSpeeds) {
+                    Configuration configuration = {base, std::max(1, (int)spawnInterval), ballSpeed};
+                    configuration.skill.speedFactor = speedFactor;
+                    configuration.skill.predictionError = predictionError;
+                    configurations.push_back(configuration);
+                }
+            }
+        }
+    }
+    
+    std::vector<uint64_t> seeds((size_t)matchesPerConfiguration);
+    Random seedStream(seed, MATCH_SEED_STREAM);
+    for (uint64_t& matchSeed : seeds) {
+        matchSeed = seedStream.next64();
+    }
+    
+    JobSystem jobs(threads);
+    Totals all;
+    auto start = std::chrono::steady_clock::now();
+    for (const Configuration& configuration : configurations) {
+        // One slot per chunk, added up once every chunk is done
+        std::vector<Totals> chunks((seeds.size() + MATCH_GRAIN - 1) / MATCH_GRAIN);
+        jobs.parallelFor(seeds.size(), MATCH_GRAIN, [&](size_t begin, size_t end) {
+            Totals& totals = chunks[begin / MATCH_GRAIN];
+            for (size_t i = begin; i < end; i++) {
+                playMatch(configuration, opponent, seeds[i], maxTicks, totals);
+            }
+        });
+        Totals totals;
+        for (const Totals& chunk : chunks) {
+            totals.add(chunk);
+        }
+        all.add(totals);
+        
+        long long finished = totals.matches - totals.unfinished;
+        std::cout << "speed factor " << configuration.skill.speedFactor
+                  << ", prediction error " << configuration.skill.predictionError
+                  << ", spawn interval " << configuration.powerUpSpawnInterval
+                  << ", ball speed " << configuration.ballSpeed << ": "
+                  << (finished ? 100.0 * totals.wins / finished : 0.0) << "% won, "
+                  << totals.unfinished << " unfinished, "
+                  << (totals.points ? (double)totals.hits / totals.points : 0.0) << " hits per rally (longest "
+                  << totals.longestRally << "), "
+                  << (double)totals.ticks / totals.matches / FPS << " s per match" << std::endl;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::cout << "Next point to the side a power-up was collected on:" << std::endl;
+    for (int i = 0; i < POWER_UP_TYPES; i++) {
+        if (all.collected[i] == 0) {
+            continue;
+        }
+        std::cout << "  " << POWER_UP_NAMES[i] << ": " << 100.0 * all.collectorScored[i] / all.collected[i]
+                  << "% of " << all.collected[i] << std::endl;
+    }
+    
+    double ticksPerSecond = all.ticks / seconds;
+    std::cout << all.matches << " matches, " << all.ticks << " ticks in " << seconds << " s on "
+              << jobs.getWorkerCount() << " threads: " << (long long)ticksPerSecond << " ticks/s, "
+              << (long long)(ticksPerSecond / jobs.getWorkerCount()) << " per thread" << std::endl;
+    return 0;
+}
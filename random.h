@@ -0,0 +1,79 @@
+// Space Ping Pong - seedable random numbers
+//
+// PCG32 (64-bit LCG state, xorshift-and-rotate output). The same seed always
+// gives the same sequence on every platform, unlike std::random_device or the
+// std distributions. Each stream id selects an independent sequence for a
+// seed: gameplay draws from its own stream, so cosmetic effects like
+// particles and screen shake can never change how a match plays out.
+#pragma once
+
+#include <cstdint>
+
+// Streams of one seed
+const uint64_t GAMEPLAY_STREAM = 1;     // Match state: serves, AI error, power-ups
+const uint64_t COSMETIC_STREAM = 2;     // Stars, menu particles, screen shake
+const uint64_t PARTICLE_STREAM = 3;     // Particle burst directions and sizes
+const uint64_t MATCH_SEED_STREAM = 4;   // Seeds of successive matches
+const uint64_t NETWORK_STREAM = 5;      // Simulated packet loss and jitter
+
+class Random {
+public:
+    explicit Random(uint64_t seed = 0, uint64_t stream = GAMEPLAY_STREAM) {
+        reseed(seed, stream);
+    }
+    
+    void reseed(uint64_t seed, uint64_t stream) {
+        state = 0;
+        increment = (stream << 1) | 1;
+        next();
+        state += seed;
+        next();
+    }
+    
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + increment;
+        uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rotation = (uint32_t)(old >> 59);
+        return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+    }
+    
+    uint64_t next64() {
+        uint64_t high = next();
+        return (high << 32) | next();
+    }
+    
+    // Uniform in [0, 1)
+    float nextFloat() {
+        return (next() >> 8) * (1.0f / 16777216.0f);
+    }
+    
+    // Uniform in [low, high)
+    float uniform(float low, float high) {
+        return low + (high - low) * nextFloat();
+    }
+    
+    // Uniform integer in [low, high]
+    int range(int low, int high) {
+        uint64_t span = (uint64_t)((int64_t)high - low + 1);
+        return (int)(low + (int64_t)((next() * span) >> 32));
+    }
+    
+    // Raw generator state, for saving a match part way through
+    uint64_t getState() const {
+        return state;
+    }
+    
+    uint64_t getIncrement() const {
+        return increment;
+    }
+    
+    void restore(uint64_t savedState, uint64_t savedIncrement) {
+        state = savedState;
+        increment = savedIncrement | 1;
+    }
+    
+private:
+    uint64_t state;
+    uint64_t increment;
+};
@@ -0,0 +1,216 @@
+// Space Ping Pong - rendering primitive microbenchmark
+//
+// Draws each primitive into an offscreen software renderer (an SDL_Surface
+// behind SDL_CreateSoftwareRenderer), so the numbers include SDL's command
+// queue and rasterization but no GPU or driver. Every call is flushed through
+// the batch and the renderer on its own, the worst case of a frame where
+// each primitive has its own color.
+//
+// For each case it reports the time per call, the SDL draw calls the batch
+// submitted per call and the pixels one call actually changes on a cleared
+// surface. --json writes the same table in a stable order for diffing across
+// commits.
+#include "render_primitives.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int SURFACE_WIDTH = 1200;
+const int SURFACE_HEIGHT = 800;
+
+struct BenchCase {
+    std::string primitive;
+    std::string variant;
+    std::function<void(PrimitiveBatch&)> draw;
+};
+
+struct BenchResult {
+    long long iterations;
+    double nsPerCall;
+    double rendererCalls;   // SDL draw calls per primitive call
+    int legacyCalls;        // Per-pixel calls the original helpers made
+    int pixels;             // Pixels changed by one call
+};
+
+std::vector<BenchCase> makeCases() {
+    std::vector<BenchCase> cases;
+    const int cx = SURFACE_WIDTH / 2;
+    const int cy = SURFACE_HEIGHT / 2;
+    
+    for (int radius : {2, 4, 8, 16, 32, 64, 128}) {
+        cases.push_back({"drawFilledCircle", "r=" + std::to_string(radius),
+                         [=](PrimitiveBatch& batch) { drawFilledCircle(batch, cx, cy, radius); }});
+    }
+    for (int radius : {2, 4, 8, 16, 32, 64, 128}) {
+        cases.push_back({"drawCircle", "r=" + std::to_string(radius),
+                         [=](PrimitiveBatch& batch) { drawCircle(batch, cx, cy, radius); }});
+    }
+    for (int length : {8, 64, 512}) {
+        std::string suffix = std::to_string(length);
+        cases.push_back({"drawLine", "horizontal/" + suffix,
+                         [=](PrimitiveBatch& batch) { drawLine(batch, cx - length / 2, cy, cx + length / 2, cy); }});
+        cases.push_back({"drawLine", "diagonal/" + suffix,
+                         [=](PrimitiveBatch& batch) { drawLine(batch, cx - length / 2, cy - length / 2, cx + length / 2, cy + length / 2); }});
+        cases.push_back({"drawLine", "shallow/" + suffix,
+                         [=](PrimitiveBatch& batch) { drawLine(batch, cx - length / 2, cy - length / 6, cx + length / 2, cy + length / 6); }});
+    }
+    for (int size : {1, 2, 4, 8, 16}) {
+        cases.push_back({"drawChar", "W/size=" + std::to_string(size),
+                         [=](PrimitiveBatch& batch) { drawChar(batch, 'W', cx, cy, size, WHITE); }});
+    }
+    const std::string sample = "SPACE PING PONG 0123456789 HIGH SCORES: PRESS SPACE TO START";
+    for (size_t length : {1, 8, 32}) {
+        for (int size : {2, 4}) {
+            std::string text = sample.substr(0, length);
+            cases.push_back({"drawText", "len=" + std::to_string(length) + "/size=" + std::to_string(size),
+                             [=](PrimitiveBatch& batch) { drawText(batch, text, 10, cy, size, WHITE); }});
+        }
+    }
+    return cases;
+}
+
+void submit(SDL_Renderer* renderer, PrimitiveBatch& batch, const BenchCase& benchCase) {
+    benchCase.draw(batch);
+    batch.flush();
+    SDL_FlushRenderer(renderer);
+}
+
+// Pixels that differ from the cleared background in the top-left corner
+int countPixels(SDL_Surface* surface) {
+    const Uint32 background = *(const Uint32*)surface->pixels;
+    int pixels = 0;
+    for (int y = 0; y < surface->h; y++) {
+        const Uint32* row = (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+        for (int x = 0; x < surface->w; x++) {
+            if (row[x] != background) pixels++;
+        }
+    }
+    return pixels;
+}
+
+BenchResult run(SDL_Renderer* renderer, SDL_Surface* surface, const BenchCase& benchCase, double minSeconds) {
+    PrimitiveBatch batch;
+    batch.setRenderer(renderer);
+    batch.setColor(WHITE);
+    BenchResult result;
+    
+    // One call on a cleared surface for the pixel and call counts
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    SDL_FlushRenderer(renderer);
+    submit(renderer, batch, benchCase);
+    result.pixels = countPixels(surface);
+    result.legacyCalls = batch.getStats().legacyCalls;
+    
+    // Grow the batch of timed calls until it runs long enough to trust
+    long long iterations = 16;
+    while (true) {
+        batch.resetStats();
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; i++) {
+            submit(renderer, batch, benchCase);
+        }
+        auto end = std::chrono::steady_clock::now();
+        
+        double seconds = std::chrono::duration<double>(end - start).count();
+        if (seconds >= minSeconds || iterations >= (1ll << 30)) {
+            result.iterations = iterations;
+            result.nsPerCall = seconds * 1e9 / iterations;
+            result.rendererCalls = (double)batch.getStats().drawCalls / iterations;
+            return result;
+        }
+        iterations *= 2;
+    }
+}
+
+bool writeJson(const std::string& path, const std::vector<BenchCase>& cases, const std::vector<BenchResult>& results) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    std::fprintf(file, "{\n  \"benchmark\": \"render_bench\",\n  \"renderer\": \"software\",\n");
+    std::fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n  \"results\": [\n", SURFACE_WIDTH, SURFACE_HEIGHT);
+    for (size_t i = 0; i < cases.size(); i++) {
+        const BenchResult& result = results[i];
+        std::fprintf(file, "    {\"primitive\": \"%s\", \"variant\": \"%s\", \"iterations\": %lld, "
+                     "\"ns_per_call\": %.1f, \"renderer_calls_per_call\": %.2f, \"legacy_calls\": %d, \"pixels\": %d}%s\n",
+                     cases[i].primitive.c_str(), cases[i].variant.c_str(), result.iterations,
+                     result.nsPerCall, result.rendererCalls, result.legacyCalls, result.pixels,
+                     i + 1 < cases.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    std::fclose(file);
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    double minSeconds = 0.2;
+    std::string jsonPath;
+    std::string only;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--min-ms" && i + 1 < argc) {
+            minSeconds = std::atof(argv[++i]) / 1000.0;
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--primitive" && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            std::cerr << "Usage: render_bench [--min-ms MS] [--primitive NAME] [--json FILE]" << std::endl;
+            return -1;
+        }
+    }
+    
+    std::vector<BenchCase> cases;
+    for (const BenchCase& benchCase : makeCases()) {
+        if (only.empty() || benchCase.primitive == only) {
+            cases.push_back(benchCase);
+        }
+    }
+    if (cases.empty()) {
+        std::cerr << "Unknown primitive: " << only << std::endl;
+        return -1;
+    }
+    
+    SDL_Surface* surface = SDL_CreateSurface(SURFACE_WIDTH, SURFACE_HEIGHT, SDL_PIXELFORMAT_XRGB8888);
+    if (!surface) {
+        std::cerr << "Surface creation failed: " << SDL_GetError() << std::endl;
+        return -1;
+    }
+    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(surface);
+    if (!renderer) {
+        std::cerr << "Software renderer creation failed: " << SDL_GetError() << std::endl;
+        SDL_DestroySurface(surface);
+        return -1;
+    }
+    
+    std::vector<BenchResult> results;
+    for (const BenchCase& benchCase : cases) {
+        BenchResult result = run(renderer, surface, benchCase, minSeconds);
+        results.push_back(result);
+        std::printf("%-18s %-22s %10.1f ns/call %6.2f renderer calls %7d pixels %7d legacy calls\n",
+                    benchCase.primitive.c_str(), benchCase.variant.c_str(), result.nsPerCall,
+                    result.rendererCalls, result.pixels, result.legacyCalls);
+    }
+    
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroySurface(surface);
+    
+    if (!jsonPath.empty()) {
+        if (!writeJson(jsonPath, cases, results)) {
+            std::cerr << "Failed to write " << jsonPath << std::endl;
+            return -1;
+        }
+        std::cout << "Wrote " << jsonPath << std::endl;
+    }
+    return 0;
+}
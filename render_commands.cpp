@@ -0,0 +1,242 @@
+// Space Ping Pong - sorted render command buffer
+#include "render_commands.h"
+
+#include <algorithm>
+
+namespace {
+
+const int LAYER_SHIFT = 44;
+const int BLEND_SHIFT = 40;
+const int TYPE_SHIFT = 36;
+
+// Key bits below the layer: commands that agree on them draw in one call
+const Uint64 STATE_MASK = ((Uint64)1 << LAYER_SHIFT) - 1;
+
+Uint64 blendIndex(SDL_BlendMode mode) {
+    switch (mode) {
+        case SDL_BLENDMODE_NONE: return 0;
+        case SDL_BLENDMODE_BLEND: return 1;
+        case SDL_BLENDMODE_BLEND_PREMULTIPLIED: return 2;
+        case SDL_BLENDMODE_ADD: return 3;
+        case SDL_BLENDMODE_ADD_PREMULTIPLIED: return 4;
+        case SDL_BLENDMODE_MOD: return 5;
+        case SDL_BLENDMODE_MUL: return 6;
+    }
+    return 7;
+}
+
+bool isTextured(CommandType type) {
+    return type == CommandType::GEOMETRY || type == CommandType::TEXT;
+}
+
+// Data of the commands [begin, end), which share a type. A single command's
+// data is used in place; a merged run is copied together into scratch.
+template <typename T>
+const T* gather(const std::vector<RenderCommand>& commands, size_t begin, size_t end, const std::vector<T>& source,
+                size_t perItem, std::vector<T>& scratch, int& count) {
+    if (end - begin == 1) {
+        count = (int)(commands[begin].count * perItem);
+        return source.data() + commands[begin].first * perItem;
+    }
+    scratch.clear();
+    for (size_t i = begin; i < end; i++) {
+        const T* first = source.data() + commands[i].first * perItem;
+        scratch.insert(scratch.end(), first, first + commands[i].count * perItem);
+    }
+    count = (int)scratch.size();
+    return scratch.data();
+}
+
+}
+
+CommandBuffer::CommandBuffer() : layer(RenderLayer::BACKGROUND), blendMode(SDL_BLENDMODE_BLEND), primitives(0) {}
+
+void CommandBuffer::clear() {
+    layer = RenderLayer::BACKGROUND;
+    blendMode = SDL_BLENDMODE_BLEND;
+    color = Color();
+    primitives = 0;
+    commands.clear();
+    rects.clear();
+    points.clear();
+    vertices.clear();
+    textures.clear();
+}
+
+Uint64 CommandBuffer::makeKey(CommandType type, Uint32 state) const {
+    return (Uint64)layer << LAYER_SHIFT | blendIndex(blendMode) << BLEND_SHIFT | (Uint64)type << TYPE_SHIFT | state;
+}
+
+SDL_Vertex* CommandBuffer::reserveQuads(SDL_Texture* texture, int count, CommandType type) {
+    size_t slot = std::find(textures.begin(), textures.end(), texture) - textures.begin();
+    if (slot == textures.size()) {
+        textures.push_back(texture);
+    }
+    
+    size_t first = vertices.size();
+    record(type, (Uint32)slot, texture, first / 4).count += count;
+    vertices.resize(first + count * 4);
+    return vertices.data() + first;
+}
+
+void CommandBuffer::submit(SDL_Renderer* renderer) {
+    stats.commands = (int)commands.size();
+    stats.primitives = primitives;
+    replay(nullptr, stats.unsortedDrawCalls, stats.unsortedStateChanges);
+    
+    // Stable, so commands of one state keep their recorded order
+    std::stable_sort(commands.begin(), commands.end(), [](const RenderCommand& a, const RenderCommand& b) {
+        return a.key < b.key;
+    });
+    replay(renderer, stats.drawCalls, stats.stateChanges);
+}
+
+void CommandBuffer::replay(SDL_Renderer* renderer, int& drawCalls, int& stateChanges) {
+    drawCalls = 0;
+    stateChanges = 0;
+    
+    // Nothing is assumed about the renderer's state at the start of a frame
+    bool hasDrawState = false;
+    SDL_BlendMode drawBlendMode = SDL_BLENDMODE_NONE;
+    Color drawColor;
+    SDL_Texture* boundTexture = nullptr;
+    textureBlendModes.assign(textures.size(), SDL_BLENDMODE_INVALID);
+    
+    size_t begin = 0;
+    while (begin < commands.size()) {
+        const RenderCommand& head = commands[begin];
+        size_t end = begin + 1;
+        while (end < commands.size() && (commands[end].key & STATE_MASK) == (head.key & STATE_MASK)) {
+            end++;
+        }
+        
+        if (isTextured(head.type)) {
+            SDL_BlendMode& current = textureBlendModes[head.key & 0xffffffff];
+            if (current == SDL_BLENDMODE_INVALID) {
+                SDL_GetTextureBlendMode(head.texture, &current);
+            }
+            if (current != head.blendMode) {
+                if (renderer) SDL_SetTextureBlendMode(head.texture, head.blendMode);
+                current = head.blendMode;
+                stateChanges++;
+            }
+            if (head.texture != boundTexture) {
+                boundTexture = head.texture;
+                stateChanges++;
+            }
+        } else {
+            if (!hasDrawState || drawBlendMode != head.blendMode) {
+                if (renderer) SDL_SetRenderDrawBlendMode(renderer, head.blendMode);
+                drawBlendMode = head.blendMode;
+                stateChanges++;
+            }
+            const Color& c = head.color;
+            if (!hasDrawState || drawColor.r != c.r || drawColor.g != c.g || drawColor.b != c.b || drawColor.a != c.a) {
+                if (renderer) SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+                drawColor = c;
+                stateChanges++;
+            }
+            hasDrawState = true;
+        }
+        
+        if (renderer) {
+            draw(renderer, begin, end);
+        }
+        drawCalls++;
+        begin = end;
+    }
+}
+
+void CommandBuffer::draw(SDL_Renderer* renderer, size_t begin, size_t end) {
+    const RenderCommand& head = commands[begin];
+    int count = 0;
+    switch (head.type) {
+        case CommandType::FILL_RECTS: {
+            const SDL_FRect* data = gather(commands, begin, end, rects, 1, rectScratch, count);
+            SDL_RenderFillRects(renderer, data, count);
+            break;
+        }
+        case CommandType::RECTS: {
+            const SDL_FRect* data = gather(commands, begin, end, rects, 1, rectScratch, count);
+            SDL_RenderRects(renderer, data, count);
+            break;
+        }
+        case CommandType::POINTS: {
+            const SDL_FPoint* data = gather(commands, begin, end, points, 1, pointScratch, count);
+            SDL_RenderPoints(renderer, data, count);
+            break;
+        }
+        case CommandType::GEOMETRY:
+        case CommandType::TEXT: {
+            const SDL_Vertex* data = gather(commands, begin, end, vertices, 4, vertexScratch, count);
+            
+            // Two triangles per quad; the index pattern is shared by every call
+            size_t needed = (size_t)count / 4 * 6;
+            for (size_t quad = quadIndices.size() / 6; quadIndices.size() < needed; quad++) {
+                const int corners[6] = {0, 1, 2, 0, 2, 3};
+                for (int corner : corners) {
+                    quadIndices.push_back((int)quad * 4 + corner);
+                }
+            }
+            SDL_RenderGeometry(renderer, head.texture, data, count, quadIndices.data(), (int)needed);
+            break;
+        }
+    }
+}
+
+bool CachedLayer::create(SDL_Renderer* renderer, int w, int h) {
+    destroy();
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, w, h);
+    if (!texture) {
+        return false;
+    }
+    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+    width = w;
+    height = h;
+    dirty = true;
+    return true;
+}
+
+void CachedLayer::destroy() {
+    if (texture) {
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+    }
+    dirty = true;
+}
+
+bool CachedLayer::begin(SDL_Renderer* renderer) {
+    if (!texture || !SDL_SetRenderTarget(renderer, texture)) {
+        return false;
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    return true;
+}
+
+void CachedLayer::end(SDL_Renderer* renderer, Uint64 contentVersion) {
+    SDL_SetRenderTarget(renderer, nullptr);
+    version = contentVersion;
+    dirty = false;
+}
+
+void CachedLayer::blit(CommandBuffer& commands, const SDL_FRect& source, float x, float y, const SDL_FColor& tint,
+                       SDL_BlendMode mode) const {
+    if (!texture) {
+        return;
+    }
+    
+    SDL_BlendMode previous = commands.getBlendMode();
+    commands.setBlendMode(mode);
+    SDL_Vertex* quad = commands.reserveQuads(texture, 1);
+    commands.setBlendMode(previous);
+    
+    float u0 = source.x / width;
+    float v0 = source.y / height;
+    float u1 = (source.x + source.w) / width;
+    float v1 = (source.y + source.h) / height;
+    quad[0] = {{x, y}, tint, {u0, v0}};
+    quad[1] = {{x + source.w, y}, tint, {u1, v0}};
+    quad[2] = {{x + source.w, y + source.h}, tint, {u1, v1}};
+    quad[3] = {{x, y + source.h}, tint, {u0, v1}};
+}
@@ -0,0 +1,231 @@
+// Space Ping Pong - sorted render command buffer
+//
+// A frame is recorded as typed commands - filled rects, outlined rects,
+// points, and textured quads for sprites or text - each tagged with a layer,
+// a blend mode and its color or texture. submit() sorts them by layer and
+// then by state, merges neighbours that share a state and sends each merged
+// run to SDL with one call, setting the draw color, blend mode and texture
+// blend mode only when they change.
+//
+// CachedLayer keeps content that rarely changes in a render target, so it
+// costs one textured quad per frame until it is invalidated.
+//
+// Layers draw in order. Within a layer commands are grouped by blend mode,
+// type and state, so anything that has to cover something else goes in a
+// later layer; commands with the same state keep their recorded order.
+// Untextured primitives blend by default, so their alpha is honoured.
+#pragma once
+
+#include "render_primitives.h"
+
+#include <SDL3/SDL.h>
+
+#include <vector>
+
+enum class RenderLayer : Uint8 {
+    BACKGROUND,     // Stars
+    BACKDROP,       // Menu gradient, center line
+    WORLD,          // Paddles, balls, power-ups
+    PARTICLES,
+    HUD,            // Scores, menu and high score text
+    OVERLAY,        // Dimming and tints over everything above
+    OVERLAY_TEXT,   // Text on the overlays
+    DEBUG,          // Stats and profiler
+    COUNT
+};
+
+enum class CommandType : Uint8 {
+    FILL_RECTS,
+    RECTS,          // Outlines
+    POINTS,
+    GEOMETRY,       // Textured quads
+    TEXT            // Textured quads of glyphs
+};
+
+struct RenderCommand {
+    Uint64 key;             // Layer, blend mode, type and state: the sort order
+    CommandType type;
+    SDL_BlendMode blendMode;
+    Color color;            // Of untextured commands
+    SDL_Texture* texture;   // Of textured commands
+    Uint32 first;           // Into the rects, points or vertices
+    Uint32 count;           // Rects, points or quads
+};
+
+// Cost of the last submitted frame
+struct CommandStats {
+    int commands;               // After merging neighbours while recording
+    int primitives;             // Rects and points recorded
+    int drawCalls;
+    int stateChanges;           // Draw color, draw blend mode, texture or texture blend mode
+    int unsortedDrawCalls;      // The same frame submitted in recorded order
+    int unsortedStateChanges;
+    
+    CommandStats() : commands(0), primitives(0), drawCalls(0), stateChanges(0), unsortedDrawCalls(0),
+                     unsortedStateChanges(0) {}
+};
+
+class CommandBuffer {
+public:
+    CommandBuffer();
+    
+    // Drops everything recorded and goes back to the first layer, blending
+    void clear();
+    
+    void setLayer(RenderLayer value) {
+        layer = value;
+    }
+    
+    RenderLayer getLayer() const {
+        return layer;
+    }
+    
+    // For commands recorded from now on
+    void setBlendMode(SDL_BlendMode mode) {
+        blendMode = mode;
+    }
+    
+    SDL_BlendMode getBlendMode() const {
+        return blendMode;
+    }
+    
+    void setColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        color = Color(r, g, b, a);
+    }
+    
+    void setColor(const Color& c) {
+        color = c;
+    }
+    
+    void point(int x, int y) {
+        record(CommandType::POINTS, packColor(), nullptr, points.size()).count++;
+        points.push_back({(float)x, (float)y});
+        primitives++;
+    }
+    
+    void fillRect(const SDL_FRect& area) {
+        record(CommandType::FILL_RECTS, packColor(), nullptr, rects.size()).count++;
+        rects.push_back(area);
+        primitives++;
+    }
+    
+    void rect(const SDL_FRect& outline) {
+        record(CommandType::RECTS, packColor(), nullptr, rects.size()).count++;
+        rects.push_back(outline);
+        primitives++;
+    }
+    
+    // Appends count quads of one texture and returns their vertices for the
+    // caller to fill. Worker threads may fill disjoint parts without locking;
+    // the pointer is valid until the next call that records anything.
+    SDL_Vertex* reserveQuads(SDL_Texture* texture, int count, CommandType type = CommandType::GEOMETRY);
+    
+    // Sorts, merges and draws everything recorded
+    void submit(SDL_Renderer* renderer);
+    
+    const CommandStats& getStats() const {
+        return stats;
+    }
+    
+private:
+    RenderLayer layer;
+    SDL_BlendMode blendMode;
+    Color color;
+    int primitives;
+    std::vector<RenderCommand> commands;
+    std::vector<SDL_FRect> rects;
+    std::vector<SDL_FPoint> points;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<SDL_Texture*> textures;     // Used this frame; the state of textured commands
+    CommandStats stats;
+    
+    // Reused by submit()
+    std::vector<SDL_BlendMode> textureBlendModes;
+    std::vector<SDL_FRect> rectScratch;
+    std::vector<SDL_FPoint> pointScratch;
+    std::vector<SDL_Vertex> vertexScratch;
+    std::vector<int> quadIndices;
+    
+    Uint32 packColor() const {
+        return (Uint32)color.r << 24 | (Uint32)color.g << 16 | (Uint32)color.b << 8 | color.a;
+    }
+    
+    Uint64 makeKey(CommandType type, Uint32 state) const;
+    
+    // The command new data of this type and state goes into: the last one if
+    // it matches, else a new one starting at first
+    RenderCommand& record(CommandType type, Uint32 state, SDL_Texture* texture, size_t first) {
+        Uint64 key = makeKey(type, state);
+        if (commands.empty() || commands.back().key != key) {
+            RenderCommand command;
+            command.key = key;
+            command.type = type;
+            command.blendMode = blendMode;
+            command.color = color;
+            command.texture = texture;
+            command.first = (Uint32)first;
+            command.count = 0;
+            commands.push_back(command);
+        }
+        return commands.back();
+    }
+    
+    // Walks the commands in their current order, merging neighbours, and
+    // counts what it costs; with a renderer it also draws them
+    void replay(SDL_Renderer* renderer, int& drawCalls, int& stateChanges);
+    void draw(SDL_Renderer* renderer, size_t begin, size_t end);
+};
+
+// Retained layer
+//
+// A render target drawn into once and then blitted as a single quad every
+// frame. The owner redraws it whenever isStale() says so: after an explicit
+// invalidate(), when the version of its content changed, or before it was
+// ever drawn. Blending into the cleared, transparent target leaves
+// premultiplied color, so blits blend it as premultiplied.
+class CachedLayer {
+public:
+    CachedLayer() : texture(nullptr), width(0), height(0), version(0), dirty(true) {}
+    
+    ~CachedLayer() {
+        destroy();
+    }
+    
+    CachedLayer(const CachedLayer&) = delete;
+    CachedLayer& operator=(const CachedLayer&) = delete;
+    
+    bool create(SDL_Renderer* renderer, int w, int h);
+    void destroy();
+    
+    // Render targets lost their content, the window changed, ...
+    void invalidate() {
+        dirty = true;
+    }
+    
+    bool isStale(Uint64 contentVersion) const {
+        return dirty || contentVersion != version;
+    }
+    
+    // Points the renderer at the layer and clears it to transparent; submit
+    // the layer's commands, then call end()
+    bool begin(SDL_Renderer* renderer);
+    
+    // Back to the window; the layer now holds that version of its content
+    void end(SDL_Renderer* renderer, Uint64 contentVersion);
+    
+    // Queues the source part of the layer with its top-left corner at (x, y).
+    // The tint's color multiplies the texels, so gray darkens the layer.
+    void blit(CommandBuffer& commands, const SDL_FRect& source, float x, float y, const SDL_FColor& tint,
+              SDL_BlendMode mode = SDL_BLENDMODE_BLEND_PREMULTIPLIED) const;
+    
+    // The whole layer, untinted
+    void blit(CommandBuffer& commands, float x = 0, float y = 0) const {
+        blit(commands, {0, 0, (float)width, (float)height}, x, y, {1, 1, 1, 1});
+    }
+    
+private:
+    SDL_Texture* texture;
+    int width, height;
+    Uint64 version;
+    bool dirty;
+};
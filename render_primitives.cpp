@@ -0,0 +1,158 @@
+// Space Ping Pong - immediate-mode drawing primitives
+#include "render_primitives.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+const std::vector<int>& circleSpans(int radius) {
+    static std::vector<std::vector<int>> tables;
+    if (radius >= (int)tables.size()) {
+        tables.resize(radius + 1);
+    }
+    
+    std::vector<int>& spans = tables[radius];
+    if (spans.empty()) {
+        for (int dy = -radius; dy <= radius; dy++) {
+            int w = 0;
+            while ((w + 1) * (w + 1) + dy * dy <= radius * radius) {
+                w++;
+            }
+            spans.push_back(w);
+        }
+    }
+    return spans;
+}
+
+const std::vector<CircleOffset>& circleOutline(int radius) {
+    static std::vector<std::vector<CircleOffset>> tables;
+    if (radius >= (int)tables.size()) {
+        tables.resize(radius + 1);
+    }
+    
+    std::vector<CircleOffset>& offsets = tables[radius];
+    if (offsets.empty()) {
+        for (int i = 0; i < 360; i++) {
+            float angle = i * M_PI / 180.0f;
+            double ox = radius * cos(angle);
+            double oy = radius * sin(angle);
+            CircleOffset offset = {(int)std::floor(ox), (int)std::floor(oy),
+                                   ox != std::floor(ox), oy != std::floor(oy)};
+            
+            bool duplicate = false;
+            for (const auto& existing : offsets) {
+                if (existing.dx == offset.dx && existing.dy == offset.dy &&
+                    existing.fracX == offset.fracX && existing.fracY == offset.fracY) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) {
+                offsets.push_back(offset);
+            }
+        }
+    }
+    return offsets;
+}
+
+void drawCircle(PrimitiveBatch& batch, int x, int y, int radius) {
+    for (const auto& offset : circleOutline(radius)) {
+        int px = x + offset.dx;
+        int py = y + offset.dy;
+        if (px < 0 && offset.fracX) px++;
+        if (py < 0 && offset.fracY) py++;
+        batch.point(px, py);
+    }
+}
+
+void drawFilledCircle(PrimitiveBatch& batch, int x, int y, int radius) {
+    const std::vector<int>& spans = circleSpans(radius);
+    for (int dy = -radius; dy <= radius; dy++) {
+        int w = spans[dy + radius];
+        batch.span(x - w, x + w, y + dy);
+    }
+}
+
+void drawLine(PrimitiveBatch& batch, int x1, int y1, int x2, int y2) {
+    // Axis-aligned lines are a single one-pixel-wide rect
+    if (x1 == x2 || y1 == y2) {
+        int w = abs(x2 - x1) + 1;
+        int h = abs(y2 - y1) + 1;
+        batch.fillRect({(float)std::min(x1, x2), (float)std::min(y1, y2), (float)w, (float)h}, w * h);
+        return;
+    }
+    
+    rasterizeLine(x1, y1, x2, y2, [&](int px, int py) { batch.point(px, py); });
+}
+
+const std::vector<GlyphStroke>& glyphStrokes(char c) {
+    static std::vector<std::vector<GlyphStroke>> table;
+    if (table.empty()) {
+        table.resize(256);
+        table['A'] = {{0, 6, 2, 0}, {2, 0, 4, 6}, {1, 3, 3, 3}};
+        table['B'] = {{0, 0, 0, 6}, {0, 0, 3, 0}, {0, 3, 3, 3}, {0, 6, 3, 6}, {3, 0, 3, 3}, {3, 3, 3, 6}};
+        table['C'] = {{3, 0, 0, 0}, {0, 0, 0, 6}, {0, 6, 3, 6}};
+        table['D'] = {{0, 0, 0, 6}, {0, 0, 2, 0}, {0, 6, 2, 6}, {3, 1, 3, 5}, {2, 0, 3, 1}, {2, 6, 3, 5}};
+        table['E'] = {{0, 0, 0, 6}, {0, 0, 3, 0}, {0, 3, 2, 3}, {0, 6, 3, 6}};
+        table['F'] = {{0, 0, 0, 6}, {0, 0, 3, 0}, {0, 3, 2, 3}};
+        table['G'] = {{3, 0, 0, 0}, {0, 0, 0, 6}, {0, 6, 3, 6}, {3, 3, 3, 6}, {2, 3, 3, 3}};
+        table['H'] = {{0, 0, 0, 6}, {3, 0, 3, 6}, {0, 3, 3, 3}};
+        table['I'] = {{1, 0, 2, 0}, {1, 6, 2, 6}, {1, 0, 1, 6}};
+        table['J'] = {{2, 0, 3, 0}, {3, 0, 3, 5}, {3, 5, 0, 6}, {0, 6, 0, 5}};
+        table['K'] = {{0, 0, 0, 6}, {0, 3, 3, 0}, {0, 3, 3, 6}};
+        table['L'] = {{0, 0, 0, 6}, {0, 6, 3, 6}};
+        table['M'] = {{0, 6, 0, 0}, {0, 0, 2, 3}, {2, 3, 4, 0}, {4, 0, 4, 6}};
+        table['N'] = {{0, 6, 0, 0}, {0, 0, 3, 6}, {3, 6, 3, 0}};
+        table['O'] = {{3, 0, 0, 0}, {0, 0, 0, 6}, {0, 6, 3, 6}, {3, 6, 3, 0}};
+        table['P'] = {{0, 6, 0, 0}, {0, 0, 3, 0}, {3, 0, 3, 3}, {3, 3, 0, 3}};
+        table['Q'] = {{3, 0, 0, 0}, {0, 0, 0, 6}, {0, 6, 3, 6}, {3, 6, 3, 0}, {2, 4, 4, 6}};
+        table['R'] = {{0, 6, 0, 0}, {0, 0, 3, 0}, {3, 0, 3, 3}, {3, 3, 0, 3}, {2, 3, 3, 6}};
+        table['S'] = {{3, 0, 0, 0}, {0, 0, 0, 3}, {0, 3, 3, 3}, {3, 3, 3, 6}, {3, 6, 0, 6}};
+        table['T'] = {{1, 0, 2, 0}, {1, 0, 1, 6}};
+        table['U'] = {{0, 0, 0, 6}, {3, 0, 3, 6}, {0, 6, 3, 6}};
+        table['V'] = {{0, 0, 1, 6}, {1, 6, 2, 0}, {2, 0, 3, 6}};
+        table['W'] = {{0, 0, 0, 6}, {1, 6, 2, 3}, {2, 3, 3, 6}, {4, 0, 4, 6}};
+        table['X'] = {{0, 0, 3, 6}, {3, 0, 0, 6}};
+        table['Y'] = {{0, 0, 1, 3}, {1, 3, 2, 3}, {2, 3, 3, 0}, {1, 3, 1, 6}};
+        table['Z'] = {{0, 0, 3, 0}, {3, 0, 0, 6}, {0, 6, 3, 6}};
+        table['0'] = {{3, 0, 0, 0}, {0, 0, 0, 6}, {0, 6, 3, 6}, {3, 6, 3, 0}, {3, 0, 0, 6}};
+        table['1'] = {{1, 0, 2, 0}, {1, 0, 1, 6}, {0, 6, 3, 6}};
+        table['2'] = {{0, 0, 3, 0}, {3, 0, 3, 3}, {3, 3, 0, 3}, {0, 3, 0, 6}, {0, 6, 3, 6}};
+        table['3'] = {{0, 0, 3, 0}, {3, 0, 3, 6}, {3, 6, 0, 6}, {0, 3, 2, 3}};
+        table['4'] = {{0, 0, 0, 3}, {0, 3, 3, 3}, {3, 0, 3, 6}};
+        table['5'] = {{3, 0, 0, 0}, {0, 0, 0, 3}, {0, 3, 3, 3}, {3, 3, 3, 6}, {3, 6, 0, 6}};
+        table['6'] = {{3, 0, 0, 0}, {0, 0, 0, 6}, {0, 6, 3, 6}, {3, 6, 3, 3}, {3, 3, 0, 3}};
+        table['7'] = {{0, 0, 3, 0}, {3, 0, 3, 6}};
+        table['8'] = {{3, 0, 0, 0}, {0, 0, 0, 6}, {0, 6, 3, 6}, {3, 6, 3, 0}, {0, 3, 3, 3}};
+        table['9'] = {{3, 0, 0, 0}, {3, 0, 3, 6}, {3, 6, 0, 6}, {0, 3, 3, 3}, {0, 0, 0, 3}};
+        table[':'] = {{1, 2, 1, 2}, {1, 4, 1, 4}};
+        table['-'] = {{0, 3, 3, 3}};
+        table['_'] = {{0, 6, 3, 6}};
+        table['.'] = {{1, 5, 1, 5}};
+        table['!'] = {{1, 0, 1, 4}, {1, 6, 1, 6}};
+        table['%'] = {{0, 0, 0, 1}, {3, 5, 3, 6}, {3, 0, 0, 6}};
+        table['?'] = {{0, 2, 2, 0}, {2, 0, 3, 0}, {3, 0, 3, 2}, {3, 2, 2, 3}, {1, 5, 1, 5}};
+    }
+    return table[(unsigned char)c];
+}
+
+void drawChar(PrimitiveBatch& batch, char c, int x, int y, int size, const Color& color) {
+    batch.setColor(color);
+    for (const auto& stroke : glyphStrokes(c)) {
+        drawLine(batch, x + size * stroke.x1, y + size * stroke.y1,
+                 x + size * stroke.x2, y + size * stroke.y2);
+    }
+}
+
+void drawText(PrimitiveBatch& batch, const std::string& text, int x, int y, int size, const Color& color) {
+    int currentX = x;
+    for (char c : text) {
+        if (c != ' ') {
+            drawChar(batch, c, currentX, y, size, color);
+        }
+        currentX += size * 5; // Space between characters
+    }
+}
@@ -0,0 +1,189 @@
+// Space Ping Pong - immediate-mode drawing primitives
+//
+// Colors, the batched point/rect renderer, circle and line rasterization and
+// the stroke font. The game's sprite atlas and glyph sheet are rasterized
+// with the same tables; render_bench times the primitives on a software
+// renderer.
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Colors
+struct Color {
+    Uint8 r, g, b, a;
+    Color(Uint8 r = 0, Uint8 g = 0, Uint8 b = 0, Uint8 a = 255) : r(r), g(g), b(b), a(a) {}
+};
+
+const Color BLACK(0, 0, 0);
+const Color WHITE(255, 255, 255);
+const Color CYAN(0, 255, 255);
+const Color GREEN(50, 205, 50);
+const Color RED(255, 69, 0);
+const Color PURPLE(138, 43, 226);
+const Color GOLD(255, 215, 0);
+const Color BLUE(100, 149, 237);
+const Color PINK(255, 20, 147);
+const Color ORANGE(255, 165, 0);
+
+// Per-frame renderer call counters
+struct RenderStats {
+    int drawCalls;      // Draw calls actually submitted to SDL
+    int legacyCalls;    // Calls the old per-pixel helpers would have issued
+    
+    RenderStats() : drawCalls(0), legacyCalls(0) {}
+};
+
+// Batched primitive renderer
+//
+// Collects points, filled rects and outlined rects that share a draw color and
+// submits them with one SDL_RenderPoints / SDL_RenderFillRects / SDL_RenderRects
+// call each. Changing the color (or calling flush) submits whatever is pending,
+// so the draw order between differently colored primitives is preserved.
+class PrimitiveBatch {
+public:
+    PrimitiveBatch() : renderer(nullptr), hasColor(false) {}
+    
+    void setRenderer(SDL_Renderer* target) {
+        flush();
+        renderer = target;
+        hasColor = false;
+    }
+    
+    void setColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        if (hasColor && color.r == r && color.g == g && color.b == b && color.a == a) {
+            return;
+        }
+        flush();
+        color = Color(r, g, b, a);
+        hasColor = true;
+    }
+    
+    void setColor(const Color& c) {
+        setColor(c.r, c.g, c.b, c.a);
+    }
+    
+    void point(int x, int y) {
+        points.push_back({(float)x, (float)y});
+        stats.legacyCalls++;
+    }
+    
+    // Horizontal run of pixels from x1 to x2 inclusive
+    void span(int x1, int x2, int y) {
+        fillRects.push_back({(float)x1, (float)y, (float)(x2 - x1 + 1), 1});
+        stats.legacyCalls += x2 - x1 + 1;
+    }
+    
+    void fillRect(const SDL_FRect& rect, int legacyCalls = 1) {
+        fillRects.push_back(rect);
+        stats.legacyCalls += legacyCalls;
+    }
+    
+    void rect(const SDL_FRect& rect) {
+        outlineRects.push_back(rect);
+        stats.legacyCalls++;
+    }
+    
+    void flush() {
+        if (!renderer || (points.empty() && fillRects.empty() && outlineRects.empty())) {
+            return;
+        }
+        
+        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+        if (!fillRects.empty()) {
+            SDL_RenderFillRects(renderer, fillRects.data(), (int)fillRects.size());
+            fillRects.clear();
+            stats.drawCalls++;
+        }
+        if (!outlineRects.empty()) {
+            SDL_RenderRects(renderer, outlineRects.data(), (int)outlineRects.size());
+            outlineRects.clear();
+            stats.drawCalls++;
+        }
+        if (!points.empty()) {
+            SDL_RenderPoints(renderer, points.data(), (int)points.size());
+            points.clear();
+            stats.drawCalls++;
+        }
+    }
+    
+    const RenderStats& getStats() const {
+        return stats;
+    }
+    
+    void resetStats() {
+        stats = RenderStats();
+    }
+    
+private:
+    SDL_Renderer* renderer;
+    RenderStats stats;
+    Color color;
+    bool hasColor;
+    std::vector<SDL_FPoint> points;
+    std::vector<SDL_FRect> fillRects;
+    std::vector<SDL_FRect> outlineRects;
+};
+
+// Horizontal half-widths of a filled circle, one entry per row from -radius to
+// radius. Row dy covers dx in [-w, w] where w is the largest dx with
+// dx * dx + dy * dy <= radius * radius.
+const std::vector<int>& circleSpans(int radius);
+
+// Offset of one sampled outline pixel. The original outline truncated
+// x + radius * cos(angle) toward zero, so a fractional offset lands one pixel
+// further right/down once the absolute coordinate goes negative.
+struct CircleOffset {
+    int dx, dy;
+    bool fracX, fracY;
+};
+
+// Unique pixel offsets hit by sampling a circle outline at every whole degree
+const std::vector<CircleOffset>& circleOutline(int radius);
+
+// Bresenham line from (x1, y1) to (x2, y2). The pixels depend on the direction
+// the line is walked in, so callers keep their endpoints in a fixed order.
+template <typename Plot>
+void rasterizeLine(int x1, int y1, int x2, int y2, Plot plot) {
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+    int sx = x1 < x2 ? 1 : -1;
+    int sy = y1 < y2 ? 1 : -1;
+    int err = dx - dy;
+    
+    while (true) {
+        plot(x1, y1);
+        if (x1 == x2 && y1 == y2) break;
+        int e2 = 2 * err;
+        if (e2 > -dy) {
+            err -= dy;
+            x1 += sx;
+        }
+        if (e2 < dx) {
+            err += dx;
+            y1 += sy;
+        }
+    }
+}
+
+// Helper functions
+void drawCircle(PrimitiveBatch& batch, int x, int y, int radius);
+void drawFilledCircle(PrimitiveBatch& batch, int x, int y, int radius);
+void drawLine(PrimitiveBatch& batch, int x1, int y1, int x2, int y2);
+
+// Simple text rendering functions
+
+// One stroke of the built-in 5x7 font, in units of the glyph size
+struct GlyphStroke {
+    int x1, y1, x2, y2;
+};
+
+// Stroke shapes per character. Strokes keep their original direction because
+// the Bresenham pixels depend on it.
+const std::vector<GlyphStroke>& glyphStrokes(char c);
+
+void drawChar(PrimitiveBatch& batch, char c, int x, int y, int size, const Color& color);
+void drawText(PrimitiveBatch& batch, const std::string& text, int x, int y, int size, const Color& color);
@@ -0,0 +1,822 @@
+// Space Ping Pong - replay container
+#include "replay_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[4] = {'S', 'P', 'R', 'F'};
+const char CHUNK_MAGIC[4] = {'S', 'P', 'C', 'K'};
+const char FOOTER_MAGIC[4] = {'S', 'P', 'F', 'T'};
+const char END_MAGIC[4] = {'S', 'P', 'R', 'E'};
+const uint8_t VERSION = 4;              // 2: swept balls, 3: predicting AI, 4: AI arrival heap
+const size_t HEADER_SIZE = 19;          // Magic, version, seed, difficulty, flags, interval
+const size_t CHUNK_HEADER_SIZE = 12;    // Magic, payload size, payload checksum
+const size_t TRAILER_SIZE = 16;         // Footer offset, footer checksum, end magic
+
+// Sanity limits for decoding untrusted files. Power-up types are not range
+// checked: the spawner can pick one past MAGNET, which simply does nothing.
+const uint64_t MAX_OBJECTS = 1 << 20;
+const uint64_t MAX_TRAIL = 1 << 10;
+
+void putBytes(std::vector<uint8_t>& out, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        out.push_back((uint8_t)(value >> (i * 8)));
+    }
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// Small magnitudes of either sign stay small
+void putZigzag(std::vector<uint8_t>& out, int64_t value) {
+    putVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void putFloat(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putBytes(out, bits, 4);
+}
+
+void putMagic(std::vector<uint8_t>& out, const char* magic) {
+    out.insert(out.end(), magic, magic + 4);
+}
+
+uint32_t fnv1a32(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Bounds-checked reader over mapped bytes; any read past the end marks the
+// whole parse failed
+struct ByteReader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    bool failed;
+    
+    ByteReader(const uint8_t* data, size_t size) : data(data), size(size), pos(0), failed(false) {}
+    
+    uint64_t bytes(int count) {
+        if (size - pos < (size_t)count) {
+            failed = true;
+            pos = size;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < count; i++) {
+            value |= (uint64_t)data[pos++] << (i * 8);
+        }
+        return value;
+    }
+    
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= size) {
+                failed = true;
+                return 0;
+            }
+            uint8_t byte = data[pos++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+    
+    int64_t zigzag() {
+        uint64_t value = varint();
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+    
+    float f32() {
+        uint32_t bits = (uint32_t)bytes(4);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    
+    bool magic(const char* expected) {
+        for (int i = 0; i < 4; i++) {
+            if (bytes(1) != (uint8_t)expected[i]) return false;
+        }
+        return !failed;
+    }
+    
+    // Pointer to the next count bytes, skipping them
+    const uint8_t* skip(size_t count) {
+        if (size - pos < count) {
+            failed = true;
+            pos = size;
+            return nullptr;
+        }
+        const uint8_t* start = data + pos;
+        pos += count;
+        return start;
+    }
+};
+
+void savePaddle(std::vector<uint8_t>& out, const Paddle& paddle) {
+    putFloat(out, paddle.x);
+    putFloat(out, paddle.y);
+    putFloat(out, paddle.prevY);
+    putZigzag(out, paddle.width);
+    putZigzag(out, paddle.baseHeight);
+    putZigzag(out, paddle.height);
+    putFloat(out, paddle.speed);
+    out.push_back(paddle.isPlayer ? 1 : 0);
+    putVarint(out, paddle.effects.size());
+    for (const auto& effect : paddle.effects) {
+        out.push_back((uint8_t)effect.first);
+        putFloat(out, effect.second);
+    }
+    out.push_back(paddle.shieldActive ? 1 : 0);
+    putFloat(out, paddle.shieldDuration);
+    out.push_back(paddle.laserActive ? 1 : 0);
+    putFloat(out, paddle.laserDuration);
+    putFloat(out, paddle.laserY);
+    putFloat(out, paddle.aiTargetY);
+    putFloat(out, paddle.aiPendingY);
+    putFloat(out, paddle.aiReactionTimer);
+    putVarint(out, paddle.aiBallsVersion);
+    putFloat(out, paddle.aiClock);
+    putVarint(out, paddle.aiArrivals.size());
+    for (const AiArrival& arrival : paddle.aiArrivals) {
+        putFloat(out, arrival.time);
+        putFloat(out, arrival.y);
+        putVarint(out, arrival.ball);
+        putVarint(out, arrival.course);
+    }
+    putZigzag(out, paddle.aiThreat);
+    putVarint(out, paddle.aiThreatCourse);
+}
+
+bool loadPaddle(ByteReader& reader, Paddle& paddle) {
+    paddle.x = reader.f32();
+    paddle.y = reader.f32();
+    paddle.prevY = reader.f32();
+    paddle.width = (int)reader.zigzag();
+    paddle.baseHeight = (int)reader.zigzag();
+    paddle.height = (int)reader.zigzag();
+    paddle.speed = reader.f32();
+    paddle.isPlayer = reader.bytes(1) != 0;
+    uint64_t effects = reader.varint();
+    if (effects > MAX_OBJECTS) return false;
+    paddle.effects.clear();
+    for (uint64_t i = 0; i < effects && !reader.failed; i++) {
+        PowerUpType type = (PowerUpType)reader.bytes(1);
+        paddle.effects[type] = reader.f32();
+    }
+    paddle.shieldActive = reader.bytes(1) != 0;
+    paddle.shieldDuration = reader.f32();
+    paddle.laserActive = reader.bytes(1) != 0;
+    paddle.laserDuration = reader.f32();
+    paddle.laserY = reader.f32();
+    paddle.aiTargetY = reader.f32();
+    paddle.aiPendingY = reader.f32();
+    paddle.aiReactionTimer = reader.f32();
+    paddle.aiBallsVersion = (uint32_t)reader.varint();
+    paddle.aiClock = reader.f32();
+    uint64_t arrivals = reader.varint();
+    if (arrivals > MAX_OBJECTS) return false;
+    paddle.aiArrivals.clear();
+    for (uint64_t i = 0; i < arrivals && !reader.failed; i++) {
+        AiArrival arrival;
+        arrival.time = reader.f32();
+        arrival.y = reader.f32();
+        arrival.ball = (uint32_t)reader.varint();
+        arrival.course = (uint32_t)reader.varint();
+        paddle.aiArrivals.push_back(arrival);
+    }
+    paddle.aiThreat = (int)reader.zigzag();
+    paddle.aiThreatCourse = (uint32_t)reader.varint();
+    return !reader.failed;
+}
+
+// Positions are delta coded against the previous positioned event
+void saveEvents(std::vector<uint8_t>& out, const std::vector<ReplayEvent>& events, uint32_t firstTick) {
+    putVarint(out, events.size());
+    uint32_t lastTick = firstTick;
+    int64_t lastX = 0;
+    int64_t lastY = 0;
+    for (const ReplayEvent& replayEvent : events) {
+        const MatchEvent& event = replayEvent.event;
+        putVarint(out, replayEvent.tick - lastTick);
+        lastTick = replayEvent.tick;
+        out.push_back((uint8_t)event.type);
+        if (event.type == MatchEvent::SCORE) {
+            out.push_back((uint8_t)event.x);
+        } else if (event.type != MatchEvent::GAME_OVER) {
+            int64_t x = std::llround(event.x);
+            int64_t y = std::llround(event.y);
+            putZigzag(out, x - lastX);
+            putZigzag(out, y - lastY);
+            lastX = x;
+            lastY = y;
+            if (event.type != MatchEvent::PADDLE_HIT) {
+                out.push_back((uint8_t)event.powerType);
+            }
+        }
+    }
+}
+
+bool loadEvents(ByteReader& reader, std::vector<ReplayEvent>& events, uint32_t firstTick) {
+    uint64_t count = reader.varint();
+    if (count > MAX_OBJECTS) return false;
+    events.clear();
+    events.reserve((size_t)count);
+    uint32_t tick = firstTick;
+    int64_t x = 0;
+    int64_t y = 0;
+    for (uint64_t i = 0; i < count && !reader.failed; i++) {
+        tick += (uint32_t)reader.varint();
+        uint64_t type = reader.bytes(1);
+        if (type > MatchEvent::GAME_OVER) return false;
+        MatchEvent event((MatchEvent::Type)type);
+        if (type == MatchEvent::SCORE) {
+            event.x = (float)reader.bytes(1);
+        } else if (type != MatchEvent::GAME_OVER) {
+            x += reader.zigzag();
+            y += reader.zigzag();
+            event.x = (float)x;
+            event.y = (float)y;
+            if (type != MatchEvent::PADDLE_HIT) {
+                event.powerType = (PowerUpType)reader.bytes(1);
+            }
+        }
+        events.push_back({tick, event});
+    }
+    return !reader.failed;
+}
+
+}
+
+void saveMatchState(std::vector<uint8_t>& out, const Match& match) {
+    out.push_back((uint8_t)match.difficulty);
+    putZigzag(out, match.player1Score);
+    putZigzag(out, match.player2Score);
+    putFloat(out, match.powerUpTimer);
+    putZigzag(out, match.powerUpSpawnInterval);
+    putFloat(out, match.freezeTimer);
+    out.push_back(match.over ? 1 : 0);
+    putVarint(out, match.ballsVersion);
+    putBytes(out, match.rng.getState(), 8);
+    putBytes(out, match.rng.getIncrement(), 8);
+    savePaddle(out, match.paddle1);
+    savePaddle(out, match.paddle2);
+    
+    putVarint(out, match.balls.size());
+    for (const Ball& ball : match.balls) {
+        putFloat(out, ball.x);
+        putFloat(out, ball.y);
+        putFloat(out, ball.prevX);
+        putFloat(out, ball.prevY);
+        putFloat(out, ball.velocity.x);
+        putFloat(out, ball.velocity.y);
+        putZigzag(out, ball.size);
+        putFloat(out, ball.baseSpeed);
+        putFloat(out, ball.speedMultiplier);
+        putVarint(out, ball.trail.size());
+        for (const Vector2D& point : ball.trail) {
+            putFloat(out, point.x);
+            putFloat(out, point.y);
+        }
+        out.push_back(ball.isMagnetic ? 1 : 0);
+        putFloat(out, ball.magneticForce);
+        putFloat(out, ball.trailTimer);
+        putVarint(out, ball.course);
+    }
+    
+    putVarint(out, match.powerUps.size());
+    for (const PowerUp& powerUp : match.powerUps) {
+        putFloat(out, powerUp.x);
+        putFloat(out, powerUp.y);
+        out.push_back((uint8_t)powerUp.powerType);
+        putZigzag(out, powerUp.size);
+        putFloat(out, powerUp.lifetime);
+        putFloat(out, powerUp.floatOffset);
+    }
+}
+
+bool loadMatchState(const uint8_t* data, size_t size, Match& match) {
+    ByteReader reader(data, size);
+    uint64_t difficulty = reader.bytes(1);
+    if (difficulty > (uint64_t)Difficulty::HARD) return false;
+    match.difficulty = (Difficulty)difficulty;
+    match.player1Score = (int)reader.zigzag();
+    match.player2Score = (int)reader.zigzag();
+    match.powerUpTimer = reader.f32();
+    match.powerUpSpawnInterval = (int)reader.zigzag();
+    match.freezeTimer = reader.f32();
+    match.over = reader.bytes(1) != 0;
+    match.ballsVersion = (uint32_t)reader.varint();
+    uint64_t state = reader.bytes(8);
+    uint64_t increment = reader.bytes(8);
+    match.rng.restore(state, increment);
+    if (!loadPaddle(reader, match.paddle1) || !loadPaddle(reader, match.paddle2)) return false;
+    
+    uint64_t balls = reader.varint();
+    if (balls > MAX_OBJECTS) return false;
+    match.balls.clear();
+    Random unused;
+    for (uint64_t i = 0; i < balls && !reader.failed; i++) {
+        Ball ball(0, 0, unused);
+        ball.x = reader.f32();
+        ball.y = reader.f32();
+        ball.prevX = reader.f32();
+        ball.prevY = reader.f32();
+        ball.velocity.x = reader.f32();
+        ball.velocity.y = reader.f32();
+        ball.size = (int)reader.zigzag();
+        ball.baseSpeed = reader.f32();
+        ball.speedMultiplier = reader.f32();
+        uint64_t trail = reader.varint();
+        if (trail > MAX_TRAIL) return false;
+        for (uint64_t j = 0; j < trail && !reader.failed; j++) {
+            float x = reader.f32();
+            ball.trail.push_back(Vector2D(x, reader.f32()));
+        }
+        ball.isMagnetic = reader.bytes(1) != 0;
+        ball.magneticForce = reader.f32();
+        ball.trailTimer = reader.f32();
+        ball.course = (uint32_t)reader.varint();
+        match.balls.push_back(ball);
+    }
+    
+    uint64_t powerUps = reader.varint();
+    if (powerUps > MAX_OBJECTS) return false;
+    match.powerUps.clear();
+    for (uint64_t i = 0; i < powerUps && !reader.failed; i++) {
+        float x = reader.f32();
+        float y = reader.f32();
+        PowerUp powerUp(x, y, (PowerUpType)reader.bytes(1));
+        powerUp.size = (int)reader.zigzag();
+        powerUp.lifetime = reader.f32();
+        powerUp.floatOffset = reader.f32();
+        match.powerUps.push_back(powerUp);
+    }
+    match.events.clear();
+    return !reader.failed && reader.pos == size;
+}
+
+ReplayWriter::ReplayWriter() : file(nullptr), tick(0), offset(0), failed(false) {}
+
+ReplayWriter::~ReplayWriter() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool ReplayWriter::open(const std::string& path, const ReplayHeader& replayHeader) {
+    if (file) {
+        std::fclose(file);
+    }
+    file = std::fopen(path.c_str(), "wb");
+    if (!file || replayHeader.keyframeInterval == 0) {
+        return false;
+    }
+    header = replayHeader;
+    tick = 0;
+    offset = 0;
+    failed = false;
+    chunkOffsets.clear();
+    inputs.clear();
+    tickRates.clear();
+    events.clear();
+    
+    std::vector<uint8_t> out;
+    putMagic(out, MAGIC);
+    out.push_back(VERSION);
+    putBytes(out, header.seed, 8);
+    out.push_back((uint8_t)header.difficulty);
+    out.push_back((uint8_t)((header.player1Human ? 1 : 0) | (header.player2Human ? 2 : 0)));
+    putBytes(out, header.keyframeInterval, 4);
+    write(out);
+    std::fflush(file);
+    return !failed;
+}
+
+void ReplayWriter::record(const Match& match, const PaddleInput& input1, const PaddleInput& input2, int tickRate) {
+    if (!file) return;
+    if (tick % header.keyframeInterval == 0) {
+        if (!inputs.empty()) {
+            writeChunk();
+        }
+        keyframe.clear();
+        saveMatchState(keyframe, match);
+    }
+    inputs.push_back(packInputs(input1, input2));
+    tickRates.push_back(tickRate);
+    tick++;
+}
+
+void ReplayWriter::recordEvents(const std::vector<MatchEvent>& tickEvents) {
+    if (!file || tick == 0) return;
+    for (const MatchEvent& event : tickEvents) {
+        events.push_back({tick - 1, event});
+    }
+}
+
+bool ReplayWriter::close(const Match& match) {
+    if (!file) {
+        return false;
+    }
+    if (!inputs.empty()) {
+        writeChunk();
+    }
+    
+    uint64_t footerOffset = offset;
+    std::vector<uint8_t> footer;
+    putMagic(footer, FOOTER_MAGIC);
+    putVarint(footer, chunkOffsets.size());
+    uint64_t previous = 0;
+    for (uint64_t chunkOffset : chunkOffsets) {
+        putVarint(footer, chunkOffset - previous);
+        previous = chunkOffset;
+    }
+    putVarint(footer, tick);
+    putBytes(footer, match.checksum(), 8);
+    uint32_t checksum = fnv1a32(footer.data(), footer.size());
+    putBytes(footer, footerOffset, 8);
+    putBytes(footer, checksum, 4);
+    putMagic(footer, END_MAGIC);
+    write(footer);
+    
+    failed = std::fclose(file) != 0 || failed;
+    file = nullptr;
+    return !failed;
+}
+
+void ReplayWriter::writeChunk() {
+    uint32_t firstTick = tick - (uint32_t)inputs.size();
+    std::vector<uint8_t> payload;
+    payload.reserve(keyframe.size() + 64 + events.size() * 6);
+    putVarint(payload, firstTick);
+    putVarint(payload, inputs.size());
+    putVarint(payload, keyframe.size());
+    payload.insert(payload.end(), keyframe.begin(), keyframe.end());
+    
+    // Runs of identical inputs; the low bit of a run flags a new tick rate
+    putVarint(payload, (uint64_t)tickRates[0]);
+    for (size_t i = 0; i < inputs.size();) {
+        size_t run = 1;
+        while (i + run < inputs.size() && inputs[i + run] == inputs[i] && tickRates[i + run] == tickRates[i]) {
+            run++;
+        }
+        bool rateChanged = i > 0 && tickRates[i] != tickRates[i - 1];
+        putVarint(payload, (run << 1) | (rateChanged ? 1 : 0));
+        if (rateChanged) {
+            putVarint(payload, (uint64_t)tickRates[i]);
+        }
+        payload.push_back(inputs[i]);
+        i += run;
+    }
+    saveEvents(payload, events, firstTick);
+    
+    std::vector<uint8_t> chunk;
+    chunk.reserve(CHUNK_HEADER_SIZE + payload.size());
+    putMagic(chunk, CHUNK_MAGIC);
+    putBytes(chunk, payload.size(), 4);
+    putBytes(chunk, fnv1a32(payload.data(), payload.size()), 4);
+    chunk.insert(chunk.end(), payload.begin(), payload.end());
+    
+    // Complete chunks reach the OS before the next one starts
+    chunkOffsets.push_back(offset);
+    write(chunk);
+    std::fflush(file);
+    
+    inputs.clear();
+    tickRates.clear();
+    events.clear();
+}
+
+void ReplayWriter::write(const std::vector<uint8_t>& bytes) {
+    if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+        failed = true;
+    }
+    offset += bytes.size();
+}
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), handle(-1), mapping(0) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path, bool sequential) {
+    close();
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    handle = (intptr_t)fileHandle;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    length = (size_t)fileSize.QuadPart;
+    if (length == 0) {
+        return true;
+    }
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        close();
+        return false;
+    }
+    mapping = (intptr_t)mappingHandle;
+    bytes = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!bytes) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mapping) CloseHandle((HANDLE)mapping);
+    if (handle != -1) CloseHandle((HANDLE)handle);
+    bytes = nullptr;
+    length = 0;
+    mapping = 0;
+    handle = -1;
+}
+#else
+bool MappedFile::open(const std::string& path, bool sequential) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    handle = fd;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close();
+        return false;
+    }
+    length = (size_t)info.st_size;
+    if (length == 0) {
+        return true;
+    }
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        length = 0;
+        close();
+        return false;
+    }
+    bytes = (const uint8_t*)mapped;
+    if (sequential) {
+        madvise(mapped, length, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes) munmap((void*)bytes, length);
+    if (handle != -1) ::close((int)handle);
+    bytes = nullptr;
+    length = 0;
+    handle = -1;
+}
+#endif
+
+ReplayReader::ReplayReader() : tickCount(0), complete(false), finalChecksum(0) {}
+
+bool ReplayReader::open(const std::string& path, bool sequential) {
+    close();
+    if (!file.open(path, sequential)) {
+        return false;
+    }
+    ByteReader reader(file.data(), file.size());
+    if (!reader.magic(MAGIC) || reader.bytes(1) != VERSION) {
+        close();
+        return false;
+    }
+    header.seed = reader.bytes(8);
+    uint64_t difficulty = reader.bytes(1);
+    uint64_t flags = reader.bytes(1);
+    header.keyframeInterval = (uint32_t)reader.bytes(4);
+    if (reader.failed || difficulty > (uint64_t)Difficulty::HARD || header.keyframeInterval == 0) {
+        close();
+        return false;
+    }
+    header.difficulty = (Difficulty)difficulty;
+    header.player1Human = (flags & 1) != 0;
+    header.player2Human = (flags & 2) != 0;
+    
+    complete = readFooter(HEADER_SIZE);
+    if (!complete) {
+        walkChunks(HEADER_SIZE);
+    }
+    return true;
+}
+
+void ReplayReader::close() {
+    file.close();
+    chunks.clear();
+    tickCount = 0;
+    complete = false;
+    finalChecksum = 0;
+}
+
+// The footer vouches that every chunk was written in full, so their
+// checksums are left to walkChunks()
+bool ReplayReader::readFooter(size_t dataStart) {
+    if (file.size() < dataStart + TRAILER_SIZE) {
+        return false;
+    }
+    size_t trailer = file.size() - TRAILER_SIZE;
+    ByteReader end(file.data() + trailer, TRAILER_SIZE);
+    uint64_t footerOffset = end.bytes(8);
+    uint32_t checksum = (uint32_t)end.bytes(4);
+    if (!end.magic(END_MAGIC) || footerOffset < dataStart || footerOffset >= trailer ||
+        fnv1a32(file.data() + footerOffset, trailer - (size_t)footerOffset) != checksum) {
+        return false;
+    }
+    
+    ByteReader footer(file.data() + footerOffset, trailer - (size_t)footerOffset);
+    if (!footer.magic(FOOTER_MAGIC)) {
+        return false;
+    }
+    uint64_t count = footer.varint();
+    if (count > file.size() / CHUNK_HEADER_SIZE) {
+        return false;
+    }
+    std::vector<ChunkSpan> spans;
+    spans.reserve((size_t)count);
+    uint64_t chunkOffset = 0;
+    for (uint64_t i = 0; i < count && !footer.failed; i++) {
+        chunkOffset += footer.varint();
+        if (chunkOffset < dataStart || chunkOffset + CHUNK_HEADER_SIZE > footerOffset) {
+            return false;
+        }
+        ByteReader chunk(file.data() + chunkOffset, CHUNK_HEADER_SIZE);
+        bool tagged = chunk.magic(CHUNK_MAGIC);
+        uint64_t size = chunk.bytes(4);
+        if (!tagged || chunkOffset + CHUNK_HEADER_SIZE + size > footerOffset) {
+            return false;
+        }
+        spans.push_back({(size_t)chunkOffset + CHUNK_HEADER_SIZE, (size_t)size});
+    }
+    uint64_t ticks = footer.varint();
+    uint64_t checksumValue = footer.bytes(8);
+    if (footer.failed || ticks > UINT32_MAX || (uint64_t)count * header.keyframeInterval < ticks) {
+        return false;
+    }
+    
+    chunks.swap(spans);
+    tickCount = (uint32_t)ticks;
+    finalChecksum = checksumValue;
+    return true;
+}
+
+// Recovers what a crashed writer left: every chunk up to the first that is
+// cut short or fails its checksum
+void ReplayReader::walkChunks(size_t dataStart) {
+    chunks.clear();
+    tickCount = 0;
+    size_t offset = dataStart;
+    while (file.size() - offset >= CHUNK_HEADER_SIZE) {
+        ByteReader chunk(file.data() + offset, file.size() - offset);
+        if (!chunk.magic(CHUNK_MAGIC)) break;
+        uint64_t size = chunk.bytes(4);
+        uint32_t checksum = (uint32_t)chunk.bytes(4);
+        const uint8_t* payload = chunk.skip((size_t)size);
+        if (chunk.failed || fnv1a32(payload, (size_t)size) != checksum) break;
+        
+        ByteReader counts(payload, (size_t)size);
+        uint64_t firstTick = counts.varint();
+        uint64_t ticks = counts.varint();
+        if (counts.failed || firstTick != (uint64_t)chunks.size() * header.keyframeInterval) break;
+        chunks.push_back({offset + CHUNK_HEADER_SIZE, (size_t)size});
+        tickCount = (uint32_t)(firstTick + ticks);
+        offset += CHUNK_HEADER_SIZE + (size_t)size;
+    }
+}
+
+bool ReplayReader::readChunk(size_t index, ReplayChunk& chunk) const {
+    if (index >= chunks.size()) {
+        return false;
+    }
+    ByteReader reader(file.data() + chunks[index].offset, chunks[index].size);
+    chunk.firstTick = (uint32_t)reader.varint();
+    uint64_t ticks = reader.varint();
+    chunk.keyframeSize = (size_t)reader.varint();
+    chunk.keyframe = reader.skip(chunk.keyframeSize);
+    if (reader.failed || ticks > header.keyframeInterval ||
+        chunk.firstTick != (uint64_t)index * header.keyframeInterval) {
+        return false;
+    }
+    
+    chunk.inputs.resize((size_t)ticks);
+    chunk.tickRates.resize((size_t)ticks);
+    int tickRate = (int)reader.varint();
+    for (size_t tick = 0; tick < ticks && !reader.failed;) {
+        uint64_t head = reader.varint();
+        uint64_t run = head >> 1;
+        if (head & 1) {
+            tickRate = (int)reader.varint();
+        }
+        uint8_t bits = (uint8_t)reader.bytes(1);
+        if (run == 0 || run > ticks - tick || tickRate <= 0) {
+            return false;
+        }
+        std::fill(chunk.inputs.begin() + tick, chunk.inputs.begin() + tick + run, bits);
+        std::fill(chunk.tickRates.begin() + tick, chunk.tickRates.begin() + tick + run, tickRate);
+        tick += (size_t)run;
+    }
+    return loadEvents(reader, chunk.events, chunk.firstTick);
+}
+
+bool ReplayReader::seek(uint32_t tick, Match& match) const {
+    if (tick > tickCount || chunks.empty()) {
+        return false;
+    }
+    size_t index = std::min<size_t>(tick / header.keyframeInterval, chunks.size() - 1);
+    ReplayChunk chunk;
+    if (!readChunk(index, chunk) || !loadMatchState(chunk.keyframe, chunk.keyframeSize, match)) {
+        return false;
+    }
+    
+    PaddleInput input1, input2;
+    for (uint32_t t = chunk.firstTick; t < tick; t++) {
+        size_t i = t - chunk.firstTick;
+        if (i >= chunk.inputs.size()) {
+            return false;
+        }
+        unpackInputs(chunk.inputs[i], input1, input2);
+        match.tick((float)FPS / chunk.tickRates[i], input1, input2);
+    }
+    return true;
+}
+
+bool ReplayReader::toRecording(InputRecording& recording) const {
+    recording.start(header.seed, FPS, header.difficulty, header.player1Human, header.player2Human);
+    ReplayChunk chunk;
+    PaddleInput input1, input2;
+    for (size_t index = 0; index < chunks.size(); index++) {
+        if (!readChunk(index, chunk)) {
+            return false;
+        }
+        for (size_t i = 0; i < chunk.inputs.size(); i++) {
+            unpackInputs(chunk.inputs[i], input1, input2);
+            recording.record(input1, input2, chunk.tickRates[i]);
+        }
+    }
+    recording.finalChecksum = finalChecksum;
+    return true;
+}
+
+bool writeReplayFile(const std::string& path, const InputRecording& recording, uint32_t keyframeInterval) {
+    ReplayHeader header;
+    header.seed = recording.seed;
+    header.difficulty = recording.difficulty;
+    header.player1Human = recording.player1Human;
+    header.player2Human = recording.player2Human;
+    header.keyframeInterval = keyframeInterval;
+    ReplayWriter writer;
+    if (!writer.open(path, header)) {
+        return false;
+    }
+    
+    Match match;
+    match.difficulty = recording.difficulty;
+    match.reset(recording.player1Human, recording.player2Human, recording.seed);
+    InputPlayer player(recording);
+    PaddleInput input1, input2;
+    while (!player.done()) {
+        int rate = player.next(input1, input2);
+        writer.record(match, input1, input2, rate);
+        match.tick((float)FPS / rate, input1, input2);
+        writer.recordEvents(match.events);
+    }
+    return writer.close(match);
+}
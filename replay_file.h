@@ -0,0 +1,192 @@
+// Space Ping Pong - replay container
+//
+// For long sessions an input log alone is slow to seek: reaching tick N
+// means simulating every tick before it. A replay file is cut into chunks of
+// keyframeInterval ticks. Each chunk starts with a keyframe, the complete
+// match state before its first tick, followed by that chunk's inputs
+// (run-length encoded with varints) and its match events (tick and position
+// deltas, zigzag varints). Chunk k always starts at tick k * keyframeInterval,
+// so finding the keyframe for a tick is a division, and reaching the tick
+// costs at most keyframeInterval - 1 ticks of simulation.
+//
+// The file is only ever appended to. Every chunk carries its size and a
+// checksum and is flushed when complete; closing the writer appends a footer
+// with the offset of every chunk and the final match checksum. A file cut
+// short by a crash has no footer, and the reader recovers the index by
+// walking the chunks, stopping at the first one that is incomplete.
+//
+// Readers map the file (mmap, or a file mapping on Windows) and decode
+// chunks straight out of the mapping.
+#pragma once
+
+#include "input_recording.h"
+#include "pingpong_sim.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Full match state, bit for bit, including where the random stream is
+void saveMatchState(std::vector<uint8_t>& out, const Match& match);
+bool loadMatchState(const uint8_t* data, size_t size, Match& match);
+
+struct ReplayHeader {
+    uint64_t seed;
+    Difficulty difficulty;
+    bool player1Human;
+    bool player2Human;
+    uint32_t keyframeInterval;  // Ticks per chunk
+    
+    ReplayHeader() : seed(0), difficulty(Difficulty::MEDIUM), player1Human(true), player2Human(false),
+                     keyframeInterval(600) {}
+};
+
+struct ReplayEvent {
+    uint32_t tick;
+    MatchEvent event;       // Positions rounded to whole pixels
+};
+
+// One chunk, decoded
+struct ReplayChunk {
+    uint32_t firstTick;
+    const uint8_t* keyframe;        // Into the mapping; valid while the reader is open
+    size_t keyframeSize;
+    std::vector<uint8_t> inputs;    // packInputs() per tick
+    std::vector<int> tickRates;     // Per tick
+    std::vector<ReplayEvent> events;
+};
+
+class ReplayWriter {
+public:
+    ReplayWriter();
+    ~ReplayWriter();
+    
+    ReplayWriter(const ReplayWriter&) = delete;
+    ReplayWriter& operator=(const ReplayWriter&) = delete;
+    
+    bool open(const std::string& path, const ReplayHeader& header);
+    
+    bool isOpen() const {
+        return file != nullptr;
+    }
+    
+    // Call before each tick with the state it starts from, then after it
+    // with the events it produced
+    void record(const Match& match, const PaddleInput& input1, const PaddleInput& input2, int tickRate);
+    void recordEvents(const std::vector<MatchEvent>& events);
+    
+    // Writes the last chunk and the footer; false if any write failed
+    bool close(const Match& match);
+    
+    uint32_t getTick() const {
+        return tick;
+    }
+    
+private:
+    FILE* file;
+    ReplayHeader header;
+    uint32_t tick;
+    uint64_t offset;
+    bool failed;
+    std::vector<uint64_t> chunkOffsets;
+    
+    // The chunk being filled
+    std::vector<uint8_t> keyframe;
+    std::vector<uint8_t> inputs;
+    std::vector<int> tickRates;
+    std::vector<ReplayEvent> events;
+    
+    void writeChunk();
+    void write(const std::vector<uint8_t>& bytes);
+};
+
+// Read-only view of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    // sequential hints the OS to read ahead aggressively
+    bool open(const std::string& path, bool sequential);
+    void close();
+    
+    const uint8_t* data() const {
+        return bytes;
+    }
+    
+    size_t size() const {
+        return length;
+    }
+    
+private:
+    const uint8_t* bytes;
+    size_t length;
+    intptr_t handle;        // File descriptor, or file HANDLE on Windows
+    intptr_t mapping;       // Mapping HANDLE on Windows
+};
+
+class ReplayReader {
+public:
+    ReplayReader();
+    
+    bool open(const std::string& path, bool sequential = false);
+    void close();
+    
+    const ReplayHeader& getHeader() const {
+        return header;
+    }
+    
+    uint32_t getTickCount() const {
+        return tickCount;
+    }
+    
+    size_t getChunkCount() const {
+        return chunks.size();
+    }
+    
+    // False if the footer was missing and the chunks were walked instead
+    bool isComplete() const {
+        return complete;
+    }
+    
+    // Match::checksum() after the last tick; only known when complete
+    uint64_t getFinalChecksum() const {
+        return finalChecksum;
+    }
+    
+    size_t getFileSize() const {
+        return file.size();
+    }
+    
+    bool readChunk(size_t index, ReplayChunk& chunk) const;
+    
+    // Sets match to the state before tick, for any tick up to getTickCount()
+    bool seek(uint32_t tick, Match& match) const;
+    
+    // Back to a plain input recording, e.g. for InputPlayer
+    bool toRecording(InputRecording& recording) const;
+    
+private:
+    struct ChunkSpan {
+        size_t offset;      // Of the payload
+        size_t size;
+    };
+    
+    MappedFile file;
+    ReplayHeader header;
+    std::vector<ChunkSpan> chunks;
+    uint32_t tickCount;
+    bool complete;
+    uint64_t finalChecksum;
+    
+    bool readFooter(size_t dataStart);
+    void walkChunks(size_t dataStart);
+};
+
+// Replays an input recording into a new replay file
+bool writeReplayFile(const std::string& path, const InputRecording& recording, uint32_t keyframeInterval);
@@ -0,0 +1,347 @@
+// Space Ping Pong - replay container tool and benchmark
+//
+//   replay_tool convert IN OUT [--interval N]   input recording to container
+//   replay_tool info FILE                       header, chunks and events
+//   replay_tool seek FILE TICK                  state checksum before a tick
+//   replay_tool bench [options]                 write, scan and seek timings
+//
+// bench writes a few thousand scripted replays, then times a plain read of
+// every file against a full mapped decode of every chunk, times random
+// seeks against simulating from the start, and checks that a file cut off
+// part way still opens and seeks correctly.
+#include "input_recording.h"
+#include "replay_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int convert(const std::string& in, const std::string& out, uint32_t interval) {
+    InputRecording recording;
+    if (!recording.load(in)) {
+        std::cerr << "Could not read recording " << in << std::endl;
+        return -1;
+    }
+    if (!writeReplayFile(out, recording, interval)) {
+        std::cerr << "Could not write " << out << std::endl;
+        return -1;
+    }
+    ReplayReader reader;
+    if (!reader.open(out)) {
+        std::cerr << "Could not read back " << out << std::endl;
+        return -1;
+    }
+    bool exact = reader.getFinalChecksum() == recording.finalChecksum;
+    std::cout << "Wrote " << reader.getTickCount() << " ticks in " << reader.getChunkCount() << " chunks, "
+              << reader.getFileSize() << " bytes, " << (exact ? "final state matches" : "final state DIFFERS")
+              << std::endl;
+    return exact ? 0 : 1;
+}
+
+int info(const std::string& path) {
+    ReplayReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Could not read " << path << std::endl;
+        return -1;
+    }
+    const ReplayHeader& header = reader.getHeader();
+    size_t keyframeBytes = 0;
+    size_t counts[MatchEvent::GAME_OVER + 1] = {};
+    ReplayChunk chunk;
+    for (size_t i = 0; i < reader.getChunkCount(); i++) {
+        if (!reader.readChunk(i, chunk)) {
+            std::cerr << "Chunk " << i << " is corrupt" << std::endl;
+            return 1;
+        }
+        keyframeBytes += chunk.keyframeSize;
+        for (const ReplayEvent& event : chunk.events) {
+            counts[event.event.type]++;
+        }
+    }
+    std::cout << path << ": seed " << header.seed << ", " << reader.getTickCount() << " ticks, "
+              << reader.getChunkCount() << " chunks of " << header.keyframeInterval << " ticks, "
+              << reader.getFileSize() << " bytes (" << keyframeBytes << " in keyframes), "
+              << (reader.isComplete() ? "complete" : "no footer, recovered") << std::endl;
+    std::cout << "events: " << counts[MatchEvent::PADDLE_HIT] << " hits, " << counts[MatchEvent::SCORE]
+              << " scores, " << counts[MatchEvent::POWER_UP_SPAWNED] << " power-ups spawned, "
+              << counts[MatchEvent::POWER_UP_COLLECTED] << " collected, " << counts[MatchEvent::GAME_OVER]
+              << " game over" << std::endl;
+    return 0;
+}
+
+int seek(const std::string& path, uint32_t tick) {
+    ReplayReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Could not read " << path << std::endl;
+        return -1;
+    }
+    Match match;
+    auto start = std::chrono::steady_clock::now();
+    if (!reader.seek(tick, match)) {
+        std::cerr << "Could not seek to tick " << tick << " of " << reader.getTickCount() << std::endl;
+        return 1;
+    }
+    double seconds = secondsSince(start);
+    std::printf("tick %u: %d-%d, %zu balls, checksum %016llx, %.1f us\n", tick, match.player1Score,
+                match.player2Score, match.balls.size(), (unsigned long long)match.checksum(), seconds * 1e6);
+    return 0;
+}
+
+// Player 1 chases the ball so inputs change like a person's would
+PaddleInput scriptedInput(const Match& match) {
+    float center = match.paddle1.getCenterY();
+    float target = match.balls.empty() ? SCREEN_HEIGHT / 2.0f : match.balls[0].y;
+    return PaddleInput(center > target + 20, center < target - 20);
+}
+
+bool generate(const std::string& path, uint64_t seed, uint32_t ticks, uint32_t interval) {
+    ReplayHeader header;
+    header.seed = seed;
+    header.keyframeInterval = interval;
+    ReplayWriter writer;
+    if (!writer.open(path, header)) {
+        return false;
+    }
+    Match match;
+    match.reset(true, false, seed);
+    PaddleInput idle;
+    for (uint32_t tick = 0; tick < ticks && !match.over; tick++) {
+        PaddleInput input = scriptedInput(match);
+        writer.record(match, input, idle, FPS);
+        match.tick(1.0f, input, idle);
+        writer.recordEvents(match.events);
+    }
+    return writer.close(match);
+}
+
+bool copyPrefix(const std::string& from, const std::string& to, size_t bytes) {
+    std::vector<char> data(bytes);
+    FILE* in = std::fopen(from.c_str(), "rb");
+    if (!in) return false;
+    bool read = std::fread(data.data(), 1, bytes, in) == bytes;
+    std::fclose(in);
+    FILE* out = std::fopen(to.c_str(), "wb");
+    if (!out) return false;
+    bool written = std::fwrite(data.data(), 1, bytes, out) == bytes;
+    return std::fclose(out) == 0 && read && written;
+}
+
+int bench(int files, uint32_t ticks, uint32_t interval, int seeks, std::filesystem::path dir, bool keep) {
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    std::vector<std::string> paths;
+    for (int i = 0; i < files; i++) {
+        paths.push_back((dir / ("replay_" + std::to_string(i) + ".sprf")).string());
+    }
+    
+    // Write
+    Random seeds(1, MATCH_SEED_STREAM);
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& path : paths) {
+        if (!generate(path, seeds.next64(), ticks, interval)) {
+            std::cerr << "Could not write " << path << std::endl;
+            return -1;
+        }
+    }
+    double writeSeconds = secondsSince(start);
+    uint64_t totalBytes = 0;
+    for (const std::string& path : paths) {
+        totalBytes += std::filesystem::file_size(path, error);
+    }
+    double megabytes = totalBytes / 1048576.0;
+    std::printf("write: %d files, %.1f MB, %.0f bytes per 1000 ticks, %.2f s (simulation included)\n",
+                files, megabytes, totalBytes * 1000.0 / ((double)files * ticks), writeSeconds);
+    
+    // Plain read of every byte, the bandwidth to match
+    std::vector<char> buffer(1 << 20);
+    uint64_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (const std::string& path : paths) {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        size_t read;
+        while (file && (read = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+            checksum += (unsigned char)buffer[read - 1];
+        }
+        if (file) std::fclose(file);
+    }
+    double readSeconds = secondsSince(start);
+    std::printf("read:  %.0f MB/s, %.0f files/s (fread, page cache)\n", megabytes / readSeconds,
+                files / readSeconds);
+    
+    // Decode every chunk through the mapping
+    uint64_t scanTicks = 0;
+    uint64_t scores = 0;
+    uint64_t hits = 0;
+    ReplayChunk chunk;
+    start = std::chrono::steady_clock::now();
+    for (const std::string& path : paths) {
+        ReplayReader reader;
+        if (!reader.open(path, true)) {
+            std::cerr << "Could not open " << path << std::endl;
+            return 1;
+        }
+        for (size_t i = 0; i < reader.getChunkCount(); i++) {
+            if (!reader.readChunk(i, chunk)) {
+                std::cerr << "Chunk " << i << " of " << path << " is corrupt" << std::endl;
+                return 1;
+            }
+            scanTicks += chunk.inputs.size();
+            for (const ReplayEvent& event : chunk.events) {
+                scores += event.event.type == MatchEvent::SCORE;
+                hits += event.event.type == MatchEvent::PADDLE_HIT;
+            }
+        }
+    }
+    double scanSeconds = secondsSince(start);
+    std::printf("scan:  %.0f MB/s, %.0f files/s, %.0f M ticks/s decoded, %llu hits, %llu scores (mmap)\n",
+                megabytes / scanSeconds, files / scanSeconds, scanTicks / scanSeconds / 1e6,
+                (unsigned long long)hits, (unsigned long long)scores);
+    
+    // Seeks into the first file, checked against one pass from the start
+    ReplayReader reader;
+    if (!reader.open(paths[0])) {
+        std::cerr << "Could not open " << paths[0] << std::endl;
+        return 1;
+    }
+    Random picks(2, COSMETIC_STREAM);
+    std::vector<uint32_t> targets;
+    for (int i = 0; i < seeks; i++) {
+        targets.push_back((uint32_t)picks.range(0, (int)reader.getTickCount()));
+    }
+    std::vector<uint32_t> sorted = targets;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<std::pair<uint32_t, uint64_t>> expected;
+    Match match;
+    reader.seek(0, match);
+    uint32_t tick = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t target : sorted) {
+        for (; tick < target; tick++) {
+            if (tick % interval == 0) reader.readChunk(tick / interval, chunk);
+            PaddleInput input1, input2;
+            unpackInputs(chunk.inputs[tick % interval], input1, input2);
+            match.tick(1.0f, input1, input2);
+        }
+        expected.push_back({target, match.checksum()});
+    }
+    double fromStart = secondsSince(start) / std::max<uint32_t>(tick, 1) * reader.getTickCount() / 2;
+    
+    std::vector<double> times;
+    bool exact = true;
+    for (uint32_t target : targets) {
+        auto seekStart = std::chrono::steady_clock::now();
+        bool ok = reader.seek(target, match);
+        times.push_back(secondsSince(seekStart) * 1e6);
+        uint64_t want = std::lower_bound(expected.begin(), expected.end(), std::make_pair(target, (uint64_t)0))->second;
+        exact = exact && ok && match.checksum() == want;
+    }
+    std::sort(times.begin(), times.end());
+    double mean = 0;
+    for (double t : times) mean += t;
+    mean /= std::max<size_t>(times.size(), 1);
+    std::printf("seek:  %d random ticks of %u, mean %.1f us, max %.1f us; simulating from the start "
+                "averages %.1f us; %s\n", seeks, reader.getTickCount(), mean, times.empty() ? 0.0 : times.back(),
+                fromStart * 1e6, exact ? "every state matches" : "STATES DIFFER");
+    
+    // A writer that died part way leaves a readable prefix
+    std::string cut = (dir / "truncated.sprf").string();
+    size_t size = reader.getFileSize();
+    bool recovered = copyPrefix(paths[0], cut, size * 3 / 5);
+    ReplayReader partial;
+    recovered = recovered && partial.open(cut) && !partial.isComplete() && partial.getChunkCount() > 0;
+    if (recovered) {
+        uint32_t last = partial.getTickCount();
+        Match full;
+        Match prefix;
+        recovered = reader.seek(last, full) && partial.seek(last, prefix) && full.checksum() == prefix.checksum();
+        std::printf("crash: %zu of %zu bytes kept %zu of %zu chunks, %u ticks, seek to the end %s\n",
+                    size * 3 / 5, size, partial.getChunkCount(), reader.getChunkCount(), last,
+                    recovered ? "matches" : "DIFFERS");
+    } else {
+        std::printf("crash: truncated file could not be recovered\n");
+    }
+    
+    partial.close();
+    std::filesystem::remove(cut, error);
+    if (!keep) {
+        for (const std::string& path : paths) {
+            std::filesystem::remove(path, error);
+        }
+        std::filesystem::remove(dir, error);
+    }
+    return exact && recovered && checksum != 1 ? 0 : 1;
+}
+
+void usage() {
+    std::cerr << "Usage: replay_tool convert IN OUT [--interval N]\n"
+              << "       replay_tool info FILE\n"
+              << "       replay_tool seek FILE TICK\n"
+              << "       replay_tool bench [--files N] [--ticks N] [--interval N] [--seeks N] [--dir DIR]"
+              << " [--keep]"
+              << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage();
+        return -1;
+    }
+    std::string command = argv[1];
+    std::vector<std::string> positional;
+    uint32_t interval = 600;
+    int files = 2000;
+    uint32_t ticks = 3600;
+    int seeks = 200;
+    bool keep = false;
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "spp_replay_bench";
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--interval" && i + 1 < argc) {
+            interval = (uint32_t)std::atoi(argv[++i]);
+        } else if (arg == "--files" && i + 1 < argc) {
+            files = std::atoi(argv[++i]);
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            ticks = (uint32_t)std::atoi(argv[++i]);
+        } else if (arg == "--seeks" && i + 1 < argc) {
+            seeks = std::atoi(argv[++i]);
+        } else if (arg == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--keep") {
+            keep = true;
+        } else if (arg.compare(0, 2, "--") != 0) {
+            positional.push_back(arg);
+        } else {
+            usage();
+            return -1;
+        }
+    }
+    if (interval == 0 || files <= 0 || ticks == 0 || seeks < 0) {
+        std::cerr << "Counts must be positive" << std::endl;
+        return -1;
+    }
+    
+    if (command == "convert" && positional.size() == 2) {
+        return convert(positional[0], positional[1], interval);
+    } else if (command == "info" && positional.size() == 1) {
+        return info(positional[0]);
+    } else if (command == "seek" && positional.size() == 2) {
+        return seek(positional[0], (uint32_t)std::strtoul(positional[1].c_str(), nullptr, 10));
+    } else if (command == "bench" && positional.empty()) {
+        return bench(files, ticks, interval, seeks, dir, keep);
+    }
+    usage();
+    return -1;
+}
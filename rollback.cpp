@@ -0,0 +1,132 @@
+// Space Ping Pong - rollback for networked matches
+#include "rollback.h"
+#include "trace.h"
+
+RollbackSession::RollbackSession(Match& match) : match(match), localPlayer(1), snapshots(HISTORY) {
+    start(0, 1);
+}
+
+void RollbackSession::start(uint64_t seed, int player) {
+    match.reset(true, true, seed);
+    localPlayer = player;
+    for (uint32_t i = 0; i < HISTORY; i++) {
+        localInputs[i] = 0;
+        remoteInputs[i] = 0;
+    }
+    currentTick = 0;
+    remoteConfirmed = 0;
+    firstMismatch = UINT32_MAX;
+    
+    nextChecksumTick = 0;
+    lastChecksumTick = UINT32_MAX;
+    lastChecksum = 0;
+    for (int i = 0; i < 8; i++) {
+        checksumTicks[i] = UINT32_MAX;
+        checksums[i] = 0;
+    }
+    
+    rollbacks = 0;
+    resimulatedTicks = 0;
+    longestRollback = 0;
+    slowestRollbackNs = 0;
+}
+
+void RollbackSession::advance(const PaddleInput& localInput) {
+    synchronize();
+    
+    localInputs[currentTick % HISTORY] = packInputs(localInput, PaddleInput());
+    if (currentTick >= remoteConfirmed) {
+        // Predict the remote player keeps doing what they last did
+        remoteInputs[currentTick % HISTORY] = remoteConfirmed > 0 ? remoteInputs[(remoteConfirmed - 1) % HISTORY] : 0;
+    }
+    simulate(currentTick);
+    currentTick++;
+    updateChecksums();
+}
+
+void RollbackSession::addRemoteInput(uint32_t tick, uint8_t bits) {
+    if (tick != remoteConfirmed || tick >= currentTick + HISTORY - MAX_ROLLBACK) {
+        return;
+    }
+    if (tick < currentTick && remoteInputs[tick % HISTORY] != bits && tick < firstMismatch) {
+        firstMismatch = tick;
+    }
+    remoteInputs[tick % HISTORY] = bits;
+    remoteConfirmed++;
+    
+    // A rollback is due anyway: re-predict the ticks after this one from the
+    // newest input, so the resimulation uses it and later arrivals are
+    // compared against what will actually be simulated
+    if (firstMismatch != UINT32_MAX) {
+        for (uint32_t t = remoteConfirmed; t < currentTick; t++) {
+            remoteInputs[t % HISTORY] = bits;
+        }
+    }
+}
+
+void RollbackSession::synchronize() {
+    if (firstMismatch >= currentTick) {
+        firstMismatch = UINT32_MAX;
+        return;
+    }
+    
+    TRACE_SCOPE("rollback");
+    uint64_t start = traceNow();
+    uint32_t from = firstMismatch;
+    firstMismatch = UINT32_MAX;
+    match = snapshots[from % HISTORY];
+    for (uint32_t t = from; t < currentTick; t++) {
+        simulate(t);
+    }
+    uint64_t elapsed = traceNow() - start;
+    
+    uint32_t length = currentTick - from;
+    rollbacks++;
+    resimulatedTicks += length;
+    if (length > longestRollback) longestRollback = length;
+    if (elapsed > slowestRollbackNs) slowestRollbackNs = elapsed;
+    updateChecksums();
+}
+
+void RollbackSession::simulate(uint32_t tick) {
+    snapshots[tick % HISTORY] = match;
+    
+    PaddleInput local, remote, unused;
+    unpackInputs(localInputs[tick % HISTORY], local, unused);
+    unpackInputs(remoteInputs[tick % HISTORY], remote, unused);
+    if (localPlayer == 1) {
+        match.tick(1.0f, local, remote);
+    } else {
+        match.tick(1.0f, remote, local);
+    }
+}
+
+void RollbackSession::updateChecksums() {
+    // Only states that no later correction can change
+    if (firstMismatch != UINT32_MAX) return;
+    uint32_t confirmed = remoteConfirmed < currentTick ? remoteConfirmed : currentTick;
+    while (nextChecksumTick <= confirmed) {
+        if (nextChecksumTick + HISTORY <= currentTick) {
+            // Fell out of the history while waiting; skip ahead
+            nextChecksumTick += CHECKSUM_INTERVAL;
+            continue;
+        }
+        const Match& state = nextChecksumTick == currentTick ? match : snapshots[nextChecksumTick % HISTORY];
+        uint64_t checksum = state.checksum();
+        int slot = (nextChecksumTick / CHECKSUM_INTERVAL) % 8;
+        checksumTicks[slot] = nextChecksumTick;
+        checksums[slot] = checksum;
+        lastChecksumTick = nextChecksumTick;
+        lastChecksum = checksum;
+        nextChecksumTick += CHECKSUM_INTERVAL;
+    }
+}
+
+bool RollbackSession::getChecksum(uint32_t tick, uint64_t& checksum) const {
+    int slot = (tick / CHECKSUM_INTERVAL) % 8;
+    if (tick % CHECKSUM_INTERVAL != 0 || checksumTicks[slot] != tick) {
+        return false;
+    }
+    checksum = checksums[slot];
+    return true;
+}
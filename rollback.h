@@ -0,0 +1,109 @@
+// Space Ping Pong - rollback for networked matches
+//
+// GGPO-style: the local player's input is applied immediately and the
+// remote player's is predicted (their last known input repeated). When the
+// real remote input for an earlier tick arrives and differs from what was
+// predicted, the match is restored from the snapshot taken before that tick
+// and the ticks since are simulated again with the corrected input. A
+// snapshot is a plain copy of the Match into a ring of preallocated
+// matches, so after the first laps it reuses their storage.
+//
+// The session never runs more than MAX_ROLLBACK ticks past the last remote
+// input it has; canAdvance() turns false and the caller waits for packets.
+// Every tick is one 1/FPS step: both peers must simulate identical steps.
+#pragma once
+
+#include "input_recording.h"
+#include "pingpong_sim.h"
+
+#include <cstdint>
+#include <vector>
+
+class RollbackSession {
+public:
+    static const uint32_t MAX_ROLLBACK = 8;
+    static const uint32_t HISTORY = 32;             // Ring size, > 2 * MAX_ROLLBACK
+    static const uint32_t CHECKSUM_INTERVAL = 60;   // Confirmed ticks between checksums
+    
+    explicit RollbackSession(Match& match);
+    
+    // Start the match from tick 0; both peers must use the same seed.
+    // localPlayer is 1 (right paddle) or 2 (left paddle).
+    void start(uint64_t seed, int localPlayer);
+    
+    bool canAdvance() const {
+        return currentTick < remoteConfirmed + MAX_ROLLBACK;
+    }
+    
+    // Roll back if needed, then simulate one tick with this local input
+    void advance(const PaddleInput& localInput);
+    
+    // Remote input for a tick; only the next unconfirmed tick is taken, so
+    // callers simply pass everything a packet carries in order
+    void addRemoteInput(uint32_t tick, uint8_t bits);
+    
+    // Apply any corrections that arrived without advancing
+    void synchronize();
+    
+    // Ticks simulated so far; the match shows the state after them
+    uint32_t getTick() const {
+        return currentTick;
+    }
+    
+    // Remote inputs known for every tick before this one
+    uint32_t getRemoteConfirmed() const {
+        return remoteConfirmed;
+    }
+    
+    // No tick shown so far rests on a prediction
+    bool isConfirmed() const {
+        return remoteConfirmed >= currentTick;
+    }
+    
+    // Local input of a tick still in the history, as packInputs() bits for
+    // this player alone (player 1 layout)
+    uint8_t getLocalInput(uint32_t tick) const {
+        return localInputs[tick % HISTORY];
+    }
+    
+    // Checksum of the confirmed state before a tick, if it was taken
+    bool getChecksum(uint32_t tick, uint64_t& checksum) const;
+    
+    // Newest confirmed checksum, for sending to the peer
+    uint32_t getChecksumTick() const {
+        return lastChecksumTick;
+    }
+    uint64_t getLastChecksum() const {
+        return lastChecksum;
+    }
+    
+    // Rollback statistics
+    long long getRollbacks() const { return rollbacks; }
+    long long getResimulatedTicks() const { return resimulatedTicks; }
+    uint32_t getLongestRollback() const { return longestRollback; }
+    uint64_t getSlowestRollbackNs() const { return slowestRollbackNs; }
+    
+private:
+    Match& match;
+    int localPlayer;
+    std::vector<Match> snapshots;   // State before tick t at t % HISTORY
+    uint8_t localInputs[HISTORY];
+    uint8_t remoteInputs[HISTORY];  // Confirmed, or as predicted when used
+    uint32_t currentTick;
+    uint32_t remoteConfirmed;
+    uint32_t firstMismatch;         // Earliest tick simulated with a wrong prediction
+    
+    uint32_t nextChecksumTick;
+    uint32_t lastChecksumTick;
+    uint64_t lastChecksum;
+    uint32_t checksumTicks[8];
+    uint64_t checksums[8];
+    
+    long long rollbacks;
+    long long resimulatedTicks;
+    uint32_t longestRollback;
+    uint64_t slowestRollbackNs;
+    
+    void simulate(uint32_t tick);
+    void updateChecksums();
+};
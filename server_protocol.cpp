@@ -0,0 +1,153 @@
+// Space Ping Pong - dedicated server protocol
+#include "server_protocol.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const uint8_t MAGIC[4] = {'S', 'P', 'S', 1};
+const size_t HEADER_SIZE = 5;
+
+// Velocities are sent in 1/256 pixel per frame
+const float VELOCITY_SCALE = 256.0f;
+
+}
+
+PacketWriter::PacketWriter(ServerPacket type) : bytes(MAGIC, MAGIC + 4) {
+    bytes.reserve(64);
+    bytes.push_back((uint8_t)type);
+}
+
+void PacketWriter::i16(float value) {
+    float clamped = std::max(-32768.0f, std::min(32767.0f, std::round(value)));
+    put((uint16_t)(int16_t)clamped, 2);
+}
+
+void PacketWriter::put(uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        bytes.push_back((uint8_t)(value >> (i * 8)));
+    }
+}
+
+PacketReader::PacketReader(const uint8_t* data, size_t size)
+    : data(data), size(size), offset(HEADER_SIZE), valid(false), type(ServerPacket::JOIN) {
+    if (size >= HEADER_SIZE && std::equal(MAGIC, MAGIC + 4, data) && data[4] <= (uint8_t)ServerPacket::STATS) {
+        valid = true;
+        type = (ServerPacket)data[4];
+    }
+}
+
+uint64_t PacketReader::get(int count) {
+    if (!valid || offset + count > size) {
+        valid = false;
+        return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value |= (uint64_t)data[offset + i] << (i * 8);
+    }
+    offset += count;
+    return value;
+}
+
+void writeAssignment(PacketWriter& packet, const SeatAssignment& assignment) {
+    packet.u32(assignment.nonce);
+    packet.u16(assignment.workerPort);
+    packet.u32(assignment.roomId);
+    packet.u8(assignment.slot);
+}
+
+bool readAssignment(PacketReader& packet, SeatAssignment& assignment) {
+    assignment.nonce = packet.u32();
+    assignment.workerPort = packet.u16();
+    assignment.roomId = packet.u32();
+    assignment.slot = packet.u8();
+    return packet.isValid() && (assignment.slot == 1 || assignment.slot == 2);
+}
+
+void writeState(PacketWriter& packet, uint32_t roomId, uint32_t tick, const Match& match) {
+    packet.u32(roomId);
+    packet.u32(tick);
+    packet.u8((uint8_t)match.player1Score);
+    packet.u8((uint8_t)match.player2Score);
+    packet.u8((match.over ? 1 : 0) | (match.freezeTimer > 0 ? 2 : 0));
+    packet.i16(match.paddle1.y);
+    packet.u16((uint16_t)match.paddle1.height);
+    packet.i16(match.paddle2.y);
+    packet.u16((uint16_t)match.paddle2.height);
+    
+    size_t ballCount = std::min(match.balls.size(), MAX_STATE_BALLS);
+    packet.u8((uint8_t)ballCount);
+    for (size_t i = 0; i < ballCount; i++) {
+        const Ball& ball = match.balls[i];
+        packet.i16(ball.x);
+        packet.i16(ball.y);
+        packet.i16(ball.velocity.x * VELOCITY_SCALE);
+        packet.i16(ball.velocity.y * VELOCITY_SCALE);
+    }
+    
+    size_t powerUpCount = std::min(match.powerUps.size(), MAX_STATE_POWER_UPS);
+    packet.u8((uint8_t)powerUpCount);
+    for (size_t i = 0; i < powerUpCount; i++) {
+        const PowerUp& powerUp = match.powerUps[i];
+        packet.i16(powerUp.x);
+        packet.i16(powerUp.y);
+        packet.u8((uint8_t)powerUp.powerType);
+    }
+}
+
+bool readState(PacketReader& packet, RoomState& state) {
+    state.roomId = packet.u32();
+    state.tick = packet.u32();
+    state.player1Score = packet.u8();
+    state.player2Score = packet.u8();
+    uint8_t flags = packet.u8();
+    state.over = (flags & 1) != 0;
+    state.frozen = (flags & 2) != 0;
+    state.paddle1Y = packet.i16();
+    state.paddle1Height = packet.u16();
+    state.paddle2Y = packet.i16();
+    state.paddle2Height = packet.u16();
+    
+    state.balls.resize(std::min<size_t>(packet.u8(), MAX_STATE_BALLS));
+    for (RoomState::BallState& ball : state.balls) {
+        ball.x = packet.i16();
+        ball.y = packet.i16();
+        ball.vx = packet.i16() / VELOCITY_SCALE;
+        ball.vy = packet.i16() / VELOCITY_SCALE;
+    }
+    
+    state.powerUps.resize(std::min<size_t>(packet.u8(), MAX_STATE_POWER_UPS));
+    for (RoomState::PowerUpState& powerUp : state.powerUps) {
+        powerUp.x = packet.i16();
+        powerUp.y = packet.i16();
+        powerUp.powerType = (PowerUpType)std::min<uint8_t>(packet.u8(), (uint8_t)PowerUpType::MAGNET);
+    }
+    return packet.isValid();
+}
+
+void writeStats(PacketWriter& packet, const ServerStats& stats) {
+    packet.u32(stats.workers);
+    packet.u32(stats.rooms);
+    packet.u32(stats.playingRooms);
+    packet.u64(stats.wallNs);
+    packet.u64(stats.cpuNs);
+    packet.u64(stats.roomBusyNs);
+    packet.u64(stats.roomTicks);
+    packet.u64(stats.statesSent);
+    packet.u64(stats.matchesFinished);
+}
+
+bool readStats(PacketReader& packet, ServerStats& stats) {
+    stats.workers = packet.u32();
+    stats.rooms = packet.u32();
+    stats.playingRooms = packet.u32();
+    stats.wallNs = packet.u64();
+    stats.cpuNs = packet.u64();
+    stats.roomBusyNs = packet.u64();
+    stats.roomTicks = packet.u64();
+    stats.statesSent = packet.u64();
+    stats.matchesFinished = packet.u64();
+    return packet.isValid();
+}
@@ -0,0 +1,129 @@
+// Space Ping Pong - dedicated server protocol
+//
+// A client asks the server's lobby port for a seat and is told its room,
+// its paddle and the port of the worker that runs the room. From then on it
+// sends its paddle input to that worker and gets the room's state back at
+// the server's send rate. Everything is one UDP datagram, little-endian,
+// starting with a 4-byte magic and a type byte. Positions are sent as whole
+// pixels and velocities in 1/256 pixel per frame.
+#pragma once
+
+#include "pingpong_sim.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class ServerPacket : uint8_t {
+    JOIN,           // Client to lobby: nonce
+    ASSIGN,         // Lobby to client: nonce, worker port, room, slot
+    FULL,           // Lobby to client: nonce; no room left
+    INPUT,          // Client to worker: room, slot, input bits
+    STATE,          // Worker to client: the room's match
+    LEAVE,          // Client to worker: room, slot
+    STATS_REQUEST,  // Anyone to lobby
+    STATS           // Lobby to client: ServerStats
+};
+
+// Most balls and power-ups one STATE carries
+const size_t MAX_STATE_BALLS = 32;
+const size_t MAX_STATE_POWER_UPS = 16;
+const size_t MAX_SERVER_PACKET = 512;
+
+class PacketWriter {
+public:
+    explicit PacketWriter(ServerPacket type);
+    
+    void u8(uint8_t value) { put(value, 1); }
+    void u16(uint16_t value) { put(value, 2); }
+    void u32(uint32_t value) { put(value, 4); }
+    void u64(uint64_t value) { put(value, 8); }
+    void i16(float value);  // Rounded and clamped
+    
+    const uint8_t* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    
+private:
+    std::vector<uint8_t> bytes;
+    
+    void put(uint64_t value, int count);
+};
+
+// Reading past the end yields zeros and makes the packet invalid
+class PacketReader {
+public:
+    PacketReader(const uint8_t* data, size_t size);
+    
+    bool isValid() const { return valid; }
+    ServerPacket getType() const { return type; }
+    
+    uint8_t u8() { return (uint8_t)get(1); }
+    uint16_t u16() { return (uint16_t)get(2); }
+    uint32_t u32() { return (uint32_t)get(4); }
+    uint64_t u64() { return get(8); }
+    int16_t i16() { return (int16_t)get(2); }
+    
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    bool valid;
+    ServerPacket type;
+    
+    uint64_t get(int count);
+};
+
+struct SeatAssignment {
+    uint32_t nonce;
+    uint16_t workerPort;
+    uint32_t roomId;
+    uint8_t slot;           // 1 plays the right paddle, 2 the left
+};
+
+struct RoomState {
+    struct BallState {
+        float x, y;
+        float vx, vy;
+    };
+    
+    struct PowerUpState {
+        float x, y;
+        PowerUpType powerType;
+    };
+    
+    uint32_t roomId;
+    uint32_t tick;
+    int player1Score;
+    int player2Score;
+    bool over;
+    bool frozen;
+    float paddle1Y, paddle2Y;
+    int paddle1Height, paddle2Height;
+    std::vector<BallState> balls;
+    std::vector<PowerUpState> powerUps;
+};
+
+// Totals since the server started, summed over workers
+struct ServerStats {
+    uint32_t workers;
+    uint32_t rooms;
+    uint32_t playingRooms;
+    uint64_t wallNs;
+    uint64_t cpuNs;         // Worker thread CPU time
+    uint64_t roomBusyNs;    // Time spent ticking and sending for rooms
+    uint64_t roomTicks;
+    uint64_t statesSent;
+    uint64_t matchesFinished;
+    
+    ServerStats() : workers(0), rooms(0), playingRooms(0), wallNs(0), cpuNs(0), roomBusyNs(0),
+                    roomTicks(0), statesSent(0), matchesFinished(0) {}
+};
+
+void writeAssignment(PacketWriter& packet, const SeatAssignment& assignment);
+bool readAssignment(PacketReader& packet, SeatAssignment& assignment);
+
+void writeState(PacketWriter& packet, uint32_t roomId, uint32_t tick, const Match& match);
+bool readState(PacketReader& packet, RoomState& state);
+
+void writeStats(PacketWriter& packet, const ServerStats& stats);
+bool readStats(PacketReader& packet, ServerStats& stats);
@@ -1,37 +1,64 @@
 #include <SDL3/SDL.h>
+#include "high_scores.h"
+#include "job_system.h"
+#include "input_recording.h"
+#include "lockfree.h"
+#include "netplay.h"
+#include "particle_system.h"
+#include "pingpong_sim.h"
+#include "random.h"
+#include "render_commands.h"
+#include "render_primitives.h"
+#include "replay_file.h"
+#include "trace.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 #include <iostream>
 #include <cmath>
 #include <random>
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+// Selectable simulation tick rates. Gameplay speeds and durations are tuned
+// per frame at FPS, so one tick advances them by FPS / tickRate frames.
+const int TICK_RATES[] = {60, 120, 240, 1000};
 
-// Game constants
-const int SCREEN_WIDTH = 1200;
-const int SCREEN_HEIGHT = 800;
-const int FPS = 60;
+// Rows on the high score screen
+const int HIGH_SCORE_ROWS = 10;
 
-// Colors
-struct Color {
-    Uint8 r, g, b, a;
-    Color(Uint8 r = 0, Uint8 g = 0, Uint8 b = 0, Uint8 a = 255) : r(r), g(g), b(b), a(a) {}
+// Particle colors, by ParticleSystem color index
+const Color PARTICLE_COLORS[] = {CYAN, GOLD, PURPLE, PINK};
+enum ParticleColor : Uint8 {
+    PARTICLE_CYAN,
+    PARTICLE_GOLD,
+    PARTICLE_PURPLE,
+    PARTICLE_PINK
 };
+const size_t MAX_PARTICLES = 65536;
+
+// Elements per job system chunk
+const size_t PARTICLE_DRAW_GRAIN = 4096;
+
+// How often an idle simulation looks for input instead of ticking
+const Uint64 SIM_IDLE_POLL_NS = 10 * SDL_NS_PER_MS;
 
-const Color BLACK(0, 0, 0);
-const Color WHITE(255, 255, 255);
-const Color CYAN(0, 255, 255);
-const Color GREEN(50, 205, 50);
-const Color RED(255, 69, 0);
-const Color PURPLE(138, 43, 226);
-const Color GOLD(255, 215, 0);
-const Color BLUE(100, 149, 237);
-const Color PINK(255, 20, 147);
-const Color ORANGE(255, 165, 0);
+// Longest idle wait between checks for a quit the simulation requested
+const Sint32 IDLE_WAIT_MS = 250;
 
 // Game states
 enum class GameState {
@@ -42,780 +69,1335 @@ enum class GameState {
     HIGH_SCORES
 };
 
-enum class Difficulty {
-    EASY,
-    MEDIUM,
-    HARD
-};
+// Linear interpolation between the previous and current simulation state
+inline float lerp(float from, float to, float t) {
+    return from + (to - from) * t;
+}
 
-enum class PowerUpType {
-    SPEED_BOOST,
-    PADDLE_GROW,
-    PADDLE_SHRINK,
-    MULTI_BALL,
-    SHIELD,
-    FREEZE,
-    LASER,
-    MAGNET
+// Region of the sprite atlas. Sprites are square and drawn centered on a pixel.
+struct AtlasRegion {
+    float u0, v0, u1, v1;
+    int w, h;           // Size in pixels
+    int radius;         // Centered sprites cover [-radius, radius]
+    int legacyCalls;    // SDL_RenderPoint calls the per-pixel helper used
+    
+    AtlasRegion() : u0(0), v0(0), u1(0), v1(0), w(0), h(0), radius(0), legacyCalls(0) {}
 };
 
-// Vector2D class
-class Vector2D {
+// Procedural sprite atlas
+//
+// Generated once at startup: filled discs and one-pixel outlines for every
+// radius up to MAX_RADIUS, rasterized with the same span/outline tables as
+// drawFilledCircle/drawCircle, plus a soft radial glow. Texels are white with
+// coverage in alpha so vertex colors tint them.
+class SpriteAtlas {
 public:
-    float x, y;
+    static const int MAX_RADIUS = 40;
+    static const int GLOW_RADIUS = 32;
     
-    Vector2D(float x = 0, float y = 0) : x(x), y(y) {}
+    SpriteAtlas() : texture(nullptr) {}
     
-    Vector2D operator+(const Vector2D& other) const {
-        return Vector2D(x + other.x, y + other.y);
+    ~SpriteAtlas() {
+        destroy();
     }
     
-    Vector2D operator-(const Vector2D& other) const {
-        return Vector2D(x - other.x, y - other.y);
+    bool build(SDL_Renderer* renderer) {
+        destroy();
+        
+        // Shelf-pack every sprite into a fixed-width sheet
+        const int sheetWidth = 512;
+        const int padding = 1;
+        std::vector<SDL_Rect> slots;
+        int penX = 0, penY = 0, shelfHeight = 0;
+        auto allocate = [&](int radius) {
+            int extent = radius * 2 + 1;
+            if (penX + extent > sheetWidth) {
+                penX = 0;
+                penY += shelfHeight + padding;
+                shelfHeight = 0;
+            }
+            slots.push_back({penX, penY, extent, extent});
+            penX += extent + padding;
+            shelfHeight = std::max(shelfHeight, extent);
+        };
+        
+        for (int r = 0; r <= MAX_RADIUS; r++) allocate(r);
+        for (int r = 0; r <= MAX_RADIUS; r++) allocate(r);
+        allocate(GLOW_RADIUS);
+        int sheetHeight = penY + shelfHeight;
+        
+        SDL_Surface* surface = SDL_CreateSurface(sheetWidth, sheetHeight, SDL_PIXELFORMAT_RGBA32);
+        if (!surface) {
+            return false;
+        }
+        SDL_FillSurfaceRect(surface, nullptr, 0);
+        
+        auto plot = [&](const SDL_Rect& slot, int px, int py, Uint8 alpha) {
+            Uint8* row = (Uint8*)surface->pixels + (slot.y + py) * surface->pitch;
+            Uint8* texel = row + (slot.x + px) * 4;
+            texel[0] = texel[1] = texel[2] = 255;
+            texel[3] = alpha;
+        };
+        
+        size_t slot = 0;
+        for (int r = 0; r <= MAX_RADIUS; r++, slot++) {
+            const std::vector<int>& spans = circleSpans(r);
+            int pixels = 0;
+            for (int dy = -r; dy <= r; dy++) {
+                int w = spans[dy + r];
+                for (int dx = -w; dx <= w; dx++) {
+                    plot(slots[slot], r + dx, r + dy, 255);
+                }
+                pixels += w * 2 + 1;
+            }
+            discs[r] = makeRegion(slots[slot], r, pixels, sheetWidth, sheetHeight);
+        }
+        for (int r = 0; r <= MAX_RADIUS; r++, slot++) {
+            for (const auto& offset : circleOutline(r)) {
+                plot(slots[slot], r + offset.dx, r + offset.dy, 255);
+            }
+            rings[r] = makeRegion(slots[slot], r, 360, sheetWidth, sheetHeight);
+        }
+        for (int dy = -GLOW_RADIUS; dy <= GLOW_RADIUS; dy++) {
+            for (int dx = -GLOW_RADIUS; dx <= GLOW_RADIUS; dx++) {
+                float d = std::sqrt((float)(dx * dx + dy * dy)) / GLOW_RADIUS;
+                if (d < 1.0f) {
+                    float falloff = (1.0f - d) * (1.0f - d);
+                    plot(slots[slot], GLOW_RADIUS + dx, GLOW_RADIUS + dy, (Uint8)(255 * falloff));
+                }
+            }
+        }
+        glowRegion = makeRegion(slots[slot], GLOW_RADIUS, 0, sheetWidth, sheetHeight);
+        
+        texture = SDL_CreateTextureFromSurface(renderer, surface);
+        SDL_DestroySurface(surface);
+        if (!texture) {
+            return false;
+        }
+        SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        return true;
     }
     
-    Vector2D operator*(float scalar) const {
-        return Vector2D(x * scalar, y * scalar);
+    void destroy() {
+        if (texture) {
+            SDL_DestroyTexture(texture);
+            texture = nullptr;
+        }
+    }
+    
+    SDL_Texture* getTexture() const {
+        return texture;
     }
     
-    float magnitude() const {
-        return std::sqrt(x * x + y * y);
+    const AtlasRegion& disc(int radius) const {
+        return discs[std::max(0, std::min(MAX_RADIUS, radius))];
     }
     
-    Vector2D normalize() const {
-        float mag = magnitude();
-        if (mag == 0) return Vector2D(0, 0);
-        return Vector2D(x / mag, y / mag);
+    const AtlasRegion& ring(int radius) const {
+        return rings[std::max(0, std::min(MAX_RADIUS, radius))];
     }
     
-    float dot(const Vector2D& other) const {
-        return x * other.x + y * other.y;
+    const AtlasRegion& glow() const {
+        return glowRegion;
+    }
+    
+private:
+    SDL_Texture* texture;
+    AtlasRegion discs[MAX_RADIUS + 1];
+    AtlasRegion rings[MAX_RADIUS + 1];
+    AtlasRegion glowRegion;
+    
+    static AtlasRegion makeRegion(const SDL_Rect& slot, int radius, int legacyCalls, int width, int height) {
+        AtlasRegion region;
+        region.u0 = (float)slot.x / width;
+        region.v0 = (float)slot.y / height;
+        region.u1 = (float)(slot.x + slot.w) / width;
+        region.v1 = (float)(slot.y + slot.h) / height;
+        region.w = slot.w;
+        region.h = slot.h;
+        region.radius = radius;
+        region.legacyCalls = legacyCalls;
+        return region;
     }
 };
 
-// Helper functions
-void drawCircle(SDL_Renderer* renderer, int x, int y, int radius) {
-    for (int i = 0; i < 360; i++) {
-        float angle = i * M_PI / 180.0f;
-        int px = x + radius * cos(angle);
-        int py = y + radius * sin(angle);
-        SDL_RenderPoint(renderer, px, py);
+// Batched textured quads
+//
+// Each sprite becomes a tinted, pixel-aligned textured quad recorded into the
+// frame's command buffer, which draws all quads of one texture, layer and
+// blend mode with a single SDL_RenderGeometry call - a whole layer of balls,
+// trails, power-ups or particles costs one draw call.
+class SpriteBatch {
+public:
+    SpriteBatch() : commands(nullptr), atlas(nullptr), legacyCalls(0) {}
+    
+    void setTarget(CommandBuffer* target, const SpriteAtlas* spriteAtlas) {
+        commands = target;
+        atlas = spriteAtlas;
     }
-}
-
-void drawFilledCircle(SDL_Renderer* renderer, int x, int y, int radius) {
-    for (int dy = -radius; dy <= radius; dy++) {
-        for (int dx = -radius; dx <= radius; dx++) {
-            if (dx * dx + dy * dy <= radius * radius) {
-                SDL_RenderPoint(renderer, x + dx, y + dy);
-            }
-        }
+    
+    const SpriteAtlas& getAtlas() const {
+        return *atlas;
     }
-}
-
-void drawLine(SDL_Renderer* renderer, int x1, int y1, int x2, int y2) {
-    int dx = abs(x2 - x1);
-    int dy = abs(y2 - y1);
-    int sx = x1 < x2 ? 1 : -1;
-    int sy = y1 < y2 ? 1 : -1;
-    int err = dx - dy;
-    
-    while (true) {
-        SDL_RenderPoint(renderer, x1, y1);
-        if (x1 == x2 && y1 == y2) break;
-        int e2 = 2 * err;
-        if (e2 > -dy) {
-            err -= dy;
-            x1 += sx;
-        }
-        if (e2 < dx) {
-            err += dx;
-            y1 += sy;
-        }
+    
+    // Queue an atlas sprite centered on pixel (x, y)
+    void draw(const AtlasRegion& region, int x, int y, const Color& color) {
+        drawRegion(atlas->getTexture(), region, x - region.radius, y - region.radius, color);
     }
-}
-
-// Simple text rendering functions
-void drawChar(SDL_Renderer* renderer, char c, int x, int y, int size, const Color& color) {
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    
-    // Simple 5x7 pixel font patterns
-    switch (c) {
-        case 'A':
-            drawLine(renderer, x, y+size*6, x+size*2, y);
-            drawLine(renderer, x+size*2, y, x+size*4, y+size*6);
-            drawLine(renderer, x+size, y+size*3, x+size*3, y+size*3);
-            break;
-        case 'B':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y+size*3, x+size*3, y+size*6);
-            break;
-        case 'C':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            break;
-        case 'D':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y, x+size*2, y);
-            drawLine(renderer, x, y+size*6, x+size*2, y+size*6);
-            drawLine(renderer, x+size*3, y+size, x+size*3, y+size*5);
-            drawLine(renderer, x+size*2, y, x+size*3, y+size);
-            drawLine(renderer, x+size*2, y+size*6, x+size*3, y+size*5);
-            break;
-        case 'E':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x, y+size*3, x+size*2, y+size*3);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            break;
-        case 'F':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x, y+size*3, x+size*2, y+size*3);
-            break;
-        case 'G':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*3, x+size*3, y+size*6);
-            drawLine(renderer, x+size*2, y+size*3, x+size*3, y+size*3);
-            break;
-        case 'H':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*6);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            break;
-        case 'I':
-            drawLine(renderer, x+size*1, y, x+size*2, y);
-            drawLine(renderer, x+size*1, y+size*6, x+size*2, y+size*6);
-            drawLine(renderer, x+size*1, y, x+size*1, y+size*6);
-            break;
-        case 'J':
-            drawLine(renderer, x+size*2, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*5);
-            drawLine(renderer, x+size*3, y+size*5, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x, y+size*5);
-            break;
-        case 'K':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*3, x+size*3, y);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*6);
-            break;
-        case 'L':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            break;
-        case 'M':
-            drawLine(renderer, x, y+size*6, x, y);
-            drawLine(renderer, x, y, x+size*2, y+size*3);
-            drawLine(renderer, x+size*2, y+size*3, x+size*4, y);
-            drawLine(renderer, x+size*4, y, x+size*4, y+size*6);
-            break;
-        case 'N':
-            drawLine(renderer, x, y+size*6, x, y);
-            drawLine(renderer, x, y, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x+size*3, y);
-            break;
-        case 'O':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x+size*3, y);
-            break;
-        case 'P':
-            drawLine(renderer, x, y+size*6, x, y);
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y+size*3, x, y+size*3);
-            break;
-        case 'Q':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x+size*3, y);
-            drawLine(renderer, x+size*2, y+size*4, x+size*4, y+size*6);
-            break;
-        case 'R':
-            drawLine(renderer, x, y+size*6, x, y);
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y+size*3, x, y+size*3);
-            drawLine(renderer, x+size*2, y+size*3, x+size*3, y+size*6);
-            break;
-        case 'S':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*3);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y+size*3, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x, y+size*6);
-            break;
-        case 'T':
-            drawLine(renderer, x+size*1, y, x+size*2, y);
-            drawLine(renderer, x+size*1, y, x+size*1, y+size*6);
-            break;
-        case 'U':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            break;
-        case 'V':
-            drawLine(renderer, x, y, x+size*1, y+size*6);
-            drawLine(renderer, x+size*1, y+size*6, x+size*2, y);
-            drawLine(renderer, x+size*2, y, x+size*3, y+size*6);
-            break;
-        case 'W':
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x+size*1, y+size*6, x+size*2, y+size*3);
-            drawLine(renderer, x+size*2, y+size*3, x+size*3, y+size*6);
-            drawLine(renderer, x+size*4, y, x+size*4, y+size*6);
-            break;
-        case 'X':
-            drawLine(renderer, x, y, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y, x, y+size*6);
-            break;
-        case 'Y':
-            drawLine(renderer, x, y, x+size*1, y+size*3);
-            drawLine(renderer, x+size*1, y+size*3, x+size*2, y+size*3);
-            drawLine(renderer, x+size*2, y+size*3, x+size*3, y);
-            drawLine(renderer, x+size*1, y+size*3, x+size*1, y+size*6);
-            break;
-        case 'Z':
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            break;
-        case '0':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x, y+size*6);
-            break;
-        case '1':
-            drawLine(renderer, x+size*1, y, x+size*2, y);
-            drawLine(renderer, x+size*1, y, x+size*1, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            break;
-        case '2':
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y+size*3, x, y+size*3);
-            drawLine(renderer, x, y+size*3, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            break;
-        case '3':
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x, y+size*6);
-            drawLine(renderer, x, y+size*3, x+size*2, y+size*3);
-            break;
-        case '4':
-            drawLine(renderer, x, y, x, y+size*3);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*6);
-            break;
-        case '5':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*3);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y+size*3, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x, y+size*6);
-            break;
-        case '6':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x+size*3, y+size*3);
-            drawLine(renderer, x+size*3, y+size*3, x, y+size*3);
-            break;
-        case '7':
-            drawLine(renderer, x, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*6);
-            break;
-        case '8':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x, y, x, y+size*6);
-            drawLine(renderer, x, y+size*6, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x+size*3, y);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            break;
-        case '9':
-            drawLine(renderer, x+size*3, y, x, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*6);
-            drawLine(renderer, x+size*3, y+size*6, x, y+size*6);
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            drawLine(renderer, x, y, x, y+size*3);
-            break;
-        case ' ':
-            // Space - do nothing
-            break;
-        case ':':
-            drawLine(renderer, x+size*1, y+size*2, x+size*1, y+size*2);
-            drawLine(renderer, x+size*1, y+size*4, x+size*1, y+size*4);
-            break;
-        case '-':
-            drawLine(renderer, x, y+size*3, x+size*3, y+size*3);
-            break;
-        case '.':
-            drawLine(renderer, x+size*1, y+size*5, x+size*1, y+size*5);
-            break;
-        case '!':
-            drawLine(renderer, x+size*1, y, x+size*1, y+size*4);
-            drawLine(renderer, x+size*1, y+size*6, x+size*1, y+size*6);
-            break;
-        case '?':
-            drawLine(renderer, x, y+size*2, x+size*2, y);
-            drawLine(renderer, x+size*2, y, x+size*3, y);
-            drawLine(renderer, x+size*3, y, x+size*3, y+size*2);
-            drawLine(renderer, x+size*3, y+size*2, x+size*2, y+size*3);
-            drawLine(renderer, x+size*1, y+size*5, x+size*1, y+size*5);
-            break;
+    
+    // Queue a region of any texture with its top-left corner at (x, y)
+    void drawRegion(SDL_Texture* source, const AtlasRegion& region, int x, int y, const Color& color) {
+        writeQuad(reserveQuads(source, 1), region, x, y, color);
+        legacyCalls += region.legacyCalls;
     }
-}
-
-void drawText(SDL_Renderer* renderer, const std::string& text, int x, int y, int size, const Color& color) {
-    int currentX = x;
-    for (char c : text) {
-        if (c != ' ') {
-            drawChar(renderer, c, currentX, y, size, color);
-        }
-        currentX += size * 5; // Space between characters
+    
+    // Append count quads of one texture and return their vertices for the
+    // caller to fill with writeQuad/writeSprite. Lets worker threads build
+    // disjoint parts of a batch without locking; the pointer is valid until
+    // the next call that records anything. Quads of any texture but the
+    // sprite atlas are text.
+    SDL_Vertex* reserveQuads(SDL_Texture* source, int count) {
+        CommandType type = source == atlas->getTexture() ? CommandType::GEOMETRY : CommandType::TEXT;
+        return commands->reserveQuads(source, count, type);
     }
-}
-
-// Particle class
-class Particle {
-public:
-    float x, y;
-    Vector2D velocity;
-    Color color;
-    int lifetime;
-    int maxLifetime;
-    int size;
     
-    Particle(float x, float y, const Color& color, const Vector2D& velocity, int lifetime = 60) 
-        : x(x), y(y), color(color), velocity(velocity), lifetime(lifetime), maxLifetime(lifetime) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_int_distribution<> sizeDist(2, 5);
-        size = sizeDist(gen);
+    static void writeQuad(SDL_Vertex* quad, const AtlasRegion& region, int x, int y, const Color& color) {
+        SDL_FColor tint = {color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f};
+        float left = (float)x;
+        float top = (float)y;
+        float right = (float)(x + region.w);
+        float bottom = (float)(y + region.h);
+        
+        quad[0] = {{left, top}, tint, {region.u0, region.v0}};
+        quad[1] = {{right, top}, tint, {region.u1, region.v0}};
+        quad[2] = {{right, bottom}, tint, {region.u1, region.v1}};
+        quad[3] = {{left, bottom}, tint, {region.u0, region.v1}};
     }
     
-    void update() {
-        x += velocity.x;
-        y += velocity.y;
-        lifetime--;
-        
-        // Fade out effect
-        float alpha = (float)lifetime / maxLifetime;
-        color.a = (Uint8)(255 * alpha);
+    // writeQuad for a sprite centered on pixel (x, y)
+    static void writeSprite(SDL_Vertex* quad, const AtlasRegion& region, int x, int y, const Color& color) {
+        writeQuad(quad, region, x - region.radius, y - region.radius, color);
+    }
+    
+    // For quads filled through reserveQuads
+    void addLegacyCalls(int calls) {
+        legacyCalls += calls;
     }
     
-    void draw(SDL_Renderer* renderer) const {
-        if (lifetime > 0) {
-            SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-            drawFilledCircle(renderer, (int)x, (int)y, size);
+    // Queue prebuilt quads (four vertices each) translated by (x, y)
+    void drawQuads(SDL_Texture* source, const std::vector<SDL_Vertex>& quads, int x, int y, int legacyCalls) {
+        if (quads.empty()) {
+            return;
+        }
+        
+        SDL_Vertex* vertices = reserveQuads(source, (int)quads.size() / 4);
+        for (size_t i = 0; i < quads.size(); i++) {
+            vertices[i] = quads[i];
+            vertices[i].position.x += x;
+            vertices[i].position.y += y;
         }
+        this->legacyCalls += legacyCalls;
     }
     
-    bool isAlive() const {
-        return lifetime > 0;
+    // SDL_RenderPoint calls the per-pixel helpers would have made
+    int getLegacyCalls() const {
+        return legacyCalls;
     }
+    
+    void resetStats() {
+        legacyCalls = 0;
+    }
+    
+private:
+    CommandBuffer* commands;
+    const SpriteAtlas* atlas;
+    int legacyCalls;
 };
 
-// Star class for background
-class Star {
+// Glyph atlas
+//
+// Glyphs are rasterized from their stroke shapes the first time a (glyph, size)
+// pair is drawn and uploaded into a shelf-packed texture. A full sheet is wiped
+// and refilled on demand; the generation counter tells cached layouts that the
+// texture coordinates they hold are stale. Glyphs recorded earlier in the
+// frame that triggers a refill show the refilled sheet for that one frame.
+class GlyphAtlas {
 public:
-    float x, y;
-    float speed;
-    int size;
-    int brightness;
+    static const int SHEET_SIZE = 512;
     
-    Star() {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_int_distribution<> xDist(0, SCREEN_WIDTH);
-        static std::uniform_int_distribution<> yDist(0, SCREEN_HEIGHT);
-        static std::uniform_real_distribution<> speedDist(0.1f, 1.0f);
-        static std::uniform_int_distribution<> sizeDist(1, 3);
-        static std::uniform_int_distribution<> brightnessDist(100, 255);
-        
-        x = xDist(gen);
-        y = yDist(gen);
-        speed = speedDist(gen);
-        size = sizeDist(gen);
-        brightness = brightnessDist(gen);
+    GlyphAtlas() : texture(nullptr), penX(0), penY(0), shelfHeight(0), generation(0) {}
+    
+    ~GlyphAtlas() {
+        destroy();
     }
     
-    void update() {
-        y += speed;
-        if (y > SCREEN_HEIGHT) {
-            y = 0;
-            static std::random_device rd;
-            static std::mt19937 gen(rd());
-            static std::uniform_int_distribution<> xDist(0, SCREEN_WIDTH);
-            x = xDist(gen);
+    bool init(SDL_Renderer* renderer) {
+        destroy();
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+                                    SHEET_SIZE, SHEET_SIZE);
+        if (!texture) {
+            return false;
+        }
+        SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        reset();
+        return true;
+    }
+    
+    void destroy() {
+        if (texture) {
+            SDL_DestroyTexture(texture);
+            texture = nullptr;
+        }
+        glyphs.clear();
+    }
+    
+    SDL_Texture* getTexture() const {
+        return texture;
+    }
+    
+    int getGeneration() const {
+        return generation;
+    }
+    
+    // Region of a glyph, or nullptr for glyphs without strokes (space, unknown)
+    const AtlasRegion* glyph(char c, int size) {
+        if (!texture || size <= 0 || glyphStrokes(c).empty()) {
+            return nullptr;
         }
+        
+        int key = size * 256 + (unsigned char)c;
+        auto it = glyphs.find(key);
+        if (it != glyphs.end()) {
+            return &it->second;
+        }
+        
+        // Every stroke stays inside the 4x6 cell, endpoints included
+        int w = size * 4 + 1;
+        int h = size * 6 + 1;
+        if (w > SHEET_SIZE || h > SHEET_SIZE) {
+            return nullptr;
+        }
+        if (penX + w > SHEET_SIZE) {
+            penX = 0;
+            penY += shelfHeight + 1;
+            shelfHeight = 0;
+        }
+        if (penY + h > SHEET_SIZE) {
+            reset();
+        }
+        
+        std::vector<Uint32> pixels(w * h, 0);
+        int plotted = 0;
+        for (const auto& stroke : glyphStrokes(c)) {
+            rasterizeLine(size * stroke.x1, size * stroke.y1, size * stroke.x2, size * stroke.y2,
+                          [&](int px, int py) {
+                Uint8* texel = (Uint8*)&pixels[py * w + px];
+                texel[0] = texel[1] = texel[2] = texel[3] = 255;
+                plotted++;
+            });
+        }
+        
+        SDL_Rect slot = {penX, penY, w, h};
+        SDL_UpdateTexture(texture, &slot, pixels.data(), w * 4);
+        penX += w + 1;
+        shelfHeight = std::max(shelfHeight, h);
+        
+        AtlasRegion& region = glyphs[key];
+        region.u0 = (float)slot.x / SHEET_SIZE;
+        region.v0 = (float)slot.y / SHEET_SIZE;
+        region.u1 = (float)(slot.x + w) / SHEET_SIZE;
+        region.v1 = (float)(slot.y + h) / SHEET_SIZE;
+        region.w = w;
+        region.h = h;
+        region.legacyCalls = plotted;
+        return &region;
     }
     
-    void draw(SDL_Renderer* renderer) const {
-        SDL_SetRenderDrawColor(renderer, brightness, brightness, brightness, 255);
-        drawFilledCircle(renderer, (int)x, (int)y, size);
+private:
+    SDL_Texture* texture;
+    std::unordered_map<int, AtlasRegion> glyphs;
+    int penX, penY, shelfHeight;
+    int generation;
+    
+    void reset() {
+        glyphs.clear();
+        penX = penY = shelfHeight = 0;
+        generation++;
     }
 };
 
-// PowerUp class
-class PowerUp {
+// Glyph quads of one string at one size and color, relative to its origin
+struct TextLayout {
+    std::vector<SDL_Vertex> quads;
+    int legacyCalls;
+    int generation;
+    
+    TextLayout() : legacyCalls(0), generation(-1) {}
+};
+
+// Atlas-backed text
+//
+// Produces the same pixels as drawText: glyphs advance by size * 5 and spaces
+// are skipped. Layouts are cached per (string, size, color), so a static string
+// costs one hash lookup and a vertex copy per frame instead of stroke
+// rasterization.
+class TextRenderer {
 public:
-    float x, y;
-    PowerUpType powerType;
-    int size;
-    int lifetime;
-    float floatOffset;
+    static const size_t MAX_LAYOUTS = 256;
     
-    PowerUp(float x, float y, PowerUpType type) 
-        : x(x), y(y), powerType(type), size(30), lifetime(300), floatOffset(0) {}
+    bool init(SDL_Renderer* renderer) {
+        layouts.clear();
+        return glyphs.init(renderer);
+    }
     
-    void update() {
-        lifetime--;
-        floatOffset += 0.1f;
-        y += std::sin(floatOffset) * 0.5f;
+    void destroy() {
+        layouts.clear();
+        glyphs.destroy();
     }
     
-    void draw(SDL_Renderer* renderer) const {
-        if (lifetime > 0) {
-            Color color;
-            switch (powerType) {
-                case PowerUpType::SPEED_BOOST: color = CYAN; break;
-                case PowerUpType::PADDLE_GROW: color = GREEN; break;
-                case PowerUpType::PADDLE_SHRINK: color = RED; break;
-                case PowerUpType::MULTI_BALL: color = PURPLE; break;
-                case PowerUpType::SHIELD: color = GOLD; break;
-                case PowerUpType::FREEZE: color = BLUE; break;
-                case PowerUpType::LASER: color = ORANGE; break;
-                case PowerUpType::MAGNET: color = PINK; break;
+    void buildLayout(const std::string& text, int size, const Color& color, TextLayout& layout) {
+        SDL_FColor tint = {color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f};
+        int generation = glyphs.getGeneration();
+        
+        layout.quads.clear();
+        layout.legacyCalls = 0;
+        int currentX = 0;
+        for (char c : text) {
+            const AtlasRegion* region = (c != ' ') ? glyphs.glyph(c, size) : nullptr;
+            if (glyphs.getGeneration() != generation) {
+                // The sheet was refilled mid-string; start over on the fresh one
+                buildLayout(text, size, color, layout);
+                return;
             }
-            
-            // Draw power-up with pulsing effect
-            float pulse = std::abs(std::sin(floatOffset * 2)) * 5 + size;
-            SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-            drawCircle(renderer, (int)x, (int)y, (int)pulse);
-            drawFilledCircle(renderer, (int)x, (int)y, size / 2);
+            if (region) {
+                float left = (float)currentX;
+                float right = (float)(currentX + region->w);
+                float bottom = (float)region->h;
+                layout.quads.push_back({{left, 0}, tint, {region->u0, region->v0}});
+                layout.quads.push_back({{right, 0}, tint, {region->u1, region->v0}});
+                layout.quads.push_back({{right, bottom}, tint, {region->u1, region->v1}});
+                layout.quads.push_back({{left, bottom}, tint, {region->u0, region->v1}});
+                layout.legacyCalls += region->legacyCalls;
+            }
+            currentX += size * 5;
         }
+        layout.generation = generation;
+    }
+    
+    bool isCurrent(const TextLayout& layout) const {
+        return layout.generation == glyphs.getGeneration();
+    }
+    
+    // Changes whenever the glyph sheet is refilled
+    int getGeneration() const {
+        return glyphs.getGeneration();
     }
     
-    bool isAlive() const {
-        return lifetime > 0;
+    void drawLayout(SpriteBatch& sprites, const TextLayout& layout, int x, int y) {
+        sprites.drawQuads(glyphs.getTexture(), layout.quads, x, y, layout.legacyCalls);
     }
     
-    SDL_FRect getRect() const {
-        return {x - size, y - size, size * 2, size * 2};
+    void draw(SpriteBatch& sprites, const std::string& text, int x, int y, int size, const Color& color) {
+        std::string key = text;
+        key.push_back('\0');
+        key.push_back((char)size);
+        key.append((const char*)&color, sizeof(Color));
+        
+        auto it = layouts.find(key);
+        if (it == layouts.end()) {
+            if (layouts.size() >= MAX_LAYOUTS) {
+                layouts.clear();
+            }
+            it = layouts.emplace(key, TextLayout()).first;
+        }
+        if (!isCurrent(it->second)) {
+            buildLayout(text, size, color, it->second);
+        }
+        drawLayout(sprites, it->second, x, y);
     }
     
-    bool operator==(const PowerUp& other) const {
-        return x == other.x && y == other.y && powerType == other.powerType;
+    void drawChar(SpriteBatch& sprites, char c, int x, int y, int size, const Color& color) {
+        const AtlasRegion* region = glyphs.glyph(c, size);
+        if (region) {
+            sprites.drawRegion(glyphs.getTexture(), *region, x, y, color);
+        }
     }
+    
+private:
+    GlyphAtlas glyphs;
+    std::unordered_map<std::string, TextLayout> layouts;
 };
 
-// Ball class
-class Ball {
+// Text that changes now and then, like a score. The layout is rebuilt only
+// when the content actually changed (or the glyph sheet was refilled).
+class TextLabel {
 public:
-    float x, y;
-    Vector2D velocity;
-    int size;
-    float baseSpeed;
-    float speedMultiplier;
-    std::vector<Vector2D> trail;
-    bool isMagnetic;
-    float magneticForce;
+    TextLabel(int size, const Color& color) : size(size), color(color), number(0), dirty(true) {}
     
-    Ball(float x, float y, float speed = 8.0f) 
-        : x(x), y(y), baseSpeed(speed), speedMultiplier(1.0f), size(8), 
-          isMagnetic(false), magneticForce(0.0f) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_real_distribution<> angleDist(-0.5, 0.5);
-        static std::uniform_int_distribution<> directionDist(0, 1);
-        
-        float direction = directionDist(gen) == 0 ? -1 : 1;
-        velocity = Vector2D(speed * direction, speed * angleDist(gen));
+    void setText(const std::string& value) {
+        if (value != text) {
+            text = value;
+            dirty = true;
+        }
     }
     
-    void update() {
-        x += velocity.x * speedMultiplier;
-        y += velocity.y * speedMultiplier;
-        
-        // Add to trail
-        trail.push_back(Vector2D(x, y));
-        if (trail.size() > 10) {
-            trail.erase(trail.begin());
+    void setNumber(int value) {
+        if (dirty || text.empty() || value != number) {
+            number = value;
+            setText(std::to_string(value));
         }
-        
-        // Wall collision
-        if (y <= size || y >= SCREEN_HEIGHT - size) {
-            velocity.y *= -1;
-            y = std::max((float)size, std::min((float)(SCREEN_HEIGHT - size), y));
+    }
+    
+    void draw(TextRenderer& renderer, SpriteBatch& sprites, int x, int y) {
+        if (dirty || !renderer.isCurrent(layout)) {
+            renderer.buildLayout(text, size, color, layout);
+            dirty = false;
         }
+        renderer.drawLayout(sprites, layout, x, y);
     }
     
-    bool paddleCollision(const SDL_FRect& paddleRect, float paddleCenterY) {
-        SDL_FRect ballRect = getRect();
-        if (SDL_HasRectIntersectionFloat(&ballRect, &paddleRect)) {
-            // Calculate hit position relative to paddle center
-            float hitPos = (y - paddleCenterY) / (paddleRect.h / 2);
-            hitPos = std::max(-1.0f, std::min(1.0f, hitPos));
-            
-            // Reverse horizontal direction
-            velocity.x *= -1;
-            
-            // Adjust vertical velocity based on hit position
-            velocity.y = hitPos * baseSpeed * 0.75f;
-            
-            // Increase speed slightly
-            float currentSpeed = velocity.magnitude();
-            if (currentSpeed < baseSpeed * 2) {
-                velocity = velocity * 1.05f;
-            }
-            
-            // Move ball away from paddle
-            if (paddleRect.x < SCREEN_WIDTH / 2) {
-                x = paddleRect.x + paddleRect.w + size;
-            } else {
-                x = paddleRect.x - size;
+    const std::string& getText() const {
+        return text;
+    }
+    
+private:
+    std::string text;
+    int size;
+    Color color;
+    int number;
+    bool dirty;
+    TextLayout layout;
+};
+
+// One layer of the starfield
+struct StarLayerStyle {
+    float share;            // Of all stars; the nearest layer takes the rest
+    float speed;            // Pixels per 60 Hz frame
+    int minRadius, maxRadius;
+    int minBrightness, maxBrightness;
+    float twinkleDepth;     // Fraction of brightness the wave takes away
+    float twinkleRate;      // Radians per 60 Hz frame
+};
+
+// Far to near
+const StarLayerStyle STAR_LAYERS[] = {
+    {0.6f, 0.15f, 0, 1, 90, 170, 0.35f, 0.11f},
+    {0.3f, 0.45f, 1, 1, 130, 220, 0.25f, 0.07f},
+    {0.1f, 1.0f, 1, 3, 180, 255, 0.15f, 0.05f}
+};
+
+// Parallax starfield
+//
+// The background is three layers of stars, far to near, each pre-rendered
+// once into a screen-sized band of one texture that wraps around vertically.
+// A frame scrolls every layer by its own speed and draws it as two textured
+// quads split at the wrap point, so all layers cost one draw call of six
+// quads however many stars they hold. Twinkle is a slow brightness wave per
+// layer, applied through the quads' vertex color.
+class Starfield {
+public:
+    static const int LAYERS = sizeof(STAR_LAYERS) / sizeof(STAR_LAYERS[0]);
+    
+    Starfield() : texture(nullptr), offsets(), phases() {}
+    
+    ~Starfield() {
+        destroy();
+    }
+    
+    // Scatter count stars over the layers and render them
+    bool build(SDL_Renderer* renderer, uint64_t seed, size_t count) {
+        destroy();
+        SDL_Surface* surface = SDL_CreateSurface(SCREEN_WIDTH, SCREEN_HEIGHT * LAYERS, SDL_PIXELFORMAT_RGBA32);
+        if (!surface) {
+            return false;
+        }
+        SDL_FillSurfaceRect(surface, nullptr, 0);
+        
+        Random rng(seed, COSMETIC_STREAM);
+        size_t remaining = count;
+        for (int layer = 0; layer < LAYERS; layer++) {
+            const StarLayerStyle& style = STAR_LAYERS[layer];
+            size_t stars = layer == LAYERS - 1 ? remaining : (size_t)(count * style.share);
+            remaining -= stars;
+            for (size_t i = 0; i < stars; i++) {
+                int x = rng.range(0, SCREEN_WIDTH - 1);
+                int y = rng.range(0, SCREEN_HEIGHT - 1);
+                int radius = rng.range(style.minRadius, style.maxRadius);
+                Uint8 brightness = (Uint8)rng.range(style.minBrightness, style.maxBrightness);
+                plotStar(surface, layer, x, y, radius, brightness);
             }
-            
-            return true;
+            offsets[layer] = 0;
+            phases[layer] = layer * 2.1f;
         }
-        return false;
+        
+        texture = SDL_CreateTextureFromSurface(renderer, surface);
+        SDL_DestroySurface(surface);
+        if (!texture) {
+            return false;
+        }
+        SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        return true;
     }
     
-    void resetPosition(int direction = 0) {
-        x = SCREEN_WIDTH / 2;
-        y = SCREEN_HEIGHT / 2;
-        
-        if (direction == 0) {
-            static std::random_device rd;
-            static std::mt19937 gen(rd());
-            static std::uniform_int_distribution<> directionDist(0, 1);
-            direction = directionDist(gen) == 0 ? -1 : 1;
+    void destroy() {
+        if (texture) {
+            SDL_DestroyTexture(texture);
+            texture = nullptr;
         }
-        
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_real_distribution<> angleDist(-0.5, 0.5);
-        
-        velocity = Vector2D(baseSpeed * direction, baseSpeed * angleDist(gen));
-        speedMultiplier = 1.0f;
-        trail.clear();
-        isMagnetic = false;
-        magneticForce = 0.0f;
     }
     
-    SDL_FRect getRect() const {
-        return {x - size, y - size, size * 2, size * 2};
+    // Scroll and twinkle; step is in 60 Hz frames
+    void update(float step) {
+        for (int layer = 0; layer < LAYERS; layer++) {
+            offsets[layer] = std::fmod(offsets[layer] + STAR_LAYERS[layer].speed * step, (float)SCREEN_HEIGHT);
+            phases[layer] = std::fmod(phases[layer] + STAR_LAYERS[layer].twinkleRate * step, 2 * (float)M_PI);
+        }
     }
     
-    void draw(SDL_Renderer* renderer) const {
-        // Draw trail
-        for (size_t i = 0; i < trail.size(); i++) {
-            float alpha = (float)i / trail.size() * 0.3f;
-            SDL_SetRenderDrawColor(renderer, CYAN.r, CYAN.g, CYAN.b, (Uint8)(255 * alpha));
-            drawFilledCircle(renderer, (int)trail[i].x, (int)trail[i].y, size);
+    void draw(CommandBuffer& commands) const {
+        if (!texture) {
+            return;
         }
         
-        // Draw ball
-        Color ballColor = isMagnetic ? PINK : WHITE;
-        SDL_SetRenderDrawColor(renderer, ballColor.r, ballColor.g, ballColor.b, ballColor.a);
-        drawFilledCircle(renderer, (int)x, (int)y, size);
-        SDL_SetRenderDrawColor(renderer, CYAN.r, CYAN.g, CYAN.b, CYAN.a);
-        drawCircle(renderer, (int)x, (int)y, size);
+        SDL_Vertex* quads = commands.reserveQuads(texture, LAYERS * 2);
+        for (int layer = 0; layer < LAYERS; layer++) {
+            const StarLayerStyle& style = STAR_LAYERS[layer];
+            float wave = 0.5f + 0.5f * std::sin(phases[layer]);
+            float alpha = 1.0f - style.twinkleDepth * wave;
+            SDL_FColor tint = {1, 1, 1, alpha};
+            
+            // The band's last rows come in at the top as it scrolls down
+            int offset = (int)offsets[layer];
+            int band = layer * SCREEN_HEIGHT;
+            writeStrip(quads + layer * 8, 0, offset, band + SCREEN_HEIGHT - offset, tint);
+            writeStrip(quads + layer * 8 + 4, offset, SCREEN_HEIGHT - offset, band, tint);
+        }
+    }
+    
+private:
+    SDL_Texture* texture;
+    float offsets[LAYERS];      // Scroll of each layer, in pixels
+    float phases[LAYERS];       // Of each layer's twinkle wave
+    
+    // Filled disc, white with brightness in alpha, wrapping at the band edges
+    static void plotStar(SDL_Surface* surface, int layer, int x, int y, int radius, Uint8 brightness) {
+        const std::vector<int>& spans = circleSpans(radius);
+        for (int dy = -radius; dy <= radius; dy++) {
+            int py = ((y + dy) % SCREEN_HEIGHT + SCREEN_HEIGHT) % SCREEN_HEIGHT + layer * SCREEN_HEIGHT;
+            Uint8* row = (Uint8*)surface->pixels + py * surface->pitch;
+            int w = spans[dy + radius];
+            for (int dx = -w; dx <= w; dx++) {
+                int px = ((x + dx) % SCREEN_WIDTH + SCREEN_WIDTH) % SCREEN_WIDTH;
+                Uint8* texel = row + px * 4;
+                texel[0] = texel[1] = texel[2] = 255;
+                texel[3] = std::max(texel[3], brightness);
+            }
+        }
+    }
+    
+    // Screen rows [y, y + height) showing texture rows from sourceY down
+    static void writeStrip(SDL_Vertex* quad, int y, int height, int sourceY, const SDL_FColor& tint) {
+        float textureHeight = (float)(SCREEN_HEIGHT * LAYERS);
+        float top = (float)y;
+        float bottom = (float)(y + height);
+        float v0 = sourceY / textureHeight;
+        float v1 = (sourceY + height) / textureHeight;
+        quad[0] = {{0, top}, tint, {0, v0}};
+        quad[1] = {{(float)SCREEN_WIDTH, top}, tint, {1, v0}};
+        quad[2] = {{(float)SCREEN_WIDTH, bottom}, tint, {1, v1}};
+        quad[3] = {{0, bottom}, tint, {0, v1}};
     }
 };
 
-// Paddle class
-class Paddle {
-public:
-    float x, y;
-    int width;
-    int baseHeight;
-    int height;
-    float speed;
-    bool isPlayer;
-    std::map<PowerUpType, int> effects;
+// Render snapshots
+//
+// The simulation runs on its own thread and publishes what the render
+// thread needs into a triple buffer: positions, resolved colors, HUD numbers
+// and the game state. Drawing reads nothing but the newest snapshot, so
+// neither thread ever waits on the other.
+
+struct PaddleView {
+    float x, y, prevY;
+    int width, height;
+    Color color;
     bool shieldActive;
-    int shieldDuration;
     bool laserActive;
-    int laserDuration;
     float laserY;
+};
+
+struct BallView {
+    float x, y, prevX, prevY;
+    int size;
+    Color color;
+    size_t trailStart;      // Into RenderSnapshot::trail
+    size_t trailLength;
+};
+
+struct PowerUpView {
+    int x, y;
+    int size;
+    float pulse;            // Ring radius
+    Color color;
+};
+
+enum class NetplayStatus {
+    OFF,
+    WAITING,                // Hosting, no peer yet
+    CONNECTING,
+    RUNNING,
+    LOST
+};
+
+struct RenderSnapshot {
+    GameState state;
+    Uint64 tick;            // Simulation ticks so far
+    Uint64 tickEndNs;       // SDL_GetTicksNS() time the last tick stands for
+    Uint64 tickNs;          // Length of one tick
+    Uint64 publishNs;       // When this snapshot was published
     
-    Paddle(float x, float y, bool isPlayer = true) 
-        : x(x), y(y), width(15), baseHeight(100), height(baseHeight), speed(8), 
-          isPlayer(isPlayer), shieldActive(false), shieldDuration(0),
-          laserActive(false), laserDuration(0), laserY(0) {}
-    
-    void update(const bool* keys, const Ball* ball = nullptr, Difficulty difficulty = Difficulty::MEDIUM) {
-        // Update effects
-        for (auto it = effects.begin(); it != effects.end();) {
-            it->second--;
-            if (it->second <= 0) {
-                removeEffect(it->first);
-                it = effects.erase(it);
-            } else {
-                ++it;
-            }
+    PaddleView paddles[2];
+    std::vector<BallView> balls;
+    std::vector<Vector2D> trail;
+    std::vector<PowerUpView> powerUps;
+    bool frozen;
+    float shakeX, shakeY;
+    float menuTime;
+    float menuPulse;
+    
+    // Live particles, structure-of-arrays like ParticleSystem
+    std::vector<float> particleX, particleY, particlePrevX, particlePrevY, particleFade;
+    std::vector<Uint8> particleColor, particleSize;
+    
+    // HUD
+    int player1Score;
+    int player2Score;
+    Difficulty difficulty;
+    int tickRate;
+    bool online;
+    NetplayStatus netplayStatus;
+    bool desynced;
+    std::vector<HighScore> highScores;  // The best HIGH_SCORE_ROWS
+    uint64_t highScoreCount;
+    int highScoreRank;                  // Of the last match, -1 if it did not place
+    double ticksPerSecond;              // Simulation rate over the last second
+    Uint64 inputLatencyP50;             // Input to simulation over the last second, ns
+    Uint64 inputLatencyP99;
+    
+    RenderSnapshot() : state(GameState::MENU), tick(0), tickEndNs(0), tickNs(1), publishNs(0), paddles(),
+                       frozen(false), shakeX(0), shakeY(0), menuTime(0), menuPulse(0), player1Score(0),
+                       player2Score(0), difficulty(Difficulty::MEDIUM), tickRate(FPS), online(false),
+                       netplayStatus(NetplayStatus::OFF), desynced(false), highScoreCount(0), highScoreRank(-1),
+                       ticksPerSecond(0), inputLatencyP50(0), inputLatencyP99(0) {}
+};
+
+// Input forwarded from the main thread to the simulation thread
+struct InputMessage {
+    enum Type {
+        KEY,                // A key press the simulation acts on
+        PADDLES             // The held paddle keys changed
+    };
+    
+    Type type;
+    SDL_Keycode key;
+    Uint8 paddles;          // packInputs() of both players' held keys
+    Uint64 timeNs;          // When it happened, SDL_GetTicksNS() time
+};
+
+// Views of simulation objects, built on the simulation thread
+
+Color powerUpColor(PowerUpType type) {
+    switch (type) {
+        case PowerUpType::SPEED_BOOST: return CYAN;
+        case PowerUpType::PADDLE_GROW: return GREEN;
+        case PowerUpType::PADDLE_SHRINK: return RED;
+        case PowerUpType::MULTI_BALL: return PURPLE;
+        case PowerUpType::SHIELD: return GOLD;
+        case PowerUpType::FREEZE: return BLUE;
+        case PowerUpType::LASER: return ORANGE;
+        case PowerUpType::MAGNET: return PINK;
+    }
+    return Color();
+}
+
+PaddleView makePaddleView(const Paddle& paddle) {
+    PaddleView view;
+    view.x = paddle.x;
+    view.y = paddle.y;
+    view.prevY = paddle.prevY;
+    view.width = paddle.width;
+    view.height = paddle.height;
+    view.color = WHITE;
+    if (paddle.effects.find(PowerUpType::PADDLE_GROW) != paddle.effects.end()) {
+        view.color = GREEN;
+    } else if (paddle.effects.find(PowerUpType::PADDLE_SHRINK) != paddle.effects.end()) {
+        view.color = RED;
+    }
+    view.shieldActive = paddle.shieldActive;
+    view.laserActive = paddle.laserActive;
+    view.laserY = paddle.laserY;
+    return view;
+}
+
+// Appends the ball's trail to trail
+BallView makeBallView(const Ball& ball, std::vector<Vector2D>& trail) {
+    BallView view;
+    view.x = ball.x;
+    view.y = ball.y;
+    view.prevX = ball.prevX;
+    view.prevY = ball.prevY;
+    view.size = ball.size;
+    view.color = ball.isMagnetic ? PINK : WHITE;
+    view.trailStart = trail.size();
+    view.trailLength = ball.trail.size();
+    trail.insert(trail.end(), ball.trail.begin(), ball.trail.end());
+    return view;
+}
+
+PowerUpView makePowerUpView(const PowerUp& powerUp) {
+    PowerUpView view;
+    view.x = (int)powerUp.x;
+    view.y = (int)powerUp.y;
+    view.size = powerUp.size;
+    view.pulse = std::abs(std::sin(powerUp.floatOffset * 2)) * 5 + powerUp.size;
+    view.color = powerUpColor(powerUp.powerType);
+    return view;
+}
+
+// Rendering of simulation objects
+
+void drawPowerUp(SpriteBatch& sprites, const PowerUpView& powerUp) {
+    // Draw power-up with pulsing effect
+    const Color& color = powerUp.color;
+    const SpriteAtlas& atlas = sprites.getAtlas();
+    sprites.draw(atlas.glow(), powerUp.x, powerUp.y, Color(color.r, color.g, color.b, 80));
+    sprites.draw(atlas.ring((int)powerUp.pulse), powerUp.x, powerUp.y, color);
+    sprites.draw(atlas.disc(powerUp.size / 2), powerUp.x, powerUp.y, color);
+}
+
+void drawBall(SpriteBatch& sprites, const BallView& ball, const Vector2D* trail, float alpha) {
+    const SpriteAtlas& atlas = sprites.getAtlas();
+    
+    // Draw trail
+    for (size_t i = 0; i < ball.trailLength; i++) {
+        float fade = (float)i / ball.trailLength * 0.3f;
+        Color trailColor(CYAN.r, CYAN.g, CYAN.b, (Uint8)(255 * fade));
+        sprites.draw(atlas.disc(ball.size), (int)trail[i].x, (int)trail[i].y, trailColor);
+    }
+    
+    // Draw ball
+    int drawX = (int)lerp(ball.prevX, ball.x, alpha);
+    int drawY = (int)lerp(ball.prevY, ball.y, alpha);
+    sprites.draw(atlas.disc(ball.size), drawX, drawY, ball.color);
+    sprites.draw(atlas.ring(ball.size), drawX, drawY, CYAN);
+}
+
+// Menu title, cycling through the rainbow
+const std::string MENU_TITLE = "SPACE PING PONG SDL3";
+const Color TITLE_COLORS[] = {
+    Color(255, 100, 100), Color(255, 150, 0), Color(255, 255, 0),
+    Color(100, 255, 100), Color(100, 150, 255), Color(150, 100, 255),
+    Color(255, 100, 255)
+};
+const int TITLE_STEPS = sizeof(TITLE_COLORS) / sizeof(TITLE_COLORS[0]);
+
+void drawPaddle(CommandBuffer& commands, const PaddleView& paddle, float alpha) {
+    float drawY = lerp(paddle.prevY, paddle.y, alpha);
+    SDL_FRect rect = {paddle.x, drawY, (float)paddle.width, (float)paddle.height};
+    commands.setColor(paddle.color);
+    commands.fillRect(rect);
+    
+    // Draw shield effect
+    if (paddle.shieldActive) {
+        SDL_FRect shieldRect = {paddle.x - 5, drawY - 5, (float)(paddle.width + 10), (float)(paddle.height + 10)};
+        commands.setColor(GOLD);
+        commands.rect(shieldRect);
+    }
+    
+    // Draw laser, the one-pixel line drawLine would rasterize
+    if (paddle.laserActive) {
+        int right = (int)paddle.x;
+        int left = (int)(paddle.x - 200);
+        SDL_FRect laserRect = {(float)left, (float)(int)paddle.laserY, (float)(right - left + 1), 1};
+        commands.setColor(ORANGE);
+        commands.fillRect(laserRect);
+    }
+}
+
+// Process CPU time (user + kernel) in nanoseconds
+Uint64 processCpuTimeNS() {
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return (kernel.QuadPart + user.QuadPart) * 100;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (Uint64)ts.tv_sec * SDL_NS_PER_SECOND + ts.tv_nsec;
+#endif
+}
+
+// CPU time as a percentage of wall time, of one core
+double cpuPercent(Uint64 cpuNs, Uint64 wallNs) {
+    return wallNs > 0 ? 100.0 * cpuNs / wallNs : 0;
+}
+
+enum class PacingMode {
+    VSYNC,          // Block in SDL_RenderPresent on the display refresh
+    ADAPTIVE_VSYNC, // Like VSYNC, but late frames tear instead of waiting
+    SLEEP,          // Sleep, then spin to a nanosecond deadline at the target rate
+    UNCAPPED        // No waiting at all, for benchmarking
+};
+
+const char* pacingModeName(PacingMode mode) {
+    switch (mode) {
+        case PacingMode::VSYNC: return "VSYNC";
+        case PacingMode::ADAPTIVE_VSYNC: return "ADAPTIVE";
+        case PacingMode::SLEEP: return "SLEEP";
+        case PacingMode::UNCAPPED: return "UNCAPPED";
+    }
+    return "";
+}
+
+// Summary of the last reporting window
+struct PacingReport {
+    double frameMs;         // Mean frame time
+    double jitterP99Ms;     // 99th percentile of |frame time - target|
+    double jitterMaxMs;
+    double cpuPercent;      // Process CPU time over wall time, of one core
+    
+    PacingReport() : frameMs(0), jitterP99Ms(0), jitterMaxMs(0), cpuPercent(0) {}
+};
+
+// Frame pacer
+//
+// Decides when the next frame starts. In SLEEP mode it sleeps until shortly
+// before the deadline and spins the rest of the way; the spin margin follows
+// the worst oversleep seen recently, so the spin stays as short as the OS
+// timer allows. Deadlines advance by a fixed period, so an early or late frame
+// doesn't shift the ones after it. Frame times and CPU usage are summarized
+// once per second.
+class FramePacer {
+public:
+    FramePacer() : renderer(nullptr), mode(PacingMode::SLEEP), period(SDL_NS_PER_SECOND / FPS),
+                   deadline(0), lastFrameStart(0), spinMargin(SDL_NS_PER_MS), oversleep(0),
+                   windowStart(0), windowCpuStart(0) {}
+    
+    // Falls back to SLEEP when the renderer can't do the requested vsync
+    void configure(SDL_Renderer* target, PacingMode requested, int targetFps) {
+        renderer = target;
+        mode = requested;
+        period = SDL_NS_PER_SECOND / std::max(1, targetFps);
+        
+        int vsync = SDL_RENDERER_VSYNC_DISABLED;
+        if (mode == PacingMode::VSYNC) vsync = 1;
+        if (mode == PacingMode::ADAPTIVE_VSYNC) vsync = SDL_RENDERER_VSYNC_ADAPTIVE;
+        if (!SDL_SetRenderVSync(renderer, vsync)) {
+            SDL_SetRenderVSync(renderer, SDL_RENDERER_VSYNC_DISABLED);
+            mode = PacingMode::SLEEP;
         }
         
-        // Update shield
-        if (shieldDuration > 0) {
-            shieldDuration--;
-            if (shieldDuration <= 0) {
-                shieldActive = false;
+        deadline = 0;
+        samples.clear();
+    }
+    
+    PacingMode getMode() const {
+        return mode;
+    }
+    
+    // Block until the next frame is due and return its start time
+    Uint64 waitForFrame() {
+        Uint64 now = SDL_GetTicksNS();
+        if (mode == PacingMode::SLEEP) {
+            if (deadline == 0 || now > deadline + period) {
+                // First frame, or more than a whole frame behind: resync
+                deadline = now;
             }
+            
+            if (deadline > now + spinMargin) {
+                Uint64 wake = deadline - spinMargin;
+                SDL_DelayNS(wake - now);
+                now = SDL_GetTicksNS();
+                trackOversleep(now > wake ? now - wake : 0);
+            }
+            while (now < deadline) {
+                SDL_CPUPauseInstruction();
+                now = SDL_GetTicksNS();
+            }
+            deadline += period;
         }
         
-        // Update laser
-        if (laserDuration > 0) {
-            laserDuration--;
-            if (laserDuration <= 0) {
-                laserActive = false;
-            }
+        recordFrame(now);
+        return now;
+    }
+    
+    // Report for the last completed window; empty until one second has passed
+    const PacingReport& getReport() const {
+        return report;
+    }
+    
+private:
+    static const size_t WINDOW_FRAMES = 1024;
+    
+    SDL_Renderer* renderer;
+    PacingMode mode;
+    Uint64 period;
+    Uint64 deadline;
+    Uint64 lastFrameStart;
+    Uint64 spinMargin;
+    Uint64 oversleep;
+    Uint64 windowStart;
+    Uint64 windowCpuStart;
+    std::vector<Uint64> samples;
+    PacingReport report;
+    
+    void trackOversleep(Uint64 late) {
+        // Decay the worst case slowly so one hiccup doesn't pin the margin
+        oversleep = std::max(late, oversleep - oversleep / 64);
+        const Uint64 minMargin = 200 * SDL_NS_PER_US;
+        const Uint64 maxMargin = 4 * SDL_NS_PER_MS;
+        Uint64 margin = oversleep + oversleep / 2 + 100 * SDL_NS_PER_US;
+        spinMargin = std::max(minMargin, std::min(maxMargin, margin));
+    }
+    
+    void recordFrame(Uint64 now) {
+        if (lastFrameStart != 0 && samples.size() < WINDOW_FRAMES) {
+            samples.push_back(now - lastFrameStart);
         }
+        lastFrameStart = now;
         
-        // Player movement
-        if (isPlayer && keys) {
-            if (keys[SDL_SCANCODE_UP] && y > 0) {
-                y -= speed;
-            }
-            if (keys[SDL_SCANCODE_DOWN] && y < SCREEN_HEIGHT - height) {
-                y += speed;
-            }
+        if (windowStart == 0) {
+            windowStart = now;
+            windowCpuStart = processCpuTimeNS();
+            return;
         }
-        // AI movement
-        else if (!isPlayer && ball) {
-            aiMove(ball, difficulty);
+        if (now - windowStart < SDL_NS_PER_SECOND || samples.empty()) {
+            return;
         }
         
-        // Keep paddle within bounds
-        y = std::max(0.0f, std::min((float)(SCREEN_HEIGHT - height), y));
+        Uint64 cpuNow = processCpuTimeNS();
+        double total = 0;
+        for (Uint64 sample : samples) {
+            total += sample;
+        }
+        double mean = total / samples.size();
+        
+        // Paced modes are judged against their period; vsync and uncapped
+        // frames against their own mean
+        double target = (mode == PacingMode::SLEEP) ? (double)period : mean;
+        std::vector<double> deviations;
+        deviations.reserve(samples.size());
+        for (Uint64 sample : samples) {
+            deviations.push_back(std::abs((double)sample - target));
+        }
+        size_t p99 = (deviations.size() * 99) / 100;
+        p99 = std::min(p99, deviations.size() - 1);
+        std::nth_element(deviations.begin(), deviations.begin() + p99, deviations.end());
+        
+        report.frameMs = mean / SDL_NS_PER_MS;
+        report.jitterP99Ms = deviations[p99] / SDL_NS_PER_MS;
+        report.jitterMaxMs = *std::max_element(deviations.begin(), deviations.end()) / SDL_NS_PER_MS;
+        report.cpuPercent = 100.0 * (cpuNow - windowCpuStart) / (now - windowStart);
+        
+        samples.clear();
+        windowStart = now;
+        windowCpuStart = cpuNow;
+    }
+};
+
+// Log-linear latency histogram
+//
+// Values below 16 ns get a bucket each; above that every power of two is
+// split into 16 sub-buckets, so any percentile is within ~6% of the true
+// value over the whole ns..minutes range. Recording is a few integer ops.
+class LatencyHistogram {
+public:
+    LatencyHistogram() {
+        reset();
     }
     
-    void aiMove(const Ball* ball, Difficulty difficulty) {
-        float targetY = ball->y - height / 2;
-        
-        float speedFactor;
-        int predictionError;
-        
-        switch (difficulty) {
-            case Difficulty::EASY:
-                speedFactor = 0.2f;
-                predictionError = rand() % 61 - 30; // -30 to 30
-                break;
-            case Difficulty::MEDIUM:
-                speedFactor = 0.5f;
-                predictionError = rand() % 31 - 15; // -15 to 15
-                break;
-            case Difficulty::HARD:
-                speedFactor = 1.0f;
-                predictionError = rand() % 11 - 5; // -5 to 5
-                break;
+    void reset() {
+        std::fill(std::begin(buckets), std::end(buckets), 0);
+        count = 0;
+        sum = 0;
+        max = 0;
+    }
+    
+    void record(Uint64 ns) {
+        buckets[bucketFor(ns)]++;
+        count++;
+        sum += ns;
+        max = std::max(max, ns);
+    }
+    
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < BUCKETS; i++) {
+            buckets[i] += other.buckets[i];
         }
-        
-        targetY += predictionError;
-        
-        if (std::abs(targetY - y) > 5) {
-            if (targetY > y) {
-                y += speed * speedFactor;
-            } else {
-                y -= speed * speedFactor;
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+    }
+    
+    // Value below which the given fraction of samples fall
+    Uint64 percentile(double fraction) const {
+        if (count == 0) return 0;
+        Uint64 rank = (Uint64)std::ceil(fraction * count);
+        rank = std::max<Uint64>(rank, 1);
+        Uint64 seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::min(bucketMidpoint(i), max);
             }
         }
+        return max;
     }
     
-    void applyEffect(PowerUpType effectType, int duration = 300) {
-        effects[effectType] = duration;
-        
-        switch (effectType) {
-            case PowerUpType::PADDLE_GROW:
-                height = std::min((int)(baseHeight * 1.5f), 150);
-                break;
-            case PowerUpType::PADDLE_SHRINK:
-                height = std::max((int)(baseHeight * 0.5f), 50);
-                break;
-            case PowerUpType::SHIELD:
-                shieldActive = true;
-                shieldDuration = duration;
-                break;
-            case PowerUpType::LASER:
-                laserActive = true;
-                laserDuration = duration;
-                laserY = y + height / 2;
-                break;
-        }
+    Uint64 getCount() const { return count; }
+    Uint64 getMax() const { return max; }
+    double getMean() const { return count ? (double)sum / count : 0.0; }
+    
+private:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+    
+    Uint64 buckets[BUCKETS];
+    Uint64 count;
+    Uint64 sum;
+    Uint64 max;
+    
+    static int highestBit(Uint64 value) {
+        int bit = 0;
+        while (value >>= 1) bit++;
+        return bit;
+    }
+    
+    static int bucketFor(Uint64 ns) {
+        if (ns < SUB_BUCKETS) return (int)ns;
+        int bit = highestBit(ns);
+        int sub = (int)((ns >> (bit - SUB_BITS)) & (SUB_BUCKETS - 1));
+        return (bit - SUB_BITS + 1) * SUB_BUCKETS + sub;
+    }
+    
+    static Uint64 bucketMidpoint(int index) {
+        if (index < SUB_BUCKETS) return index;
+        int bit = index / SUB_BUCKETS + SUB_BITS - 1;
+        Uint64 sub = index % SUB_BUCKETS;
+        Uint64 low = ((Uint64)SUB_BUCKETS + sub) << (bit - SUB_BITS);
+        Uint64 width = (Uint64)1 << (bit - SUB_BITS);
+        return low + width / 2;
+    }
+};
+
+enum class Phase {
+    HANDLE_EVENTS,
+    UPDATE,
+    UPDATE_GAMEPLAY,
+    UPDATE_POWER_UPS,
+    PUBLISH,
+    DRAW,
+    DRAW_GAME,
+    PRESENT,
+    COUNT
+};
+
+const char* phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::HANDLE_EVENTS: return "handleEvents";
+        case Phase::UPDATE: return "update";
+        case Phase::UPDATE_GAMEPLAY: return "updateGameplay";
+        case Phase::UPDATE_POWER_UPS: return "updatePowerUps";
+        case Phase::PUBLISH: return "publishSnapshot";
+        case Phase::DRAW: return "draw";
+        case Phase::DRAW_GAME: return "drawGame";
+        case Phase::PRESENT: return "SDL_RenderPresent";
+        case Phase::COUNT: break;
+    }
+    return "";
+}
+
+// Per-phase frame profiler
+//
+// Every phase is always timed into a whole-run histogram and a one-second
+// window; the overlay shows the last completed window. Phases nest, so
+// update includes updateGameplay and draw includes drawGame.
+//
+// A profiler is recorded from one thread; getWindow() may be called from
+// any other.
+class Profiler {
+public:
+    Profiler() : ticksToNs(1.0), windowStart(0) {}
+    
+    void init() {
+        ticksToNs = (double)SDL_NS_PER_SECOND / SDL_GetPerformanceFrequency();
+        windowStart = SDL_GetPerformanceCounter();
     }
     
-    void removeEffect(PowerUpType effectType) {
-        if (effectType == PowerUpType::PADDLE_GROW || effectType == PowerUpType::PADDLE_SHRINK) {
-            height = baseHeight;
+    Uint64 now() const {
+        return SDL_GetPerformanceCounter();
+    }
+    
+    void record(Phase phase, Uint64 startTicks) {
+        Uint64 ns = (Uint64)((now() - startTicks) * ticksToNs);
+        window[(int)phase].record(ns);
+    }
+    
+    // Close the window once a second; call once per frame
+    void endFrame() {
+        Uint64 ticks = now();
+        if ((ticks - windowStart) * ticksToNs < SDL_NS_PER_SECOND) return;
+        std::lock_guard<std::mutex> lock(shownMutex);
+        for (int i = 0; i < (int)Phase::COUNT; i++) {
+            total[i].merge(window[i]);
+            shown[i] = window[i];
+            window[i].reset();
         }
+        windowStart = ticks;
     }
     
-    SDL_FRect getRect() const {
-        return {x, y, width, height};
+    LatencyHistogram getWindow(Phase phase) const {
+        std::lock_guard<std::mutex> lock(shownMutex);
+        return shown[(int)phase];
     }
     
-    float getCenterY() const {
-        return y + height / 2;
+    // Adds another profiler's timings to the whole-run totals; the other
+    // profiler's thread must have stopped recording
+    void merge(const Profiler& other) {
+        for (int i = 0; i < (int)Phase::COUNT; i++) {
+            total[i].merge(other.total[i]);
+            total[i].merge(other.window[i]);
+        }
     }
     
-    void draw(SDL_Renderer* renderer) {
-        Color color = WHITE;
-        if (effects.find(PowerUpType::PADDLE_GROW) != effects.end()) {
-            color = GREEN;
-        } else if (effects.find(PowerUpType::PADDLE_SHRINK) != effects.end()) {
-            color = RED;
+    bool writeCsv(const std::string& path) {
+        for (int i = 0; i < (int)Phase::COUNT; i++) {
+            total[i].merge(window[i]);
+            window[i].reset();
         }
         
-        SDL_FRect rect = getRect();
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-        SDL_RenderFillRect(renderer, &rect);
-        
-        // Draw shield effect
-        if (shieldActive) {
-            SDL_FRect shieldRect = {x - 5, y - 5, width + 10, height + 10};
-            SDL_SetRenderDrawColor(renderer, GOLD.r, GOLD.g, GOLD.b, GOLD.a);
-            SDL_RenderRect(renderer, &shieldRect);
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
         }
-        
-        // Draw laser
-        if (laserActive) {
-            SDL_SetRenderDrawColor(renderer, ORANGE.r, ORANGE.g, ORANGE.b, ORANGE.a);
-            drawLine(renderer, (int)x, (int)laserY, (int)(x - 200), (int)laserY);
+        std::fprintf(file, "phase,count,mean_us,p50_us,p90_us,p99_us,p99.9_us,max_us\n");
+        for (int i = 0; i < (int)Phase::COUNT; i++) {
+            const LatencyHistogram& h = total[i];
+            std::fprintf(file, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", phaseName((Phase)i),
+                         (unsigned long long)h.getCount(), h.getMean() / 1000.0,
+                         h.percentile(0.5) / 1000.0, h.percentile(0.9) / 1000.0,
+                         h.percentile(0.99) / 1000.0, h.percentile(0.999) / 1000.0,
+                         h.getMax() / 1000.0);
         }
+        return std::fclose(file) == 0;
     }
+    
+private:
+    double ticksToNs;
+    Uint64 windowStart;
+    LatencyHistogram window[(int)Phase::COUNT];
+    LatencyHistogram shown[(int)Phase::COUNT];
+    LatencyHistogram total[(int)Phase::COUNT];
+    mutable std::mutex shownMutex;
+};
+
+// Times the enclosing scope into one profiler phase
+class ScopedTimer {
+public:
+    ScopedTimer(Profiler& profiler, Phase phase) : profiler(profiler), phase(phase), start(profiler.now()) {}
+    
+    ~ScopedTimer() {
+        profiler.record(phase, start);
+    }
+    
+private:
+    Profiler& profiler;
+    Phase phase;
+    Uint64 start;
+};
+
+// How the main loop paces the next frame
+enum class RefreshMode {
+    FULL,       // Every frame, paced by the FramePacer
+    IDLE,       // Menu and static screens: on input, state changes and at the idle rate
+    HIDDEN      // Minimized or occluded: nothing is drawn until it shows again
+};
+
+// Command-line options
+struct GameOptions {
+    int tickRate;           // Simulation ticks per second, one of TICK_RATES
+    PacingMode pacing;
+    int targetFps;          // Frame rate for SLEEP pacing
+    int idleFps;            // Redraw rate of the menu and static screens; 0 = on input only
+    std::string profileCsv; // Where phase timings are written on exit
+    double traceHitchMs;    // Dump a trace after any frame slower than this; 0 = off
+    int workers;            // Job system threads, including the main thread
+    int stars;
+    size_t stressBalls;     // Balls a stress test starts with
+    uint64_t seed;          // Of match serves, AI error, power-ups and cosmetics
+    std::string recordPath; // Record the inputs of the last match played here
+    std::string replayPath; // Play back this recording at uncapped speed and exit
+    int hostPort;           // Host an online match on this UDP port; -1 = off
+    std::string joinAddress;    // Join the online match hosted at host:port
+    LinkConditions netConditions;   // Simulated loss and latency of online play
+    std::string scoresPath; // High score store; empty = not kept
+    
+    GameOptions() : tickRate(FPS), pacing(PacingMode::SLEEP), targetFps(FPS), idleFps(20),
+                    profileCsv("profile.csv"),
+                    traceHitchMs(0), workers(JobSystem::defaultWorkerCount(8)), stars(100), stressBalls(1000),
+                    seed(std::random_device()()), hostPort(-1), scoresPath("highscores.dat") {}
 };
 
 // Game class
+//
+// The simulation runs on its own thread at the fixed tick rate. After each
+// batch of ticks it publishes a RenderSnapshot into a triple buffer; the
+// main thread polls events, forwards input to the simulation through a
+// lock-free queue and draws whatever snapshot is newest. A slow frame then
+// costs frames, never ticks, and neither thread ever waits for the other.
+//
+// Members below are owned by one of the two threads, as marked. Before the
+// simulation thread starts and after it stops the main thread owns all.
 class Game {
 public:
-    Game() : window(nullptr), renderer(nullptr), state(GameState::MENU), 
-             running(true), gameMode("vs_computer"), difficulty(Difficulty::MEDIUM),
-             paddle1(nullptr), paddle2(nullptr), player1Score(0), player2Score(0),
-             powerUpTimer(0), powerUpSpawnInterval(600), screenShake(0), 
-             freezeTimer(0), menuTime(0), menuPulse(0.0f) {
-        
-        // Initialize stars
-        stars.resize(100);
-        for (auto& star : stars) {
-            star = Star();
-        }
+    Game(const GameOptions& options = GameOptions())
+           : window(nullptr), renderer(nullptr), running(true), starCount(options.stars), starSeed(0),
+             drawnState(GameState::MENU), showRenderStats(false),
+             score1Label(3, WHITE), score2Label(3, WHITE), difficultyLabel(2, GREEN),
+             drawCallsLabel(1, GREEN), stateChangesLabel(1, GREEN), legacyCallsLabel(1, GREEN),
+             tickRateLabel(1, GREEN), pacingLabel(1, GREEN), jitterLabel(1, GREEN), latencyLabel(1, GREEN),
+             pacingMode(options.pacing), targetFps(options.targetFps), idleFps(options.idleFps),
+             windowHidden(false), lastDrawn(0), activeNs(0), activeCpuNs(0), idleNs(0), idleCpuNs(0),
+             showProfiler(false), profileCsv(options.profileCsv),
+             traceHitchNs((Uint64)(options.traceHitchMs * SDL_NS_PER_MS)), lastTraceDump(0), traceDumps(0),
+             jobs(options.workers - options.workers / 2), heldPaddles(0), presentWindowStart(0),
+             presentP50(0), presentP99(0), inputs(256), wakeEvent(0), simStop(false), quitRequested(false),
+             state(GameState::MENU), publishedState(GameState::MENU), keysApplied(false),
+             gameMode("vs_computer"), stressBalls(options.stressBalls), difficulty(Difficulty::MEDIUM),
+             particles(MAX_PARTICLES), screenShake(0), menuTime(0), menuPulse(0.0f),
+             tickRate(options.tickRate), simJobs(std::max(1, options.workers / 2)), simTicks(0),
+             rateWindowStart(0), rateWindowTicks(0), ticksPerSecond(0),
+             matchSeeds(options.seed, MATCH_SEED_STREAM), recordPath(options.recordPath),
+             replayPath(options.replayPath), replayStart(0), hostPort(options.hostPort),
+             joinAddress(options.joinAddress), netConditions(options.netConditions),
+             scoresPath(options.scoresPath), matchTime(0), highScoreRank(-1) {
+        
+        setDifficulty(difficulty);
+        seedCosmetics(options.seed);
     }
     
     ~Game() {
+        stopSimulation();
         cleanup();
     }
     
@@ -824,6 +1406,7 @@ public:
             std::cerr << "SDL could not initialize! SDL Error: " << SDL_GetError() << std::endl;
             return false;
         }
+        wakeEvent = SDL_RegisterEvents(1);
         
         window = SDL_CreateWindow("Space Ping Pong SDL3", SCREEN_WIDTH, SCREEN_HEIGHT, 0);
         if (!window) {
@@ -836,94 +1419,532 @@ public:
             std::cerr << "Renderer could not be created! SDL Error: " << SDL_GetError() << std::endl;
             return false;
         }
+        if (!atlas.build(renderer)) {
+            std::cerr << "Sprite atlas could not be created! SDL Error: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        sprites.setTarget(&commands, &atlas);
+        
+        if (!text.init(renderer)) {
+            std::cerr << "Glyph atlas could not be created! SDL Error: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        if (!createLayers()) {
+            std::cerr << "Layer cache could not be created! SDL Error: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        
+        profiler.init();
+        simProfiler.init();
+        Tracer::get().setThreadName("main");
+        if (traceHitchNs > 0) {
+            Tracer::get().setRecording(true);
+        }
+        setPacingMode(pacingMode);
+        if (pacer.getMode() != pacingMode) {
+            std::cerr << "Renderer does not support " << pacingModeName(pacingMode)
+                      << " pacing, using SLEEP" << std::endl;
+        }
         
+        loadHighScores();
         resetGame();
+        if (!replayPath.empty() && !startReplay()) {
+            return false;
+        }
+        if ((hostPort >= 0 || !joinAddress.empty()) && !startNetplay()) {
+            return false;
+        }
+        
+        // After a replay has reseeded the cosmetics
+        if (!starfield.build(renderer, starSeed, starCount)) {
+            std::cerr << "Starfield could not be created! SDL Error: " << SDL_GetError() << std::endl;
+            return false;
+        }
         return true;
     }
     
     void run() {
-        Uint64 lastTime = SDL_GetTicks();
-        const Uint64 targetFrameTime = 1000 / FPS;
+        // Something to draw before the first tick
+        publish(SDL_GetTicksNS(), SDL_NS_PER_SECOND / tickRate);
+        simThread = std::thread(&Game::simulate, this);
+        
+        Uint64 lastTime = SDL_GetTicksNS();
+        Uint64 lastFrameEnd = lastTime;
+        presentWindowStart = lastTime;
         
+        Uint64 lastCpu = processCpuTimeNS();
         while (running) {
-            Uint64 currentTime = SDL_GetTicks();
-            Uint64 deltaTime = currentTime - lastTime;
+            RefreshMode mode = getRefreshMode();
+            Uint64 currentTime;
+            {
+                TRACE_SCOPE("waitForFrame");
+                currentTime = waitForFrame(mode);
+            }
+            Uint64 frameTime = std::min<Uint64>(currentTime - lastTime, SDL_NS_PER_SECOND / 4);
+            lastTime = currentTime;
             
-            if (deltaTime >= targetFrameTime) {
+            {
+                TRACE_SCOPE("frame");
+                TRACE_INSTANT("frame");
                 handleEvents();
-                update();
-                draw();
-                lastTime = currentTime;
+                
+                snapshots.update();
+                const RenderSnapshot& snapshot = snapshots.getFront();
+                
+                // Draw between the snapshot's last two ticks by how far real
+                // time has moved past the last one. Replays show every tick.
+                float alpha = 1.0f;
+                if (replayPath.empty() && currentTime > snapshot.tickEndNs) {
+                    alpha = std::min(1.0f, (float)(currentTime - snapshot.tickEndNs) / snapshot.tickNs);
+                }
+                // Background stars only ever move, so they live on the main
+                // thread and advance by real time instead of by ticks
+                starfield.update((float)frameTime * FPS / SDL_NS_PER_SECOND);
+                if (!windowHidden) {
+                    draw(snapshot, alpha);
+                    {
+                        ScopedTimer timer(profiler, Phase::PRESENT);
+                        TRACE_SCOPE("SDL_RenderPresent");
+                        SDL_RenderPresent(renderer);
+                    }
+                    recordPresent(snapshot);
+                    lastDrawn = currentTime;
+                }
             }
+            profiler.endFrame();
+            
+            // Idle frames are slow on purpose
+            Uint64 frameEnd = SDL_GetTicksNS();
+            Uint64 cpu = processCpuTimeNS();
+            if (mode == RefreshMode::FULL) {
+                checkTraceHitch(frameEnd, frameEnd - lastFrameEnd);
+                activeNs += frameEnd - lastFrameEnd;
+                activeCpuNs += cpu - lastCpu;
+            } else {
+                idleNs += frameEnd - lastFrameEnd;
+                idleCpuNs += cpu - lastCpu;
+            }
+            lastFrameEnd = frameEnd;
+            lastCpu = cpu;
+            
+            if (quitRequested.load(std::memory_order_acquire)) {
+                running = false;
+            }
+        }
+        stopSimulation();
+        
+        // A match cut short is still worth keeping
+        if (!recording.inputs.empty()) {
+            saveRecording();
+        }
+        
+        // Waits for queued high scores to reach the disk
+        highScores.close();
+        if (highScores.getWriteErrors() > 0) {
+            std::cerr << "Could not save " << highScores.getWriteErrors() << " high score writes to "
+                      << scoresPath << std::endl;
+        }
+        
+        profiler.merge(simProfiler);
+        if (!profileCsv.empty() && !profiler.writeCsv(profileCsv)) {
+            std::cerr << "Could not write profile to " << profileCsv << std::endl;
+        }
+        
+        std::cout << "Pacing " << pacingModeName(pacer.getMode()) << ": "
+                  << formatPacingReport(pacer.getReport()) << std::endl;
+        std::cout << "CPU: " << activeNs / 1e9 << " s at full rate, " << cpuPercent(activeCpuNs, activeNs)
+                  << "% of a core; " << idleNs / 1e9 << " s idle, " << cpuPercent(idleCpuNs, idleNs) << "%"
+                  << std::endl;
+        std::cout << "Latency: input to simulation p50 " << inputTotal.percentile(0.5) / 1000.0 << " us, p99 "
+                  << inputTotal.percentile(0.99) / 1000.0 << " us; simulation to present p50 "
+                  << presentTotal.percentile(0.5) / 1000.0 << " us, p99 "
+                  << presentTotal.percentile(0.99) / 1000.0 << " us" << std::endl;
+        if (netplay) {
+            const RollbackSession& rollback = netplay->getRollback();
+            std::cout << "Netplay: " << rollback.getRollbacks() << " rollbacks, "
+                      << rollback.getResimulatedTicks() << " ticks resimulated, longest "
+                      << rollback.getLongestRollback() << " ticks, slowest "
+                      << rollback.getSlowestRollbackNs() / 1000.0 << " us"
+                      << (netplay->isDesynced() ? ", DESYNCED" : "") << std::endl;
         }
     }
     
     void cleanup() {
-        if (paddle1) delete paddle1;
-        if (paddle2) delete paddle2;
-        
+        sprites.setTarget(nullptr, nullptr);
+        forEachLayer([](CachedLayer& layer) { layer.destroy(); });
+        starfield.destroy();
+        atlas.destroy();
+        text.destroy();
         if (renderer) SDL_DestroyRenderer(renderer);
         if (window) SDL_DestroyWindow(window);
+        renderer = nullptr;
+        window = nullptr;
         
         SDL_Quit();
     }
     
 private:
+    // Main thread
     SDL_Window* window;
     SDL_Renderer* renderer;
+    CommandBuffer commands;     // This frame's draws, submitted sorted by layer and state
+    SpriteAtlas atlas;
+    SpriteBatch sprites;
+    TextRenderer text;
+    bool running;
     
+    Starfield starfield;
+    size_t starCount;
+    uint64_t starSeed;          // Of the starfield; from the cosmetic stream
+    
+    // Retained layers, redrawn by refreshLayers() only when their content changes
+    static const int TITLE_ROW = 32;
+    CachedLayer menuBackdrop;   // Gradient without the pulse
+    CachedLayer menuGlow;       // Pulsing part of the gradient, added on top
+    CachedLayer menuTitle;      // One row per step of the rainbow
+    CachedLayer menuItems;
+    CachedLayer centerLine;
+    CachedLayer scoreBoard;
+    CachedLayer pausedFrame;    // The game under the pause overlay
+    CachedLayer gameOverPanel;
+    CachedLayer highScoreTable;
+    GameState drawnState;       // Of the last frame drawn
+    
+    RenderStats frameStats;     // Renderer calls of the last presented frame
+    bool showRenderStats;
+    
+    TextLabel score1Label;
+    TextLabel score2Label;
+    TextLabel difficultyLabel;
+    TextLabel drawCallsLabel;
+    TextLabel stateChangesLabel;
+    TextLabel legacyCallsLabel;
+    TextLabel tickRateLabel;
+    TextLabel pacingLabel;
+    TextLabel jitterLabel;
+    TextLabel latencyLabel;
+    
+    PacingMode pacingMode;
+    int targetFps;
+    FramePacer pacer;
+    int idleFps;
+    bool windowHidden;
+    Uint64 lastDrawn;           // Start of the last frame drawn
+    Uint64 activeNs;            // Wall and process CPU time of full-rate frames
+    Uint64 activeCpuNs;
+    Uint64 idleNs;              // The same of idle and hidden ones
+    Uint64 idleCpuNs;
+    
+    Profiler profiler;
+    bool showProfiler;
+    std::string profileCsv;
+    
+    Uint64 traceHitchNs;
+    Uint64 lastTraceDump;
+    int traceDumps;
+    
+    JobSystem jobs;
+    Uint8 heldPaddles;          // Paddle keys last sent to the simulation
+    LatencyHistogram presentWindow; // Snapshot publish to present, this second
+    LatencyHistogram presentTotal;
+    Uint64 presentWindowStart;
+    Uint64 presentP50;          // Of the last completed second
+    Uint64 presentP99;
+    
+    // Shared between the threads
+    TripleBuffer<RenderSnapshot> snapshots;
+    SpscQueue<InputMessage> inputs;
+    std::thread simThread;
+    Uint32 wakeEvent;                   // Pushed by the simulation to end an idle wait; 0 = none
+    std::atomic<bool> simStop;          // Set by the main thread
+    std::atomic<bool> quitRequested;    // Set by the simulation thread
+    Profiler simProfiler;               // Recorded by the simulation thread
+    
+    // Simulation thread
     GameState state;
-    bool running;
+    GameState publishedState;   // Of the last snapshot
+    bool keysApplied;           // Since the last snapshot
     std::string gameMode;
+    size_t stressBalls;         // Served by a "stress" game
     Difficulty difficulty;
-    
-    std::vector<Star> stars;
-    std::vector<Particle> particles;
-    std::vector<PowerUp> powerUps;
-    std::vector<Ball> balls;
-    
-    Paddle* paddle1; // Right paddle (Player 1)
-    Paddle* paddle2; // Left paddle (Player 2/Computer)
-    
-    int player1Score;
-    int player2Score;
-    int powerUpTimer;
-    int powerUpSpawnInterval;
-    int screenShake;
-    int freezeTimer;
-    int menuTime;
+    ParticleSystem particles;
+    Match match;
+    float screenShake;
+    float menuTime;
     float menuPulse;
+    int tickRate;
+    JobSystem simJobs;
+    Uint64 simTicks;
+    Uint64 rateWindowStart;
+    Uint64 rateWindowTicks;
+    double ticksPerSecond;      // Over the last completed second
+    LatencyHistogram inputWindow;   // Input event to simulation, this second
+    LatencyHistogram inputShown;    // Of the last completed second
+    LatencyHistogram inputTotal;
+    
+    Random cosmetic;            // Stars, menu particles, screen shake
+    Random matchSeeds;          // Seed of each new match
+    std::string recordPath;
+    InputRecording recording;   // Of the current match, when recordPath is set
+    std::string replayPath;
+    InputRecording replay;
+    std::unique_ptr<InputPlayer> replayer;
+    PaddleInput replayInput1;   // Inputs of the tick being replayed
+    PaddleInput replayInput2;
+    Uint64 replayStart;
+    int hostPort;
+    std::string joinAddress;
+    LinkConditions netConditions;
+    std::unique_ptr<NetplaySession> netplay;    // Online match, when hosting or joining
+    std::string scoresPath;
+    HighScoreStore highScores;
+    float matchTime;            // Seconds of play in the current match
+    int highScoreRank;          // Of the last match, -1 if it did not place
+    PaddleInput input1;         // Held paddle keys, as last forwarded
+    PaddleInput input2;
+    
+    // Games in play, replays and online matches draw every frame; the menu
+    // and static screens only when something happened or at the idle rate
+    RefreshMode getRefreshMode() const {
+        if (windowHidden) {
+            return RefreshMode::HIDDEN;
+        }
+        const RenderSnapshot& snapshot = snapshots.getFront();
+        if (snapshot.state == GameState::PLAYING || snapshot.online || !replayPath.empty()) {
+            return RefreshMode::FULL;
+        }
+        return RefreshMode::IDLE;
+    }
+    
+    // Start of the next frame. Idle frames block in SDL until an event comes
+    // in or the next idle frame is due, but never follow each other faster
+    // than the target rate; a hidden window waits for events only.
+    Uint64 waitForFrame(RefreshMode mode) {
+        if (mode == RefreshMode::FULL) {
+            return pacer.waitForFrame();
+        }
+        
+        Uint64 due = 0;
+        if (mode == RefreshMode::IDLE && idleFps > 0) {
+            due = lastDrawn + SDL_NS_PER_SECOND / idleFps;
+        }
+        for (;;) {
+            Uint64 now = SDL_GetTicksNS();
+            if ((due != 0 && now >= due) || quitRequested.load(std::memory_order_acquire)) {
+                return now;
+            }
+            Sint32 timeout = IDLE_WAIT_MS;
+            if (due != 0) {
+                timeout = (Sint32)std::min<Uint64>(IDLE_WAIT_MS, (due - now + SDL_NS_PER_MS - 1) / SDL_NS_PER_MS);
+            }
+            if (SDL_WaitEventTimeout(nullptr, timeout)) {
+                break;
+            }
+        }
+        
+        Uint64 now = SDL_GetTicksNS();
+        Uint64 earliest = lastDrawn + SDL_NS_PER_SECOND / std::max(1, targetFps);
+        if (mode == RefreshMode::IDLE && now < earliest) {
+            SDL_DelayNS(earliest - now);
+            now = SDL_GetTicksNS();
+        }
+        return now;
+    }
     
+    // Keys the main thread handles itself; everything else is forwarded to
+    // the simulation along with changes in the held paddle keys
     void handleEvents() {
+        ScopedTimer timer(profiler, Phase::HANDLE_EVENTS);
+        TRACE_SCOPE("handleEvents");
         SDL_Event event;
+        Uint64 lastKeyTime = 0;
         while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_EVENT_KEY_DOWN || event.type == SDL_EVENT_KEY_UP) {
+                lastKeyTime = event.key.timestamp;
+            }
             if (event.type == SDL_EVENT_QUIT) {
                 running = false;
+            } else if (event.type == SDL_EVENT_RENDER_TARGETS_RESET || event.type == SDL_EVENT_RENDER_DEVICE_RESET ||
+                       event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED) {
+                // Cached layers lost their content or were drawn for another size
+                forEachLayer([](CachedLayer& layer) { layer.invalidate(); });
+            } else if (event.type == SDL_EVENT_WINDOW_MINIMIZED || event.type == SDL_EVENT_WINDOW_OCCLUDED ||
+                       event.type == SDL_EVENT_WINDOW_HIDDEN) {
+                windowHidden = true;
+            } else if (event.type == SDL_EVENT_WINDOW_RESTORED || event.type == SDL_EVENT_WINDOW_EXPOSED ||
+                       event.type == SDL_EVENT_WINDOW_SHOWN) {
+                windowHidden = false;
+            } else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F2) {
+                showRenderStats = !showRenderStats;
+            } else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F3) {
+                showProfiler = !showProfiler;
+            } else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F8) {
+                toggleTrace();
+            } else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F7) {
+                setPacingMode((PacingMode)(((int)pacingMode + 1) % 4));
             } else if (event.type == SDL_EVENT_KEY_DOWN) {
-                if (state == GameState::MENU) {
-                    handleMenuInput(event.key.key);
-                } else if (state == GameState::PLAYING) {
-                    if (event.key.key == SDLK_SPACE) {
-                        state = GameState::PAUSED;
-                    }
-                } else if (state == GameState::PAUSED) {
-                    if (event.key.key == SDLK_SPACE) {
-                        state = GameState::PLAYING;
-                    } else if (event.key.key == SDLK_ESCAPE) {
-                        state = GameState::MENU;
-                    }
-                } else if (state == GameState::GAME_OVER) {
-                    if (event.key.key == SDLK_SPACE) {
-                        resetGame();
-                        state = GameState::PLAYING;
-                    } else if (event.key.key == SDLK_ESCAPE) {
-                        state = GameState::MENU;
-                    }
-                } else if (state == GameState::HIGH_SCORES) {
-                    if (event.key.key == SDLK_ESCAPE) {
-                        state = GameState::MENU;
-                    }
-                }
+                InputMessage message;
+                message.type = InputMessage::KEY;
+                message.key = event.key.key;
+                message.paddles = 0;
+                message.timeNs = event.key.timestamp;
+                forward(message);
+            }
+        }
+        
+        const bool* keys = SDL_GetKeyboardState(nullptr);
+        Uint8 held = packInputs(PaddleInput(keys[SDL_SCANCODE_UP], keys[SDL_SCANCODE_DOWN]),
+                                PaddleInput(keys[SDL_SCANCODE_W], keys[SDL_SCANCODE_S]));
+        if (held != heldPaddles) {
+            InputMessage message;
+            message.type = InputMessage::PADDLES;
+            message.key = SDLK_UNKNOWN;
+            message.paddles = held;
+            message.timeNs = lastKeyTime ? lastKeyTime : SDL_GetTicksNS();
+            if (forward(message)) {
+                heldPaddles = held;
+            }
+        }
+    }
+    
+    // A full queue means the simulation has stalled; the input is dropped
+    bool forward(const InputMessage& message) {
+        if (!inputs.push(message)) {
+            std::cerr << "Input queue full, input dropped" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    void stopSimulation() {
+        if (simThread.joinable()) {
+            simStop.store(true, std::memory_order_release);
+            simThread.join();
+        }
+    }
+    
+    // Body of the simulation thread: fixed ticks against real time, then a
+    // snapshot, then sleep until the next tick is due
+    void simulate() {
+        Tracer::get().setThreadName("simulation");
+        
+        // Longest stretch of real time one wakeup may feed into the
+        // simulation. After a stall the game slows down instead of
+        // spiralling into ever more catch-up ticks.
+        const Uint64 maxFrameTime = SDL_NS_PER_SECOND / 4;
+        Uint64 lastTime = SDL_GetTicksNS();
+        Uint64 accumulator = 0;
+        rateWindowStart = lastTime;
+        
+        while (!simStop.load(std::memory_order_acquire)) {
+            if (replayer) {
+                simulateReplayTick();
+                continue;
+            }
+            
+            Uint64 currentTime = SDL_GetTicksNS();
+            accumulator += std::min(currentTime - lastTime, maxFrameTime);
+            lastTime = currentTime;
+            applyInputs();
+            
+            // Run as many fixed ticks as real time has passed
+            Uint64 tickTime = SDL_NS_PER_SECOND / tickRate;
+            int ticks = 0;
+            while (accumulator >= tickTime) {
+                update();
+                accumulator -= tickTime;
+                ticks++;
+            }
+            if (ticks > 0) {
+                publish(currentTime - accumulator, tickTime);
+            }
+            simProfiler.endFrame();
+            
+            Uint64 now = SDL_GetTicksNS();
+            Uint64 due = currentTime + (tickTime - accumulator);
+            if (isIdle()) {
+                due = std::max(due, currentTime + SIM_IDLE_POLL_NS);
+            }
+            if (due > now) {
+                SDL_DelayNS(due - now);
+            }
+        }
+    }
+    
+    // Paused and finished games and the high score table change only on
+    // input once the particles and screen shake have died down
+    bool isIdle() const {
+        return (state == GameState::PAUSED || state == GameState::GAME_OVER || state == GameState::HIGH_SCORES) &&
+               !netplay && particles.size() == 0 && screenShake <= 0;
+    }
+    
+    // Replays run one recorded tick per presented frame, as fast as frames
+    // can be drawn: the next tick waits until the last snapshot was taken
+    void simulateReplayTick() {
+        if (snapshots.isUnread()) {
+            std::this_thread::yield();
+            return;
+        }
+        if (replayer->done() || state != GameState::PLAYING) {
+            finishReplay();
+            simStop.store(true, std::memory_order_release);
+            return;
+        }
+        applyInputs();
+        tickRate = replayer->next(replayInput1, replayInput2);
+        update();
+        publish(SDL_GetTicksNS(), SDL_NS_PER_SECOND / tickRate);
+        simProfiler.endFrame();
+    }
+    
+    void applyInputs() {
+        InputMessage message;
+        while (inputs.pop(message)) {
+            Uint64 now = SDL_GetTicksNS();
+            Uint64 latency = now > message.timeNs ? now - message.timeNs : 0;
+            inputWindow.record(latency);
+            inputTotal.record(latency);
+            if (message.type == InputMessage::PADDLES) {
+                unpackInputs(message.paddles, input1, input2);
+            } else {
+                handleKey(message.key);
+                keysApplied = true;
+            }
+        }
+    }
+    
+    void handleKey(SDL_Keycode key) {
+        if (key == SDLK_F6 && !netplay) {
+            cycleTickRate();
+        } else if (netplay) {
+            // An online match can't be paused or restarted on one side
+            if (key == SDLK_ESCAPE) {
+                quitRequested.store(true, std::memory_order_release);
+            }
+        } else if (replayer) {
+            return;
+        } else if (state == GameState::MENU) {
+            handleMenuInput(key);
+        } else if (state == GameState::PLAYING) {
+            if (key == SDLK_SPACE) {
+                state = GameState::PAUSED;
+            }
+        } else if (state == GameState::PAUSED) {
+            if (key == SDLK_SPACE) {
+                state = GameState::PLAYING;
+            } else if (key == SDLK_ESCAPE) {
+                state = GameState::MENU;
+            }
+        } else if (state == GameState::GAME_OVER) {
+            if (key == SDLK_SPACE) {
+                resetGame();
+                state = GameState::PLAYING;
+            } else if (key == SDLK_ESCAPE) {
+                state = GameState::MENU;
+            }
+        } else if (state == GameState::HIGH_SCORES) {
+            if (key == SDLK_ESCAPE) {
+                state = GameState::MENU;
             }
         }
     }
@@ -943,460 +1964,1062 @@ private:
             case SDLK_3:
                 state = GameState::HIGH_SCORES;
                 break;
+            case SDLK_4:
+                gameMode = "stress";
+                resetGame();
+                state = GameState::PLAYING;
+                break;
             case SDLK_E:
-                difficulty = Difficulty::EASY;
+                setDifficulty(Difficulty::EASY);
                 break;
             case SDLK_M:
-                difficulty = Difficulty::MEDIUM;
+                setDifficulty(Difficulty::MEDIUM);
                 break;
             case SDLK_H:
-                difficulty = Difficulty::HARD;
+                setDifficulty(Difficulty::HARD);
                 break;
             case SDLK_ESCAPE:
-                running = false;
+                quitRequested.store(true, std::memory_order_release);
                 break;
         }
     }
     
-    void update() {
-        // Update background stars
-        for (auto& star : stars) {
-            star.update();
+    void setDifficulty(Difficulty value) {
+        difficulty = value;
+        match.difficulty = value;
+    }
+    
+    void cycleTickRate() {
+        const int count = sizeof(TICK_RATES) / sizeof(TICK_RATES[0]);
+        int next = 0;
+        for (int i = 0; i < count; i++) {
+            if (TICK_RATES[i] == tickRate) {
+                next = (i + 1) % count;
+            }
+        }
+        tickRate = TICK_RATES[next];
+    }
+    
+    void setPacingMode(PacingMode mode) {
+        pacer.configure(renderer, mode, targetFps);
+        pacingMode = mode;
+        std::string label = "PACING: " + std::string(pacingModeName(pacer.getMode()));
+        if (pacer.getMode() == PacingMode::SLEEP) {
+            label += " " + std::to_string(targetFps);
+        }
+        pacingLabel.setText(label);
+    }
+    
+    // F8 starts recording; the next press writes the trace. With a hitch
+    // threshold recording is always on and F8 just writes what is buffered.
+    void toggleTrace() {
+        Tracer& tracer = Tracer::get();
+        if (!tracer.isRecording()) {
+            tracer.clear();
+            tracer.setRecording(true);
+            std::cout << "Trace recording started" << std::endl;
+            return;
+        }
+        writeTrace();
+        if (traceHitchNs == 0) {
+            tracer.setRecording(false);
+        }
+    }
+    
+    // Write the buffered trace after a slow frame, at most once a second
+    void checkTraceHitch(Uint64 now, Uint64 frameTime) {
+        if (traceHitchNs == 0 || frameTime <= traceHitchNs) return;
+        if (lastTraceDump != 0 && now - lastTraceDump < SDL_NS_PER_SECOND) return;
+        std::cout << "Frame took " << frameTime / 1000 << " us" << std::endl;
+        writeTrace();
+        lastTraceDump = now;
+    }
+    
+    // The simulation thread keeps recording; the tracer copies its ring safely
+    void writeTrace() {
+        std::string path = "trace_" + std::to_string(++traceDumps) + ".json";
+        if (Tracer::get().dump(path)) {
+            std::cout << "Trace written to " << path << std::endl;
+        } else {
+            std::cerr << "Could not write trace to " << path << std::endl;
         }
+        Tracer::get().clear();
+    }
+    
+    static std::string formatPacingReport(const PacingReport& report) {
+        char buffer[96];
+        std::snprintf(buffer, sizeof(buffer), "FRAME %.2fMS P99 %.2fMS MAX %.2fMS CPU %.1f%%",
+                      report.frameMs, report.jitterP99Ms, report.jitterMaxMs, report.cpuPercent);
+        return buffer;
+    }
+    
+    // Advance the simulation by one fixed tick
+    void update() {
+        ScopedTimer timer(simProfiler, Phase::UPDATE);
+        TRACE_SCOPE("update");
+        float step = (float)FPS / tickRate;
+        simTicks++;
         
         // Update particles
-        particles.erase(std::remove_if(particles.begin(), particles.end(),
-            [](const Particle& p) { return !p.isAlive(); }), particles.end());
-        
-        for (auto& particle : particles) {
-            particle.update();
+        {
+            TRACE_SCOPE("particles.update");
+            particles.update(step, simJobs);
         }
         
         if (state == GameState::MENU) {
-            menuTime++;
+            menuTime += step;
             menuPulse = std::abs(std::sin(menuTime * 0.05f)) * 0.3f + 0.7f;
+            addMenuParticles(step);
+        } else if (state == GameState::PLAYING && netplay) {
+            updateNetplay();
         } else if (state == GameState::PLAYING) {
-            updateGameplay();
+            updateGameplay(step);
+        }
+        
+        // The peer may still need our inputs after the match ends here
+        if (netplay) {
+            netplay->poll();
         }
         
         // Update screen shake
         if (screenShake > 0) {
-            screenShake--;
+            screenShake -= step;
         }
     }
     
-    void updateGameplay() {
-        const bool* keys = SDL_GetKeyboardState(nullptr);
-        
-        // Handle freeze effect
-        if (freezeTimer > 0) {
-            freezeTimer--;
-            return;
+    void updateGameplay(float step) {
+        ScopedTimer timer(simProfiler, Phase::UPDATE_GAMEPLAY);
+        TRACE_SCOPE("updateGameplay");
+        PaddleInput tickInput1 = replayer ? replayInput1 : input1;
+        PaddleInput tickInput2 = replayer ? replayInput2 : input2;
+        if (!recordPath.empty() && !match.stress) {
+            recording.record(tickInput1, tickInput2, tickRate);
+        }
+        matchTime += 1.0f / tickRate;
+        
+        // Same stages as Match::tick, timed separately
+        match.beginTick();
+        if (!match.updateFreeze(step)) {
+            match.updatePaddles(step, tickInput1, tickInput2);
+            match.updateBalls(step);
+            updatePowerUps(step);
+            match.checkGameOver();
+        }
+        handleMatchEvents();
+    }
+    
+    // One tick of an online match: predict, roll back and resimulate as
+    // corrections arrive, and stall once too far ahead of the peer
+    void updateNetplay() {
+        ScopedTimer timer(simProfiler, Phase::UPDATE_GAMEPLAY);
+        TRACE_SCOPE("updateNetplay");
+        if (netplay->canAdvance() && !match.over) {
+            netplay->advance(input1);
+            handleMatchEvents();
         }
         
-        // Update paddles
-        paddle1->update(keys);
-        
-        if (gameMode == "vs_human") {
-            // Player 2 controls (W/S keys)
-            bool keysP2[SDL_SCANCODE_COUNT] = {false};
-            keysP2[SDL_SCANCODE_W] = keys[SDL_SCANCODE_W];
-            keysP2[SDL_SCANCODE_S] = keys[SDL_SCANCODE_S];
-            paddle2->update(keysP2);
-        } else {
-            paddle2->update(nullptr, &balls[0], difficulty);
+        // A predicted win only counts once the peer's inputs confirm it
+        netplay->synchronize();
+        if (match.over && netplay->getRollback().isConfirmed()) {
+            finishMatch();
+        }
+    }
+    
+    void updatePowerUps(float step) {
+        ScopedTimer timer(simProfiler, Phase::UPDATE_POWER_UPS);
+        TRACE_SCOPE("updatePowerUps");
+        match.updatePowerUps(step);
+    }
+    
+    // Fill the back snapshot from the simulation and hand it to the main
+    // thread. tickEnd is the real time the last tick stands for.
+    void publish(Uint64 tickEnd, Uint64 tickNs) {
+        ScopedTimer timer(simProfiler, Phase::PUBLISH);
+        TRACE_SCOPE("publish");
+        RenderSnapshot& snapshot = snapshots.getBack();
+        snapshot.state = state;
+        snapshot.tick = simTicks;
+        snapshot.tickEndNs = tickEnd;
+        snapshot.tickNs = tickNs;
+        
+        snapshot.paddles[0] = makePaddleView(match.paddle1);
+        snapshot.paddles[1] = makePaddleView(match.paddle2);
+        snapshot.balls.clear();
+        snapshot.trail.clear();
+        for (const Ball& ball : match.balls) {
+            snapshot.balls.push_back(makeBallView(ball, snapshot.trail));
         }
         
-        // Update balls
-        for (auto it = balls.begin(); it != balls.end();) {
-            it->update();
-            
-            // Paddle collisions
-            if (it->paddleCollision(paddle1->getRect(), paddle1->getCenterY())) {
-                addHitEffect(it->x, it->y);
+        // The match only ticks while playing; otherwise draw it where it stopped
+        if (state != GameState::PLAYING) {
+            for (PaddleView& paddle : snapshot.paddles) {
+                paddle.prevY = paddle.y;
             }
-            
-            if (it->paddleCollision(paddle2->getRect(), paddle2->getCenterY())) {
-                addHitEffect(it->x, it->y);
+            for (BallView& ball : snapshot.balls) {
+                ball.prevX = ball.x;
+                ball.prevY = ball.y;
             }
-            
-            // Score when ball goes off screen
-            if (it->x < 0) {
-                player1Score++;
-                it = balls.erase(it);
-                addScoreEffect();
-                if (balls.empty()) {
-                    balls.push_back(Ball(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2));
-                }
-            } else if (it->x > SCREEN_WIDTH) {
-                player2Score++;
-                it = balls.erase(it);
-                addScoreEffect();
-                if (balls.empty()) {
-                    balls.push_back(Ball(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2));
-                }
-            } else {
-                ++it;
+        }
+        snapshot.powerUps.clear();
+        for (const PowerUp& powerUp : match.powerUps) {
+            if (powerUp.lifetime > 0) {
+                snapshot.powerUps.push_back(makePowerUpView(powerUp));
             }
         }
+        snapshot.frozen = match.freezeTimer > 0;
         
-        // Update power-ups
-        updatePowerUps();
-        
-        // Check for game over
-        if (player1Score >= 11 || player2Score >= 11) {
-            state = GameState::GAME_OVER;
-            saveHighScore();
+        // Screen shake effect
+        int shake = (int)screenShake;
+        snapshot.shakeX = (shake > 0) ? cosmetic.range(-shake, shake - 1) : 0;
+        snapshot.shakeY = (shake > 0) ? cosmetic.range(-shake, shake - 1) : 0;
+        snapshot.menuTime = menuTime;
+        snapshot.menuPulse = menuPulse;
+        
+        size_t count = particles.size();
+        snapshot.particleX.assign(particles.getX(), particles.getX() + count);
+        snapshot.particleY.assign(particles.getY(), particles.getY() + count);
+        snapshot.particlePrevX.assign(particles.getPrevX(), particles.getPrevX() + count);
+        snapshot.particlePrevY.assign(particles.getPrevY(), particles.getPrevY() + count);
+        snapshot.particleFade.assign(particles.getFade(), particles.getFade() + count);
+        snapshot.particleColor.assign(particles.getColorIndex(), particles.getColorIndex() + count);
+        snapshot.particleSize.assign(particles.getSize(), particles.getSize() + count);
+        
+        snapshot.player1Score = match.player1Score;
+        snapshot.player2Score = match.player2Score;
+        snapshot.difficulty = difficulty;
+        snapshot.tickRate = tickRate;
+        snapshot.online = netplay != nullptr;
+        snapshot.netplayStatus = NetplayStatus::OFF;
+        snapshot.desynced = false;
+        if (netplay) {
+            if (!netplay->isRunning()) {
+                snapshot.netplayStatus = netplay->getLocalPlayer() == 1 ? NetplayStatus::WAITING
+                                                                        : NetplayStatus::CONNECTING;
+            } else if (netplay->hasTimedOut()) {
+                snapshot.netplayStatus = NetplayStatus::LOST;
+            } else {
+                snapshot.netplayStatus = NetplayStatus::RUNNING;
+            }
+            snapshot.desynced = netplay->isDesynced();
+        }
+        const std::vector<HighScore>& top = highScores.getTop();
+        snapshot.highScores.assign(top.begin(), top.begin() + std::min(top.size(), (size_t)HIGH_SCORE_ROWS));
+        snapshot.highScoreCount = highScores.getCount();
+        snapshot.highScoreRank = highScoreRank;
+        
+        // Rates and latencies of the last completed second
+        Uint64 now = SDL_GetTicksNS();
+        if (now - rateWindowStart >= SDL_NS_PER_SECOND) {
+            ticksPerSecond = (double)(simTicks - rateWindowTicks) * SDL_NS_PER_SECOND / (now - rateWindowStart);
+            rateWindowStart = now;
+            rateWindowTicks = simTicks;
+            inputShown = inputWindow;
+            inputWindow.reset();
         }
+        snapshot.ticksPerSecond = ticksPerSecond;
+        snapshot.inputLatencyP50 = inputShown.percentile(0.5);
+        snapshot.inputLatencyP99 = inputShown.percentile(0.99);
+        
+        snapshot.publishNs = SDL_GetTicksNS();
+        snapshots.publish();
+        
+        // An idle main thread would not draw what a key or the game changed
+        // until its next idle frame
+        if (wakeEvent && (keysApplied || state != publishedState)) {
+            SDL_Event event;
+            SDL_zero(event);
+            event.type = wakeEvent;
+            SDL_PushEvent(&event);
+        }
+        keysApplied = false;
+        publishedState = state;
     }
     
-    void updatePowerUps() {
-        // Spawn new power-ups
-        powerUpTimer++;
-        if (powerUpTimer >= powerUpSpawnInterval) {
-            spawnPowerUp();
-            powerUpTimer = 0;
+    void recordPresent(const RenderSnapshot& snapshot) {
+        Uint64 now = SDL_GetTicksNS();
+        Uint64 age = now > snapshot.publishNs ? now - snapshot.publishNs : 0;
+        presentWindow.record(age);
+        presentTotal.record(age);
+        if (now - presentWindowStart >= SDL_NS_PER_SECOND) {
+            presentP50 = presentWindow.percentile(0.5);
+            presentP99 = presentWindow.percentile(0.99);
+            presentWindow.reset();
+            presentWindowStart = now;
         }
-        
-        // Update existing power-ups
-        powerUps.erase(std::remove_if(powerUps.begin(), powerUps.end(),
-            [](const PowerUp& p) { return !p.isAlive(); }), powerUps.end());
-        
-        for (auto& powerUp : powerUps) {
-            powerUp.update();
-            
-            // Check collisions with balls
-            for (auto& ball : balls) {
-                SDL_FRect powerUpRect = powerUp.getRect();
-                SDL_FRect ballRect = ball.getRect();
-                if (SDL_HasRectIntersectionFloat(&powerUpRect, &ballRect)) {
-                    applyPowerUp(powerUp.powerType, &ball);
-                    powerUps.erase(std::find(powerUps.begin(), powerUps.end(), powerUp));
-                    addPowerUpEffect(powerUp.x, powerUp.y);
+    }
+    
+    void handleMatchEvents() {
+        for (const MatchEvent& event : match.events) {
+            switch (event.type) {
+                case MatchEvent::PADDLE_HIT:
+                    addHitEffect(event.x, event.y);
+                    break;
+                case MatchEvent::SCORE:
+                    addScoreEffect();
+                    break;
+                case MatchEvent::POWER_UP_COLLECTED:
+                    addPowerUpEffect(event.x, event.y);
+                    break;
+                case MatchEvent::GAME_OVER:
+                    if (!netplay) {
+                        finishMatch();
+                    }
+                    break;
+                default:
                     break;
-                }
             }
         }
     }
     
-    void spawnPowerUp() {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_int_distribution<> xDist(SCREEN_WIDTH / 4, 3 * SCREEN_WIDTH / 4);
-        static std::uniform_int_distribution<> yDist(100, SCREEN_HEIGHT - 100);
-        static std::uniform_int_distribution<> typeDist(0, 7);
-        
-        float x = xDist(gen);
-        float y = yDist(gen);
-        PowerUpType type = (PowerUpType)(typeDist(gen) + 1);
-        
-        powerUps.push_back(PowerUp(x, y, type));
-    }
-    
-    void applyPowerUp(PowerUpType powerType, Ball* ball) {
-        switch (powerType) {
-            case PowerUpType::SPEED_BOOST:
-                ball->speedMultiplier = 1.5f;
-                break;
-            case PowerUpType::MULTI_BALL:
-                if (balls.size() < 3) {
-                    Ball newBall(ball->x, ball->y);
-                    newBall.velocity.y *= -1;
-                    balls.push_back(newBall);
-                }
-                break;
-            case PowerUpType::FREEZE:
-                freezeTimer = 120; // 2 seconds
-                break;
-            case PowerUpType::MAGNET:
-                ball->isMagnetic = true;
-                ball->magneticForce = 0.5f;
-                break;
-            case PowerUpType::PADDLE_GROW:
-            case PowerUpType::PADDLE_SHRINK:
-            case PowerUpType::SHIELD:
-            case PowerUpType::LASER:
-                if (ball->x > SCREEN_WIDTH / 2) {
-                    paddle1->applyEffect(powerType);
-                } else {
-                    paddle2->applyEffect(powerType);
-                }
-                break;
+    void finishMatch() {
+        state = GameState::GAME_OVER;
+        saveHighScore();
+        if (!recording.inputs.empty()) {
+            saveRecording();
         }
     }
     
     void addHitEffect(float x, float y) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_real_distribution<> velDist(-5, 5);
-        
-        for (int i = 0; i < 10; i++) {
-            Vector2D velocity(velDist(gen), velDist(gen));
-            particles.push_back(Particle(x, y, CYAN, velocity));
-        }
+        particles.emit(ParticleBurst(x, y, 10, 5, PARTICLE_CYAN));
         screenShake = 5;
     }
     
+    // Floating menu particles, on average 0.3 per frame at FPS
+    void addMenuParticles(float step) {
+        if (cosmetic.next() % 10000 < 3000 * step) {
+            float x = cosmetic.range(0, SCREEN_WIDTH - 1);
+            float y = cosmetic.range(0, SCREEN_HEIGHT - 1);
+            Uint8 colors[] = {PARTICLE_CYAN, PARTICLE_PURPLE, PARTICLE_GOLD, PARTICLE_PINK};
+            Uint8 color = colors[cosmetic.range(0, 3)];
+            float vx = cosmetic.range(-100, 99) / 100.0f;
+            float vy = cosmetic.range(-200, -51) / 100.0f;
+            particles.emit(x, y, vx, vy, 120, color);
+        }
+    }
+    
     void addScoreEffect() {
         screenShake = 10;
     }
     
     void addPowerUpEffect(float x, float y) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_real_distribution<> velDist(-8, 8);
+        particles.emit(ParticleBurst(x, y, 15, 8, PARTICLE_GOLD));
+    }
+    
+    void resetGame() {
+        uint64_t seed = matchSeeds.next64();
+        bool player2Human = gameMode == "vs_human";
+        match.reset(true, player2Human, seed);
+        if (gameMode == "stress") {
+            match.startStress(stressBalls);
+        }
+        particles.clear();
+        screenShake = 0;
+        matchTime = 0;
+        highScoreRank = -1;
         
-        for (int i = 0; i < 15; i++) {
-            Vector2D velocity(velDist(gen), velDist(gen));
-            particles.push_back(Particle(x, y, GOLD, velocity));
+        // Recordings replay normal matches only
+        if (!recordPath.empty() && !match.stress) {
+            recording.start(seed, tickRate, difficulty, true, player2Human);
         }
     }
     
-    void resetGame() {
-        balls.clear();
-        balls.push_back(Ball(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2));
+    // Restart every cosmetic stream from a seed, including the starfield's
+    void seedCosmetics(uint64_t seed) {
+        cosmetic.reseed(seed, COSMETIC_STREAM);
+        particles.seed(seed);
+        starSeed = cosmetic.next64();
+    }
+    
+    // A .sprf path gets the keyframed replay container instead of the plain log
+    void saveRecording() {
+        recording.finalChecksum = match.checksum();
+        bool container = recordPath.size() > 5 && recordPath.compare(recordPath.size() - 5, 5, ".sprf") == 0;
+        if (container ? writeReplayFile(recordPath, recording, ReplayHeader().keyframeInterval)
+                      : recording.save(recordPath)) {
+            std::cout << "Recorded " << recording.inputs.size() << " ticks to " << recordPath << std::endl;
+        } else {
+            std::cerr << "Could not write recording to " << recordPath << std::endl;
+        }
+        recording.inputs.clear();
+        recording.rateChanges.clear();
+    }
+    
+    // Set up the recorded match; the simulation then feeds it one tick per frame
+    bool startReplay() {
+        ReplayReader container;
+        if (!replay.load(replayPath) && !(container.open(replayPath) && container.toRecording(replay))) {
+            std::cerr << "Could not read recording " << replayPath << std::endl;
+            return false;
+        }
+        recordPath.clear();
         
-        if (paddle1) delete paddle1;
-        if (paddle2) delete paddle2;
+        setDifficulty(replay.difficulty);
+        gameMode = replay.player2Human ? "vs_human" : "vs_computer";
+        match.reset(replay.player1Human, replay.player2Human, replay.seed);
+        seedCosmetics(replay.seed);
+        particles.clear();
+        screenShake = 0;
+        state = GameState::PLAYING;
+        setPacingMode(PacingMode::UNCAPPED);
         
-        paddle1 = new Paddle(SCREEN_WIDTH - 45, SCREEN_HEIGHT / 2 - 50, true);
-        paddle2 = new Paddle(30, SCREEN_HEIGHT / 2 - 50, gameMode == "vs_human");
+        replayer.reset(new InputPlayer(replay));
+        replayStart = SDL_GetTicksNS();
+        return true;
+    }
+    
+    void finishReplay() {
+        double seconds = (double)(SDL_GetTicksNS() - replayStart) / SDL_NS_PER_SECOND;
+        bool exact = replayer->done() && match.checksum() == replay.finalChecksum;
+        std::cout << "Replayed " << replayer->getTick() << " of " << replay.inputs.size() << " ticks in "
+                  << seconds << " s (" << (seconds > 0 ? replayer->getTick() / seconds : 0.0) << " ticks/s), "
+                  << (exact ? "final state matches" : "final state DIFFERS") << std::endl;
+        quitRequested.store(true, std::memory_order_release);
+    }
+    
+    // Open the socket; the match starts once the peer answers
+    bool startNetplay() {
+        netplay.reset(new NetplaySession(match));
+        netplay->setConditions(netConditions);
+        if (hostPort >= 0) {
+            if (!netplay->host((uint16_t)hostPort, matchSeeds.next64())) {
+                std::cerr << "Could not open UDP port " << hostPort << std::endl;
+                return false;
+            }
+            std::cout << "Hosting on UDP port " << netplay->getLocalPort() << std::endl;
+        } else {
+            NetAddress address;
+            if (!NetAddress::parse(joinAddress, address)) {
+                std::cerr << "Could not resolve " << joinAddress << std::endl;
+                return false;
+            }
+            if (!netplay->join(address)) {
+                std::cerr << "Could not open a UDP socket" << std::endl;
+                return false;
+            }
+        }
         
-        powerUps.clear();
+        // Both ends simulate the same ticks, so the rate is fixed
+        recordPath.clear();
+        tickRate = FPS;
+        gameMode = "vs_human";
         particles.clear();
-        player1Score = 0;
-        player2Score = 0;
-        powerUpTimer = 0;
-        freezeTimer = 0;
         screenShake = 0;
+        state = GameState::PLAYING;
+        return true;
     }
     
-    void draw() {
-        // Screen shake effect
-        float shakeX = (screenShake > 0) ? (rand() % (screenShake * 2) - screenShake) : 0;
-        float shakeY = (screenShake > 0) ? (rand() % (screenShake * 2) - screenShake) : 0;
+    // Render a snapshot; alpha is how far real time has progressed from its
+    // previous tick towards its last one
+    void draw(const RenderSnapshot& snapshot, float alpha) {
+        ScopedTimer timer(profiler, Phase::DRAW);
+        TRACE_SCOPE("draw");
+        
+        refreshLayers(snapshot, alpha);
+        commands.clear();
+        sprites.resetStats();
         
         // Clear screen
         SDL_SetRenderDrawColor(renderer, BLACK.r, BLACK.g, BLACK.b, BLACK.a);
         SDL_RenderClear(renderer);
         
         // Draw background stars
-        for (const auto& star : stars) {
-            star.draw(renderer);
-        }
+        commands.setLayer(RenderLayer::BACKGROUND);
+        starfield.draw(commands);
         
-        switch (state) {
+        switch (snapshot.state) {
             case GameState::MENU:
-                drawMenu();
+                drawMenu(snapshot, alpha);
                 break;
             case GameState::PLAYING:
-                drawGame(shakeX, shakeY);
+                drawGame(snapshot, alpha);
+                if (snapshot.online) {
+                    drawNetplayStatus(snapshot);
+                }
                 break;
             case GameState::PAUSED:
-                drawGame(shakeX, shakeY);
+                commands.setLayer(RenderLayer::BACKDROP);
+                pausedFrame.blit(commands);
                 drawPauseOverlay();
                 break;
             case GameState::GAME_OVER:
-                drawGame(shakeX, shakeY);
-                drawGameOver();
+                drawGame(snapshot, alpha);
+                commands.setLayer(RenderLayer::OVERLAY);
+                gameOverPanel.blit(commands);
                 break;
             case GameState::HIGH_SCORES:
-                drawHighScores();
+                commands.setLayer(RenderLayer::HUD);
+                highScoreTable.blit(commands);
                 break;
         }
         
-        SDL_RenderPresent(renderer);
+        commands.setLayer(RenderLayer::DEBUG);
+        if (showRenderStats) {
+            drawRenderStats(snapshot);
+        }
+        if (showProfiler) {
+            drawProfiler();
+        }
+        
+        {
+            TRACE_SCOPE("submit");
+            commands.submit(renderer);
+        }
+        frameStats.drawCalls = commands.getStats().drawCalls;
+        frameStats.legacyCalls = commands.getStats().primitives + sprites.getLegacyCalls();
     }
     
-    void drawMenu() {
-        // Animated background gradient
-        for (int y = 0; y < SCREEN_HEIGHT; y += 4) {
-            float gradientFactor = (float)y / SCREEN_HEIGHT;
-            Uint8 colorR = (Uint8)(20 + (30 * gradientFactor * menuPulse));
-            Uint8 colorG = (Uint8)(10 + (50 * gradientFactor));
-            Uint8 colorB = (Uint8)(40 + (60 * gradientFactor));
-            
-            SDL_SetRenderDrawColor(renderer, colorR, colorG, colorB, 255);
-            SDL_FRect rect = {0, (float)y, SCREEN_WIDTH, 4};
-            SDL_RenderFillRect(renderer, &rect);
+    bool createLayers() {
+        int titleWidth = (int)MENU_TITLE.length() * 5 * 4;
+        return menuBackdrop.create(renderer, SCREEN_WIDTH, SCREEN_HEIGHT) &&
+               menuGlow.create(renderer, SCREEN_WIDTH, SCREEN_HEIGHT) &&
+               menuTitle.create(renderer, titleWidth, TITLE_ROW * TITLE_STEPS) &&
+               menuItems.create(renderer, SCREEN_WIDTH, SCREEN_HEIGHT) &&
+               centerLine.create(renderer, 4, SCREEN_HEIGHT) &&
+               scoreBoard.create(renderer, SCREEN_WIDTH, SCREEN_HEIGHT) &&
+               pausedFrame.create(renderer, SCREEN_WIDTH, SCREEN_HEIGHT) &&
+               gameOverPanel.create(renderer, SCREEN_WIDTH, SCREEN_HEIGHT) &&
+               highScoreTable.create(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+    
+    template <typename Function>
+    void forEachLayer(Function function) {
+        for (CachedLayer* layer : {&menuBackdrop, &menuGlow, &menuTitle, &menuItems, &centerLine, &scoreBoard,
+                                   &pausedFrame, &gameOverPanel, &highScoreTable}) {
+            function(*layer);
+        }
+    }
+    
+    // Bring the layers this frame blits up to date. Each stale one is drawn
+    // through the command buffer on its own, before the frame's recording
+    // starts; the version passed along is what its content depends on.
+    void refreshLayers(const RenderSnapshot& snapshot, float alpha) {
+        TRACE_SCOPE("refreshLayers");
+        if (snapshot.state != drawnState) {
+            // The game is captured once per pause
+            if (snapshot.state == GameState::PAUSED) {
+                pausedFrame.invalidate();
+            }
+            drawnState = snapshot.state;
+        }
+        
+        Uint64 scores = (Uint64)snapshot.player1Score << 32 | (Uint32)snapshot.player2Score;
+        Uint64 placed = (Uint64)(snapshot.highScoreRank + 1);
+        switch (snapshot.state) {
+            case GameState::MENU:
+                refreshLayer(menuBackdrop, 0, [&]() { drawMenuGradient(false); });
+                refreshLayer(menuGlow, 0, [&]() { drawMenuGradient(true); });
+                refreshLayer(menuTitle, 0, [&]() { drawMenuTitle(); });
+                refreshLayer(menuItems, (Uint64)snapshot.difficulty, [&]() { drawMenuItems(snapshot); });
+                break;
+            case GameState::PLAYING:
+            case GameState::PAUSED:
+            case GameState::GAME_OVER:
+                refreshLayer(centerLine, 0, [&]() { drawCenterLine(); });
+                refreshLayer(scoreBoard, scores, [&]() { drawScoreBoard(snapshot); });
+                if (snapshot.state == GameState::PAUSED) {
+                    refreshLayer(pausedFrame, 0, [&]() { drawGame(snapshot, alpha); });
+                } else if (snapshot.state == GameState::GAME_OVER) {
+                    refreshLayer(gameOverPanel, scores << 8 ^ placed << 1 ^ (snapshot.online ? 1 : 0),
+                                 [&]() { drawGameOver(snapshot); });
+                }
+                break;
+            case GameState::HIGH_SCORES:
+                refreshLayer(highScoreTable, snapshot.highScoreCount << 8 ^ placed,
+                             [&]() { drawHighScores(snapshot); });
+                break;
+        }
+    }
+    
+    template <typename Record>
+    void refreshLayer(CachedLayer& layer, Uint64 version, Record record) {
+        if (!layer.isStale(version) || !layer.begin(renderer)) {
+            return;
+        }
+        int generation = text.getGeneration();
+        commands.clear();
+        record();
+        commands.submit(renderer);
+        layer.end(renderer, version);
+        
+        // Glyphs recorded before a sheet refill would stay wrong in the layer
+        if (text.getGeneration() != generation) {
+            layer.invalidate();
         }
+    }
+    
+    void drawMenu(const RenderSnapshot& snapshot, float alpha) {
+        TRACE_SCOPE("drawMenu");
+        float menuPulse = snapshot.menuPulse;
+        
+        // Animated background gradient: the fixed part, plus the red that
+        // pulses added on top
+        commands.setLayer(RenderLayer::BACKDROP);
+        menuBackdrop.blit(commands);
+        menuGlow.blit(commands, {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT}, 0, 0, {1, 1, 1, menuPulse},
+                      SDL_BLENDMODE_ADD);
         
         // Title with rainbow effect
-        std::string title = "SPACE PING PONG SDL3";
-        Color rainbowColors[] = {
-            Color(255, 100, 100), Color(255, 150, 0), Color(255, 255, 0),
-            Color(100, 255, 100), Color(100, 150, 255), Color(150, 100, 255),
-            Color(255, 100, 255)
-        };
+        commands.setLayer(RenderLayer::HUD);
+        float titleWidth = (float)(MENU_TITLE.length() * 5 * 4);
+        int step = (int)(snapshot.menuTime / 10) % TITLE_STEPS;
+        SDL_FRect row = {0, (float)(step * TITLE_ROW), titleWidth, TITLE_ROW};
+        menuTitle.blit(commands, row, SCREEN_WIDTH / 2 - titleWidth / 2, 100, {menuPulse, menuPulse, menuPulse, 1});
         
-        int titleX = SCREEN_WIDTH / 2 - (title.length() * 5 * 4) / 2;
-        for (size_t i = 0; i < title.length(); i++) {
-            if (title[i] != ' ') {
-                int colorIndex = (i + menuTime / 10) % 7;
-                Color color = rainbowColors[colorIndex];
-                Color pulseColor(color.r * menuPulse, color.g * menuPulse, color.b * menuPulse);
-                
-                drawChar(renderer, title[i], titleX + i * 20, 100, 4, pulseColor);
+        // Menu options
+        menuItems.blit(commands);
+        
+        // Draw menu particles
+        drawParticles(snapshot, alpha);
+    }
+    
+    // Strips of the menu gradient without the pulse, or only the red the
+    // pulse scales
+    void drawMenuGradient(bool pulsing) {
+        commands.setLayer(RenderLayer::BACKDROP);
+        for (int y = 0; y < SCREEN_HEIGHT; y += 4) {
+            float gradientFactor = (float)y / SCREEN_HEIGHT;
+            if (pulsing) {
+                commands.setColor((Uint8)(30 * gradientFactor), 0, 0, 255);
+            } else {
+                Uint8 colorG = (Uint8)(10 + (50 * gradientFactor));
+                Uint8 colorB = (Uint8)(40 + (60 * gradientFactor));
+                commands.setColor(20, colorG, colorB, 255);
             }
+            SDL_FRect rect = {0, (float)y, SCREEN_WIDTH, 4};
+            commands.fillRect(rect);
         }
-        
-        // Menu options
-        std::vector<std::pair<std::string, Color>> menuItems = {
-            {"1. PLAY VS COMPUTER", CYAN},
-            {"2. PLAY VS HUMAN", PURPLE},
-            {"3. HIGH SCORES", GOLD},
-            {"", WHITE}, // Spacer
-            {"DIFFICULTY: " + std::to_string((int)difficulty), GREEN},
-            {"(PRESS E/M/H TO CHANGE)", WHITE},
-            {"", WHITE}, // Spacer
-            {"SPACE: PAUSE GAME", GOLD},
-            {"ESC: QUIT", RED}
+    }
+    
+    // Row n holds the title as it looks n steps into the rainbow cycle
+    void drawMenuTitle() {
+        commands.setLayer(RenderLayer::HUD);
+        for (int step = 0; step < TITLE_STEPS; step++) {
+            for (size_t i = 0; i < MENU_TITLE.length(); i++) {
+                if (MENU_TITLE[i] != ' ') {
+                    const Color& color = TITLE_COLORS[(i + step) % TITLE_STEPS];
+                    text.drawChar(sprites, MENU_TITLE[i], (int)i * 20, step * TITLE_ROW, 4, color);
+                }
+            }
+        }
+    }
+    
+    void drawMenuItems(const RenderSnapshot& snapshot) {
+        commands.setLayer(RenderLayer::HUD);
+        struct MenuItem {
+            std::string text;
+            Color color;
+            bool isDifficulty;
+        };
+        static const MenuItem menuItems[] = {
+            {"1. PLAY VS COMPUTER", CYAN, false},
+            {"2. PLAY VS HUMAN", PURPLE, false},
+            {"3. HIGH SCORES", GOLD, false},
+            {"4. STRESS TEST", ORANGE, false},
+            {"", WHITE, false}, // Spacer
+            {"", GREEN, true},  // Difficulty label
+            {"(PRESS E/M/H TO CHANGE)", WHITE, false},
+            {"", WHITE, false}, // Spacer
+            {"SPACE: PAUSE GAME", GOLD, false},
+            {"ESC: QUIT", RED, false}
         };
         
+        difficultyLabel.setText("DIFFICULTY: " + std::to_string((int)snapshot.difficulty));
         int y = 300;
         for (const auto& item : menuItems) {
-            if (!item.first.empty()) {
-                int textX = SCREEN_WIDTH / 2 - (item.first.length() * 5 * 2) / 2;
-                drawText(renderer, item.first, textX, y, 2, item.second);
+            if (item.isDifficulty) {
+                int textX = SCREEN_WIDTH / 2 - (difficultyLabel.getText().length() * 5 * 2) / 2;
+                difficultyLabel.draw(text, sprites, textX, y);
+            } else if (!item.text.empty()) {
+                int textX = SCREEN_WIDTH / 2 - (item.text.length() * 5 * 2) / 2;
+                text.draw(sprites, item.text, textX, y, 2, item.color);
             }
             y += 40;
         }
-        
-        // Update and draw menu particles
-        particles.erase(std::remove_if(particles.begin(), particles.end(),
-            [](const Particle& p) { return !p.isAlive(); }), particles.end());
-        
-        for (auto& particle : particles) {
-            particle.update();
-            particle.draw(renderer);
-        }
-        
-        // Add floating particles
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        if (gen() % 100 < 30) {
-            float x = gen() % SCREEN_WIDTH;
-            float y = gen() % SCREEN_HEIGHT;
-            Color colors[] = {CYAN, PURPLE, GOLD, PINK};
-            Color color = colors[gen() % 4];
-            Vector2D velocity((gen() % 200 - 100) / 100.0f, (gen() % 150 - 200) / 100.0f);
-            particles.push_back(Particle(x, y, color, velocity, 120));
-        }
     }
     
-    void drawGame(float shakeX, float shakeY) {
+    void drawParticles(const RenderSnapshot& snapshot, float alpha) {
+        TRACE_SCOPE("drawParticles");
+        RenderLayer previous = commands.getLayer();
+        commands.setLayer(RenderLayer::PARTICLES);
+        const float* x = snapshot.particleX.data();
+        const float* y = snapshot.particleY.data();
+        const float* prevX = snapshot.particlePrevX.data();
+        const float* prevY = snapshot.particlePrevY.data();
+        const float* fade = snapshot.particleFade.data();
+        const Uint8* colorIndex = snapshot.particleColor.data();
+        const Uint8* size = snapshot.particleSize.data();
+        size_t count = snapshot.particleX.size();
+        SDL_Vertex* quads = sprites.reserveQuads(atlas.getTexture(), (int)count);
+        std::atomic<int> legacyCalls(0);
+        jobs.parallelFor(count, PARTICLE_DRAW_GRAIN, [&](size_t begin, size_t end) {
+            int calls = 0;
+            for (size_t i = begin; i < end; i++) {
+                Color color = PARTICLE_COLORS[colorIndex[i]];
+                color.a = (Uint8)(255 * fade[i]);
+                int drawX = (int)lerp(prevX[i], x[i], alpha);
+                int drawY = (int)lerp(prevY[i], y[i], alpha);
+                const AtlasRegion& region = atlas.disc(size[i]);
+                SpriteBatch::writeSprite(quads + i * 4, region, drawX, drawY, color);
+                calls += region.legacyCalls;
+            }
+            legacyCalls += calls;
+        });
+        sprites.addLegacyCalls(legacyCalls);
+        commands.setLayer(previous);
+    }
+    
+    void drawGame(const RenderSnapshot& snapshot, float alpha) {
+        ScopedTimer timer(profiler, Phase::DRAW_GAME);
+        TRACE_SCOPE("drawGame");
         // Draw center line
-        for (int y = 0; y < SCREEN_HEIGHT; y += 20) {
-            SDL_SetRenderDrawColor(renderer, WHITE.r, WHITE.g, WHITE.b, WHITE.a);
-            SDL_FRect lineRect = {SCREEN_WIDTH/2 - 2 + shakeX, y + shakeY, 4, 10};
-            SDL_RenderFillRect(renderer, &lineRect);
-        }
+        commands.setLayer(RenderLayer::BACKDROP);
+        centerLine.blit(commands, SCREEN_WIDTH/2 - 2 + snapshot.shakeX, snapshot.shakeY);
         
         // Draw paddles
-        paddle1->draw(renderer);
-        paddle2->draw(renderer);
+        commands.setLayer(RenderLayer::WORLD);
+        drawPaddle(commands, snapshot.paddles[0], alpha);
+        drawPaddle(commands, snapshot.paddles[1], alpha);
         
         // Draw balls
-        for (const auto& ball : balls) {
-            ball.draw(renderer);
+        for (const BallView& ball : snapshot.balls) {
+            drawBall(sprites, ball, snapshot.trail.data() + ball.trailStart, alpha);
         }
         
         // Draw power-ups
-        for (const auto& powerUp : powerUps) {
-            powerUp.draw(renderer);
+        for (const PowerUpView& powerUp : snapshot.powerUps) {
+            drawPowerUp(sprites, powerUp);
         }
         
         // Draw particles
-        for (const auto& particle : particles) {
-            particle.draw(renderer);
-        }
+        drawParticles(snapshot, alpha);
         
         // Draw scores
-        std::string score1 = std::to_string(player1Score);
-        std::string score2 = std::to_string(player2Score);
-        
-        // Draw score backgrounds
-        SDL_SetRenderDrawColor(renderer, CYAN.r, CYAN.g, CYAN.b, 100);
-        SDL_FRect score1Rect = {SCREEN_WIDTH/2 + 20, 40, 50, 40};
-        SDL_RenderFillRect(renderer, &score1Rect);
-        SDL_SetRenderDrawColor(renderer, PINK.r, PINK.g, PINK.b, 100);
-        SDL_FRect score2Rect = {SCREEN_WIDTH/2 - 70, 40, 50, 40};
-        SDL_RenderFillRect(renderer, &score2Rect);
-        
-        // Draw score text
-        drawText(renderer, score1, SCREEN_WIDTH/2 + 35, 50, 3, WHITE);
-        drawText(renderer, score2, SCREEN_WIDTH/2 - 55, 50, 3, WHITE);
+        commands.setLayer(RenderLayer::HUD);
+        scoreBoard.blit(commands);
         
         // Draw freeze overlay
-        if (freezeTimer > 0) {
-            SDL_SetRenderDrawColor(renderer, 0, 0, 255, 50);
+        if (snapshot.frozen) {
+            commands.setLayer(RenderLayer::OVERLAY);
+            commands.setColor(0, 0, 255, 50);
             SDL_FRect freezeRect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
-            SDL_RenderFillRect(renderer, &freezeRect);
+            commands.fillRect(freezeRect);
             
             // Draw "FROZEN!" text
-            drawText(renderer, "FROZEN!", SCREEN_WIDTH/2 - 70, SCREEN_HEIGHT/2 - 10, 4, BLUE);
+            commands.setLayer(RenderLayer::OVERLAY_TEXT);
+            text.draw(sprites, "FROZEN!", SCREEN_WIDTH/2 - 70, SCREEN_HEIGHT/2 - 10, 4, BLUE);
+        }
+    }
+    
+    // Dashes of the center line, in a column of its own
+    void drawCenterLine() {
+        commands.setLayer(RenderLayer::BACKDROP);
+        commands.setColor(WHITE);
+        for (int y = 0; y < SCREEN_HEIGHT; y += 20) {
+            SDL_FRect lineRect = {0, (float)y, 4, 10};
+            commands.fillRect(lineRect);
         }
     }
     
+    void drawScoreBoard(const RenderSnapshot& snapshot) {
+        commands.setLayer(RenderLayer::HUD);
+        score1Label.setNumber(snapshot.player1Score);
+        score2Label.setNumber(snapshot.player2Score);
+        
+        // Draw score backgrounds
+        commands.setColor(CYAN.r, CYAN.g, CYAN.b, 100);
+        SDL_FRect score1Rect = {SCREEN_WIDTH/2 + 20, 40, 50, 40};
+        commands.fillRect(score1Rect);
+        commands.setColor(PINK.r, PINK.g, PINK.b, 100);
+        SDL_FRect score2Rect = {SCREEN_WIDTH/2 - 70, 40, 50, 40};
+        commands.fillRect(score2Rect);
+        
+        // Draw score text
+        score1Label.draw(text, sprites, SCREEN_WIDTH/2 + 35, 50);
+        score2Label.draw(text, sprites, SCREEN_WIDTH/2 - 55, 50);
+    }
+    
     void drawPauseOverlay() {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 128);
+        TRACE_SCOPE("drawPauseOverlay");
+        commands.setLayer(RenderLayer::OVERLAY);
+        commands.setColor(0, 0, 0, 128);
         SDL_FRect overlayRect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
-        SDL_RenderFillRect(renderer, &overlayRect);
+        commands.fillRect(overlayRect);
         
         // Draw "PAUSED" text
-        drawText(renderer, "PAUSED", SCREEN_WIDTH/2 - 60, SCREEN_HEIGHT/2 - 20, 5, WHITE);
+        commands.setLayer(RenderLayer::OVERLAY_TEXT);
+        text.draw(sprites, "PAUSED", SCREEN_WIDTH/2 - 60, SCREEN_HEIGHT/2 - 20, 5, WHITE);
     }
     
-    void drawGameOver() {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 128);
+    void drawGameOver(const RenderSnapshot& snapshot) {
+        TRACE_SCOPE("drawGameOver");
+        commands.setLayer(RenderLayer::OVERLAY);
+        commands.setColor(0, 0, 0, 128);
         SDL_FRect gameOverRect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
-        SDL_RenderFillRect(renderer, &gameOverRect);
+        commands.fillRect(gameOverRect);
         
+        commands.setLayer(RenderLayer::OVERLAY_TEXT);
         // Draw winner text
-        std::string winner = (player1Score > player2Score) ? "PLAYER 1 WINS!" : "PLAYER 2 WINS!";
+        std::string winner = (snapshot.player1Score > snapshot.player2Score) ? "PLAYER 1 WINS!" : "PLAYER 2 WINS!";
         int winnerX = SCREEN_WIDTH/2 - (winner.length() * 5 * 3) / 2;
-        drawText(renderer, winner, winnerX, SCREEN_HEIGHT/2 - 50, 3, GOLD);
+        text.draw(sprites, winner, winnerX, SCREEN_HEIGHT/2 - 50, 3, GOLD);
         
         // Draw final score
-        std::string finalScore = std::to_string(player1Score) + " - " + std::to_string(player2Score);
+        std::string finalScore = std::to_string(snapshot.player1Score) + " - " + std::to_string(snapshot.player2Score);
         int scoreX = SCREEN_WIDTH/2 - (finalScore.length() * 5 * 2) / 2;
-        drawText(renderer, finalScore, scoreX, SCREEN_HEIGHT/2, 2, WHITE);
+        text.draw(sprites, finalScore, scoreX, SCREEN_HEIGHT/2, 2, WHITE);
+        
+        if (snapshot.highScoreRank >= 0 && snapshot.highScoreRank < HIGH_SCORE_ROWS) {
+            std::string placed = "NEW HIGH SCORE - RANK " + std::to_string(snapshot.highScoreRank + 1);
+            int placedX = SCREEN_WIDTH/2 - (placed.length() * 5 * 2) / 2;
+            text.draw(sprites, placed, placedX, SCREEN_HEIGHT/2 - 100, 2, PINK);
+        }
         
         // Draw instructions
-        drawText(renderer, "SPACE: PLAY AGAIN", SCREEN_WIDTH/2 - 120, SCREEN_HEIGHT/2 + 50, 2, CYAN);
-        drawText(renderer, "ESC: MENU", SCREEN_WIDTH/2 - 60, SCREEN_HEIGHT/2 + 80, 2, CYAN);
+        if (snapshot.online) {
+            text.draw(sprites, "ESC: QUIT", SCREEN_WIDTH/2 - 60, SCREEN_HEIGHT/2 + 50, 2, CYAN);
+            return;
+        }
+        text.draw(sprites, "SPACE: PLAY AGAIN", SCREEN_WIDTH/2 - 120, SCREEN_HEIGHT/2 + 50, 2, CYAN);
+        text.draw(sprites, "ESC: MENU", SCREEN_WIDTH/2 - 60, SCREEN_HEIGHT/2 + 80, 2, CYAN);
+    }
+    
+    void drawNetplayStatus(const RenderSnapshot& snapshot) {
+        TRACE_SCOPE("drawNetplayStatus");
+        std::string status;
+        if (snapshot.netplayStatus == NetplayStatus::WAITING) {
+            status = "WAITING FOR PLAYER 2";
+        } else if (snapshot.netplayStatus == NetplayStatus::CONNECTING) {
+            status = "CONNECTING";
+        } else if (snapshot.netplayStatus == NetplayStatus::LOST) {
+            status = "CONNECTION LOST";
+        }
+        commands.setLayer(RenderLayer::OVERLAY_TEXT);
+        if (!status.empty()) {
+            commands.setLayer(RenderLayer::OVERLAY);
+            commands.setColor(0, 0, 0, 128);
+            SDL_FRect overlayRect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+            commands.fillRect(overlayRect);
+            commands.setLayer(RenderLayer::OVERLAY_TEXT);
+            int statusX = SCREEN_WIDTH/2 - (status.length() * 5 * 3) / 2;
+            text.draw(sprites, status, statusX, SCREEN_HEIGHT/2 - 20, 3, WHITE);
+        }
+        if (snapshot.desynced) {
+            text.draw(sprites, "DESYNC", SCREEN_WIDTH/2 - 45, 100, 3, RED);
+        }
     }
     
-    void drawHighScores() {
+    void drawHighScores(const RenderSnapshot& snapshot) {
+        TRACE_SCOPE("drawHighScores");
+        commands.setLayer(RenderLayer::HUD);
         // Draw "HIGH SCORES" title
-        drawText(renderer, "HIGH SCORES", SCREEN_WIDTH/2 - 80, 150, 4, CYAN);
+        text.draw(sprites, "HIGH SCORES", SCREEN_WIDTH/2 - 80, 150, 4, CYAN);
         
-        // Draw high scores (simplified)
-        int y = 250;
-        for (int i = 0; i < 5; i++) {
-            std::string scoreText = std::to_string(i + 1) + ". PLAYER " + std::to_string(i % 2 + 1) + " - " + std::to_string(10 - i);
-            drawText(renderer, scoreText, SCREEN_WIDTH/2 - 120, y, 2, WHITE);
-            y += 40;
+        // Best wins, straight from the in-memory index
+        const std::vector<HighScore>& top = snapshot.highScores;
+        int y = 230;
+        if (top.empty()) {
+            text.draw(sprites, "NO WINS YET", SCREEN_WIDTH/2 - 65, y, 2, WHITE);
+        }
+        for (int i = 0; i < HIGH_SCORE_ROWS && i < (int)top.size(); i++) {
+            const HighScore& score = top[i];
+            const char* opponent = score.difficulty == HUMAN_OPPONENT ? "HUMAN" :
+                                   score.difficulty == (uint8_t)Difficulty::EASY ? "EASY" :
+                                   score.difficulty == (uint8_t)Difficulty::MEDIUM ? "MEDIUM" : "HARD";
+            char row[64];
+            std::snprintf(row, sizeof(row), "%2d. PLAYER %d  %2d-%-2d  %-6s  %2u:%02u", i + 1, score.winner,
+                          score.winnerScore, score.loserScore, opponent, score.durationMs / 60000,
+                          score.durationMs / 1000 % 60);
+            text.draw(sprites, row, SCREEN_WIDTH/2 - 220, y, 2, i == snapshot.highScoreRank ? PINK : WHITE);
+            y += 30;
         }
+        std::string total = std::to_string(snapshot.highScoreCount) + " WINS RECORDED";
+        text.draw(sprites, total, SCREEN_WIDTH/2 - (total.length() * 5) / 2, y + 20, 1, GREEN);
         
         // Draw back instruction
-        drawText(renderer, "ESC: BACK TO MENU", SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT - 100, 2, GOLD);
+        text.draw(sprites, "ESC: BACK TO MENU", SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT - 100, 2, GOLD);
+    }
+    
+    void drawRenderStats(const RenderSnapshot& snapshot) {
+        TRACE_SCOPE("drawRenderStats");
+        // Last frame's submission, sorted and as recorded
+        const CommandStats& submitted = commands.getStats();
+        drawCallsLabel.setText("DRAW CALLS: " + std::to_string(submitted.drawCalls) + " UNSORTED " +
+                               std::to_string(submitted.unsortedDrawCalls) + " COMMANDS " +
+                               std::to_string(submitted.commands));
+        stateChangesLabel.setText("STATE CHANGES: " + std::to_string(submitted.stateChanges) + " UNSORTED " +
+                                  std::to_string(submitted.unsortedStateChanges));
+        legacyCallsLabel.setText("PER-PIXEL: " + std::to_string(frameStats.legacyCalls));
+        tickRateLabel.setText("TICK RATE: " + std::to_string(snapshot.tickRate));
+        drawCallsLabel.draw(text, sprites, 10, 10);
+        stateChangesLabel.draw(text, sprites, 10, 22);
+        legacyCallsLabel.draw(text, sprites, 10, 34);
+        tickRateLabel.draw(text, sprites, 10, 46);
+        jitterLabel.setText(formatPacingReport(pacer.getReport()));
+        pacingLabel.draw(text, sprites, 10, 58);
+        jitterLabel.draw(text, sprites, 10, 70);
+        
+        // Simulation rate, input to simulation and simulation to present
+        char line[96];
+        std::snprintf(line, sizeof(line), "SIM %.0fHZ INPUT P50 %.2fMS P99 %.2fMS SHOWN P50 %.2fMS P99 %.2fMS",
+                      snapshot.ticksPerSecond, (double)snapshot.inputLatencyP50 / SDL_NS_PER_MS,
+                      (double)snapshot.inputLatencyP99 / SDL_NS_PER_MS, (double)presentP50 / SDL_NS_PER_MS,
+                      (double)presentP99 / SDL_NS_PER_MS);
+        latencyLabel.setText(line);
+        latencyLabel.draw(text, sprites, 10, 82);
+    }
+    
+    // Phase timings of the last second, in microseconds. Update phases are
+    // timed on the simulation thread, the rest on the main thread.
+    void drawProfiler() {
+        TRACE_SCOPE("drawProfiler");
+        int x = SCREEN_WIDTH - 380;
+        int y = 10;
+        char line[96];
+        std::snprintf(line, sizeof(line), "%-18s %7s %7s %7s %7s %7s", "PHASE US", "P50", "P90", "P99", "P99.9", "MAX");
+        text.draw(sprites, line, x, y, 1, GREEN);
+        
+        for (int i = 0; i < (int)Phase::COUNT; i++) {
+            Phase phase = (Phase)i;
+            bool simulated = phase == Phase::UPDATE || phase == Phase::UPDATE_GAMEPLAY ||
+                             phase == Phase::UPDATE_POWER_UPS || phase == Phase::PUBLISH;
+            LatencyHistogram h = (simulated ? simProfiler : profiler).getWindow(phase);
+            std::string name = phaseName(phase);
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            std::snprintf(line, sizeof(line), "%-18s %7.1f %7.1f %7.1f %7.1f %7.1f", name.c_str(),
+                          h.percentile(0.5) / 1000.0, h.percentile(0.9) / 1000.0,
+                          h.percentile(0.99) / 1000.0, h.percentile(0.999) / 1000.0,
+                          h.getMax() / 1000.0);
+            y += 12;
+            text.draw(sprites, line, x, y, 1, GREEN);
+        }
     }
     
+    // Wins by a human go into the store; the disk write happens on its thread
     void saveHighScore() {
-        // Simplified high score saving
-        // In a real implementation, you would save to a file
+        bool player1Won = match.player1Score > match.player2Score;
+        if (replayer || (!player1Won && gameMode != "vs_human")) {
+            highScoreRank = -1;
+            return;
+        }
+        HighScore score;
+        score.time = (uint64_t)std::time(nullptr);
+        score.durationMs = (uint32_t)(matchTime * 1000);
+        score.winner = player1Won ? 1 : 2;
+        score.winnerScore = (uint8_t)std::max(match.player1Score, match.player2Score);
+        score.loserScore = (uint8_t)std::min(match.player1Score, match.player2Score);
+        score.difficulty = gameMode == "vs_human" ? HUMAN_OPPONENT : (uint8_t)difficulty;
+        highScoreRank = highScores.add(score);
     }
     
     void loadHighScores() {
-        // Simplified high score loading
-        // In a real implementation, you would load from a file
+        if (scoresPath.empty()) {
+            return;
+        }
+        if (!highScores.open(scoresPath)) {
+            std::cerr << "Could not read high scores from " << scoresPath << std::endl;
+        }
     }
 };
 
 // Main function
 int main(int argc, char* argv[]) {
-    Game game;
+    GameOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tick-rate" && i + 1 < argc) {
+            int rate = std::atoi(argv[++i]);
+            if (std::find(std::begin(TICK_RATES), std::end(TICK_RATES), rate) == std::end(TICK_RATES)) {
+                std::cerr << "Unsupported tick rate " << rate << ", use 60, 120, 240 or 1000" << std::endl;
+                return -1;
+            }
+            options.tickRate = rate;
+        } else if (arg == "--pacing" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "vsync") {
+                options.pacing = PacingMode::VSYNC;
+            } else if (mode == "adaptive") {
+                options.pacing = PacingMode::ADAPTIVE_VSYNC;
+            } else if (mode == "sleep") {
+                options.pacing = PacingMode::SLEEP;
+            } else if (mode == "uncapped") {
+                options.pacing = PacingMode::UNCAPPED;
+            } else {
+                std::cerr << "Unknown pacing mode " << mode << ", use vsync, adaptive, sleep or uncapped" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--profile-csv" && i + 1 < argc) {
+            options.profileCsv = argv[++i];
+        } else if (arg == "--trace-hitch" && i + 1 < argc) {
+            options.traceHitchMs = std::atof(argv[++i]);
+        } else if (arg == "--workers" && i + 1 < argc) {
+            options.workers = std::atoi(argv[++i]);
+            if (options.workers <= 0) {
+                std::cerr << "Worker count must be positive" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--stars" && i + 1 < argc) {
+            options.stars = std::atoi(argv[++i]);
+            if (options.stars < 0) {
+                std::cerr << "Star count must not be negative" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--scores" && i + 1 < argc) {
+            options.scoresPath = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            options.recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            options.replayPath = argv[++i];
+        } else if (arg == "--host" && i + 1 < argc) {
+            options.hostPort = std::atoi(argv[++i]);
+            if (options.hostPort < 0 || options.hostPort > 65535) {
+                std::cerr << "Port must be between 0 and 65535" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--join" && i + 1 < argc) {
+            options.joinAddress = argv[++i];
+        } else if (arg == "--net-loss" && i + 1 < argc) {
+            options.netConditions.lossPercent = std::atof(argv[++i]);
+        } else if (arg == "--net-latency" && i + 1 < argc) {
+            options.netConditions.latencyMs = std::atof(argv[++i]);
+        } else if (arg == "--net-jitter" && i + 1 < argc) {
+            options.netConditions.jitterMs = std::atof(argv[++i]);
+        } else if (arg == "--fps" && i + 1 < argc) {
+            options.targetFps = std::atoi(argv[++i]);
+            if (options.targetFps <= 0) {
+                std::cerr << "Frame rate must be positive" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--stress-balls" && i + 1 < argc) {
+            int balls = std::atoi(argv[++i]);
+            if (balls < 1 || balls > (int)MAX_STRESS_BALLS) {
+                std::cerr << "Stress tests take 1 to " << MAX_STRESS_BALLS << " balls" << std::endl;
+                return -1;
+            }
+            options.stressBalls = balls;
+        } else if (arg == "--idle-fps" && i + 1 < argc) {
+            options.idleFps = std::atoi(argv[++i]);
+            if (options.idleFps < 0) {
+                std::cerr << "Idle frame rate must not be negative" << std::endl;
+                return -1;
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return -1;
+        }
+    }
+    
+    if (options.hostPort >= 0 && !options.joinAddress.empty()) {
+        std::cerr << "Use either --host or --join" << std::endl;
+        return -1;
+    }
+    if (!options.replayPath.empty() && (options.hostPort >= 0 || !options.joinAddress.empty())) {
+        std::cerr << "--replay can't be combined with online play" << std::endl;
+        return -1;
+    }
+    
+    Game game(options);
     
     if (!game.init()) {
         std::cerr << "Failed to initialize game!" << std::endl;
@@ -0,0 +1,222 @@
+// Space Ping Pong - Chrome trace-event recorder
+//
+// Each thread appends complete ("X") and instant ("i") events to its own
+// fixed-size ring, so recording takes no lock and the newest events win
+// when a ring wraps. A dump writes every ring as trace_event JSON that
+// chrome://tracing and Perfetto load.
+//
+// Any thread may dump or clear while the others keep recording. Event
+// fields are relaxed atomics and a ring publishes its count with release
+// order, so a dump copies the published events and then drops any the
+// owner may have overwritten during the copy, as a seqlock would. Clearing
+// only moves a floor below which events are skipped; the owner's count is
+// never reset under it. Build with -DPINGPONG_TRACING=0 to compile the
+// TRACE_* macros out entirely.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef PINGPONG_TRACING
+#define PINGPONG_TRACING 1
+#endif
+
+// Monotonic nanoseconds; trace timestamps only need to agree with each other
+inline uint64_t traceNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TraceEvent {
+    const char* name;       // String literal, never freed
+    uint64_t start;         // traceNow()
+    uint64_t duration;
+    char phase;             // 'X' complete, 'i' instant
+};
+
+// A ring slot, written by its owner while other threads may read it
+struct TraceSlot {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> duration;
+    std::atomic<char> phase;
+};
+
+class TraceBuffer {
+public:
+    static const size_t CAPACITY = 1 << 16;
+    
+    TraceBuffer(int threadId, const std::string& threadName)
+        : threadId(threadId), threadName(threadName), slots(new TraceSlot[CAPACITY]), next(0), floor(0) {}
+    
+    // Owner thread only
+    void push(const char* name, uint64_t start, uint64_t duration, char phase) {
+        uint64_t index = next.load(std::memory_order_relaxed);
+        
+        // A reader that sees any of these stores also sees the count
+        // published before them, so it knows the slot was reused
+        std::atomic_thread_fence(std::memory_order_release);
+        TraceSlot& slot = slots[index % CAPACITY];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.phase.store(phase, std::memory_order_relaxed);
+        next.store(index + 1, std::memory_order_release);
+    }
+    
+    // Any thread: events pushed so far are no longer dumped
+    void clear() {
+        floor.store(next.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+    
+    // Any thread: the events kept since the last clear, oldest first
+    void copy(std::vector<TraceEvent>& out) const {
+        out.clear();
+        uint64_t end = next.load(std::memory_order_acquire);
+        uint64_t begin = std::max(floor.load(std::memory_order_relaxed), end > CAPACITY ? end - CAPACITY : 0);
+        for (uint64_t i = begin; i < end; i++) {
+            const TraceSlot& slot = slots[i % CAPACITY];
+            out.push_back({slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                           slot.duration.load(std::memory_order_relaxed), slot.phase.load(std::memory_order_relaxed)});
+        }
+        
+        // The owner may have reused the oldest slots meanwhile, and may be
+        // writing the one after its count: drop every copy it could have hit
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = next.load(std::memory_order_relaxed);
+        uint64_t overwritten = now + 1 > CAPACITY ? now + 1 - CAPACITY : 0;
+        if (overwritten > begin) {
+            out.erase(out.begin(), out.begin() + (ptrdiff_t)std::min<uint64_t>(overwritten - begin, out.size()));
+        }
+    }
+    
+    int threadId;
+    std::string threadName;     // Guarded by the tracer's mutex
+    std::unique_ptr<TraceSlot[]> slots;
+    std::atomic<uint64_t> next;     // Total events pushed; ring index is next % CAPACITY
+    std::atomic<uint64_t> floor;    // Events below this were cleared
+};
+
+class Tracer {
+public:
+    static Tracer& get() {
+        static Tracer tracer;
+        return tracer;
+    }
+    
+    bool isRecording() const {
+        return recording.load(std::memory_order_relaxed);
+    }
+    
+    void setRecording(bool value) {
+        recording.store(value, std::memory_order_relaxed);
+    }
+    
+    // Ring of the calling thread, created on first use
+    TraceBuffer& buffer() {
+        thread_local TraceBuffer* local = nullptr;
+        if (!local) {
+            std::lock_guard<std::mutex> lock(mutex);
+            int id = (int)buffers.size() + 1;
+            buffers.emplace_back(new TraceBuffer(id, "thread " + std::to_string(id)));
+            local = buffers.back().get();
+        }
+        return *local;
+    }
+    
+    // Names the calling thread's ring in dumps; unnamed rings are "thread N"
+    void setThreadName(const std::string& name) {
+        TraceBuffer& ring = buffer();
+        std::lock_guard<std::mutex> lock(mutex);
+        ring.threadName = name;
+    }
+    
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& ring : buffers) {
+            ring->clear();
+        }
+    }
+    
+    // Write every ring to a trace_event JSON file
+    bool dump(const std::string& path) {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<TraceEvent> events;
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Space Ping Pong\"}}");
+        for (auto& ring : buffers) {
+            std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                         ring->threadId, ring->threadName.c_str());
+            
+            ring->copy(events);
+            for (const TraceEvent& event : events) {
+                double ts = event.start / 1000.0;
+                if (event.phase == 'X') {
+                    std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"game\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                                 event.name, ts, event.duration / 1000.0, ring->threadId);
+                } else {
+                    std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"game\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                                 event.name, ts, ring->threadId);
+                }
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+    
+private:
+    std::atomic<bool> recording;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    
+    Tracer() : recording(false) {}
+};
+
+// Records the enclosing scope as one complete event while tracing is on
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name), start(0) {
+        if (Tracer::get().isRecording()) {
+            start = traceNow();
+        }
+    }
+    
+    ~TraceScope() {
+        if (start != 0 && Tracer::get().isRecording()) {
+            Tracer::get().buffer().push(name, start, traceNow() - start, 'X');
+        }
+    }
+    
+private:
+    const char* name;
+    uint64_t start;
+};
+
+inline void traceInstant(const char* name) {
+    if (Tracer::get().isRecording()) {
+        Tracer::get().buffer().push(name, traceNow(), 0, 'i');
+    }
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#if PINGPONG_TRACING
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_INSTANT(name) traceInstant(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_INSTANT(name) ((void)0)
+#endif